@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "alloc.h"
+#include "bench.h"
+#include "list.h"
+
+#define ALLOC_BENCH_BATCH 1024 /* objects allocated before freed */
+
+/* Allocate n objects of 32 bytes in batches, and free them. */
+static void alloc_bench(struct bench_ctx *ctx, struct alloc *a) {
+    void *objs[ALLOC_BENCH_BATCH];
+
+    int i, j;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i += ALLOC_BENCH_BATCH) {
+        for (j = 0; j < ALLOC_BENCH_BATCH; j++) objs[j] = alloc_malloc(a, 32);
+        for (j = 0; j < ALLOC_BENCH_BATCH; j++) alloc_free(a, objs[j], 32);
+    }
+    bench_ctx_reset_end_at(ctx);
+}
+
+void case_alloc_libc(struct bench_ctx *ctx) { alloc_bench(ctx, NULL); }
+
+void case_alloc_slab(struct bench_ctx *ctx) {
+    struct alloc_slab *slab = alloc_slab_new(32);
+    alloc_bench(ctx, &slab->alloc);
+    alloc_slab_free(slab);
+}
+
+void case_alloc_arena(struct bench_ctx *ctx) {
+    struct alloc_arena *arena = alloc_arena_new(0);
+
+    int i, j;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i += ALLOC_BENCH_BATCH) {
+        for (j = 0; j < ALLOC_BENCH_BATCH; j++) alloc_malloc(&arena->alloc, 32);
+        alloc_arena_reset(arena);
+    }
+    bench_ctx_reset_end_at(ctx);
+    alloc_arena_free(arena);
+}
+
+/* Push n nodes to a list in batches, and pop them. */
+static void alloc_bench_list(struct bench_ctx *ctx, struct list *list) {
+    int i, j;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i += ALLOC_BENCH_BATCH) {
+        for (j = 0; j < ALLOC_BENCH_BATCH; j++) list_push(list, "v");
+        for (j = 0; j < ALLOC_BENCH_BATCH; j++) list_pop(list);
+    }
+    bench_ctx_reset_end_at(ctx);
+}
+
+void case_alloc_list_libc(struct bench_ctx *ctx) {
+    struct list *list = list_new();
+    alloc_bench_list(ctx, list);
+    list_free(list);
+}
+
+void case_alloc_list_slab(struct bench_ctx *ctx) {
+    struct alloc_slab *slab = alloc_slab_new(sizeof(struct list_node));
+    struct list *list = list_new_alloc(&slab->alloc);
+    alloc_bench_list(ctx, list);
+    list_free(list);
+    alloc_slab_free(slab);
+}
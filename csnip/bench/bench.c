@@ -8,13 +8,79 @@
 #include "bench.h"
 #include "datetime.h"
 
+/**
+ * alloc_bench
+ */
+void case_alloc_libc(struct bench_ctx *ctx);
+void case_alloc_slab(struct bench_ctx *ctx);
+void case_alloc_arena(struct bench_ctx *ctx);
+void case_alloc_list_libc(struct bench_ctx *ctx);
+void case_alloc_list_slab(struct bench_ctx *ctx);
+static struct bench_case alloc_bench_cases[] = {
+    {"alloc_libc", &case_alloc_libc, 1000000},
+    {"alloc_slab", &case_alloc_slab, 1000000},
+    {"alloc_arena", &case_alloc_arena, 1000000},
+    {"alloc_list_libc", &case_alloc_list_libc, 1000000},
+    {"alloc_list_slab", &case_alloc_list_slab, 1000000},
+    {NULL, NULL, 0},
+};
+
 /**
  * buf_bench
  */
 void case_buf_puts(struct bench_ctx *ctx);
+void case_buf_lrm(struct bench_ctx *ctx);
+void case_buf_stream(struct bench_ctx *ctx);
+void case_buf_put_large(struct bench_ctx *ctx);
+void case_buf_new_small(struct bench_ctx *ctx);
+void case_buf_read_fd(struct bench_ctx *ctx);
+void case_buf_fanout_copy(struct bench_ctx *ctx);
+void case_buf_fanout_slice(struct bench_ctx *ctx);
+void case_buf_sprintf_metric(struct bench_ctx *ctx);
+void case_buf_put_metric(struct bench_ctx *ctx);
+void case_buf_sprintf_hex(struct bench_ctx *ctx);
+void case_buf_put_hex(struct bench_ctx *ctx);
 static struct bench_case buf_bench_cases[] = {
     {"buf_puts", &case_buf_puts, 10000},
     {"buf_puts", &case_buf_puts, 1000000},
+    {"buf_lrm", &case_buf_lrm, 100000},
+    {"buf_stream", &case_buf_stream, 1000000},
+    {"buf_put_large", &case_buf_put_large, 1000000},
+    {"buf_new_small", &case_buf_new_small, 1000000},
+    {"buf_read_fd", &case_buf_read_fd, 100000},
+    {"buf_fanout_copy", &case_buf_fanout_copy, 100000},
+    {"buf_fanout_slice", &case_buf_fanout_slice, 100000},
+    {"buf_sprintf_metric", &case_buf_sprintf_metric, 1000000},
+    {"buf_put_metric", &case_buf_put_metric, 1000000},
+    {"buf_sprintf_hex", &case_buf_sprintf_hex, 1000000},
+    {"buf_put_hex", &case_buf_put_hex, 1000000},
+    {NULL, NULL, 0},
+};
+
+/**
+ * bufchain_bench
+ */
+void case_bufchain_put(struct bench_ctx *ctx);
+void case_bufchain_flush(struct bench_ctx *ctx);
+void case_bufchain_flush_slab(struct bench_ctx *ctx);
+static struct bench_case bufchain_bench_cases[] = {
+    {"bufchain_put", &case_bufchain_put, 1000000},
+    {"bufchain_flush", &case_bufchain_flush, 100000},
+    {"bufchain_flush_slab", &case_bufchain_flush_slab, 100000},
+    {NULL, NULL, 0},
+};
+
+/**
+ * cmap_bench
+ */
+void case_cmap_set(struct bench_ctx *ctx);
+void case_cmap_get(struct bench_ctx *ctx);
+void case_cmap_get_mt(struct bench_ctx *ctx);
+static struct bench_case cmap_bench_cases[] = {
+    {"cmap_set", &case_cmap_set, 10000},
+    {"cmap_set", &case_cmap_set, 1000000},
+    {"cmap_get", &case_cmap_get, 10000000},
+    {"cmap_get_mt", &case_cmap_get_mt, 10000000},
     {NULL, NULL, 0},
 };
 
@@ -24,6 +90,13 @@ static struct bench_case buf_bench_cases[] = {
 void case_dict_set(struct bench_ctx *ctx);
 void case_dict_get(struct bench_ctx *ctx);
 void case_dict_pop(struct bench_ctx *ctx);
+void case_dict_set_long(struct bench_ctx *ctx);
+void case_dict_set_max(struct bench_ctx *ctx);
+void case_dict_entry(struct bench_ctx *ctx);
+void case_dict_iget(struct bench_ctx *ctx);
+void case_dict_iget_many(struct bench_ctx *ctx);
+void case_dict_keys_strdup(struct bench_ctx *ctx);
+void case_dict_keys_owned(struct bench_ctx *ctx);
 static struct bench_case dict_bench_cases[] = {
     {"dict_set", &case_dict_set, 10000},
     {"dict_set", &case_dict_set, 1000000},
@@ -31,6 +104,29 @@ static struct bench_case dict_bench_cases[] = {
     {"dict_get", &case_dict_get, 1000000},
     {"dict_pop", &case_dict_pop, 10000},
     {"dict_pop", &case_dict_pop, 1000000},
+    {"dict_set_long", &case_dict_set_long, 10000},
+    {"dict_set_long", &case_dict_set_long, 1000000},
+    {"dict_set_max", &case_dict_set_max, 5000000},
+    {"dict_entry", &case_dict_entry, 10000},
+    {"dict_entry", &case_dict_entry, 1000000},
+    {"dict_iget", &case_dict_iget, 1000000},
+    {"dict_iget", &case_dict_iget, 10000000},
+    {"dict_iget_many", &case_dict_iget_many, 1000000},
+    {"dict_iget_many", &case_dict_iget_many, 10000000},
+    {"dict_keys_strdup", &case_dict_keys_strdup, 1000000},
+    {"dict_keys_owned", &case_dict_keys_owned, 1000000},
+    {NULL, NULL, 0},
+};
+
+/**
+ * hashfile_bench
+ */
+void case_hashfile_open(struct bench_ctx *ctx);
+void case_hashfile_get(struct bench_ctx *ctx);
+static struct bench_case hashfile_bench_cases[] = {
+    {"hashfile_open", &case_hashfile_open, 10000},
+    {"hashfile_get", &case_hashfile_get, 10000},
+    {"hashfile_get", &case_hashfile_get, 1000000},
     {NULL, NULL, 0},
 };
 
@@ -40,6 +136,8 @@ static struct bench_case dict_bench_cases[] = {
 void case_heap_push(struct bench_ctx *ctx);
 void case_heap_pop(struct bench_ctx *ctx);
 void case_heap_top(struct bench_ctx *ctx);
+void case_heap_sort(struct bench_ctx *ctx);
+void case_heap_define_sort(struct bench_ctx *ctx);
 static struct bench_case heap_bench_cases[] = {
     {"heap_push", &case_heap_push, 10000},
     {"heap_push", &case_heap_push, 1000000},
@@ -47,6 +145,8 @@ static struct bench_case heap_bench_cases[] = {
     {"heap_pop", &case_heap_pop, 1000000},
     {"heap_top", &case_heap_top, 10000},
     {"heap_top", &case_heap_top, 1000000},
+    {"heap_sort", &case_heap_sort, 1000000},
+    {"heap_define_sort", &case_heap_define_sort, 1000000},
     {NULL, NULL, 0},
 };
 
@@ -64,6 +164,24 @@ static struct bench_case log_bench_cases[] = {
 void case_map_set(struct bench_ctx *ctx);
 void case_map_get(struct bench_ctx *ctx);
 void case_map_pop(struct bench_ctx *ctx);
+void case_map_get_miss(struct bench_ctx *ctx);
+void case_map_get_large(struct bench_ctx *ctx);
+void case_map_get_huge(struct bench_ctx *ctx);
+void case_map_churn(struct bench_ctx *ctx);
+void case_map_set_long(struct bench_ctx *ctx);
+void case_map_hash_4(struct bench_ctx *ctx);
+void case_map_hash_16(struct bench_ctx *ctx);
+void case_map_hash_64(struct bench_ctx *ctx);
+void case_map_hash_256(struct bench_ctx *ctx);
+void case_map_entry(struct bench_ctx *ctx);
+void case_map_iget(struct bench_ctx *ctx);
+void case_map_iget_many(struct bench_ctx *ctx);
+void case_map_keys_strdup(struct bench_ctx *ctx);
+void case_map_keys_owned(struct bench_ctx *ctx);
+void case_map_define_get(struct bench_ctx *ctx);
+void case_map_probe_40(struct bench_ctx *ctx);
+void case_map_probe_55(struct bench_ctx *ctx);
+void case_map_probe_70(struct bench_ctx *ctx);
 static struct bench_case map_bench_cases[] = {
     {"map_set", &case_map_set, 10000},
     {"map_set", &case_map_set, 1000000},
@@ -71,6 +189,46 @@ static struct bench_case map_bench_cases[] = {
     {"map_get", &case_map_get, 1000000},
     {"map_pop", &case_map_pop, 10000},
     {"map_pop", &case_map_pop, 1000000},
+    {"map_get_miss", &case_map_get_miss, 10000},
+    {"map_get_miss", &case_map_get_miss, 1000000},
+    {"map_get_large", &case_map_get_large, 4194304},
+    {"map_get_huge", &case_map_get_huge, 4194304},
+    {"map_churn", &case_map_churn, 10000},
+    {"map_churn", &case_map_churn, 1000000},
+    {"map_set_long", &case_map_set_long, 10000},
+    {"map_set_long", &case_map_set_long, 1000000},
+    {"map_hash_4", &case_map_hash_4, 10000000},
+    {"map_hash_16", &case_map_hash_16, 10000000},
+    {"map_hash_64", &case_map_hash_64, 10000000},
+    {"map_hash_256", &case_map_hash_256, 10000000},
+    {"map_entry", &case_map_entry, 10000},
+    {"map_entry", &case_map_entry, 1000000},
+    {"map_iget", &case_map_iget, 1000000},
+    {"map_iget", &case_map_iget, 10000000},
+    {"map_iget_many", &case_map_iget_many, 1000000},
+    {"map_iget_many", &case_map_iget_many, 10000000},
+    {"map_keys_strdup", &case_map_keys_strdup, 1000000},
+    {"map_keys_owned", &case_map_keys_owned, 1000000},
+    {"map_define_get", &case_map_define_get, 1000000},
+    {"map_define_get", &case_map_define_get, 10000000},
+    {"map_probe_40", &case_map_probe_40, 1000000},
+    {"map_probe_55", &case_map_probe_55, 1000000},
+    {"map_probe_70", &case_map_probe_70, 1000000},
+    {NULL, NULL, 0},
+};
+
+/**
+ * mph_bench
+ */
+void case_mph_new(struct bench_ctx *ctx);
+void case_mph_get(struct bench_ctx *ctx);
+void case_mph_map_get(struct bench_ctx *ctx);
+static struct bench_case mph_bench_cases[] = {
+    {"mph_new", &case_mph_new, 1000000},
+    {"mph_get", &case_mph_get, 10000},
+    {"mph_get", &case_mph_get, 1000000},
+    {"mph_map_get", &case_mph_map_get, 10000},
+    {"mph_map_get", &case_mph_map_get, 1000000},
     {NULL, NULL, 0},
 };
 
@@ -109,6 +267,23 @@ static struct bench_case strings_bench_cases[] = {
     {NULL, NULL, 0},
 };
 
+/**
+ * u64map_bench
+ */
+void case_u64map_set(struct bench_ctx *ctx);
+void case_u64map_get(struct bench_ctx *ctx);
+void case_u64map_pop(struct bench_ctx *ctx);
+static struct bench_case u64map_bench_cases[] = {
+    {"u64map_set", &case_u64map_set, 10000},
+    {"u64map_set", &case_u64map_set, 1000000},
+    {"u64map_get", &case_u64map_get, 10000},
+    {"u64map_get", &case_u64map_get, 1000000},
+    {"u64map_get", &case_u64map_get, 10000000},
+    {"u64map_pop", &case_u64map_pop, 10000},
+    {"u64map_pop", &case_u64map_pop, 1000000},
+    {NULL, NULL, 0},
+};
+
 /**
  * bench
  */
@@ -129,24 +304,36 @@ static void run_cases(const char *name, struct bench_case cases[]) {
         struct bench_case c = cases[idx];
         if (c.name == NULL || c.fn == NULL) break;
         fprintf(stderr, "%-17s %-20s ", name, c.name);
-        struct bench_ctx ctx = {datetime_stamp_now(), -1, c.n};
+        struct bench_ctx ctx = {datetime_stamp_now(), -1, c.n, 0, 0};
         (c.fn)(&ctx);
         double start_at = ctx.start_at;
         double end_at = ctx.end_at;
         if (end_at < 0) end_at = datetime_stamp_now();
         idx += 1;
-        fprintf(stderr, "%10ld%10ldns/op\n", c.n,
+        fprintf(stderr, "%10ld%10ldns/op", c.n,
                 (long)(1000000.0 * (end_at - start_at) / (double)c.n));
+        if (ctx.bytes > 0)
+            fprintf(stderr, "%8.2fB/ns", (double)ctx.bytes * c.n /
+                                             (1000000.0 * (end_at - start_at)));
+        if (ctx.max_ns > 0) fprintf(stderr, "%12ldns/max", ctx.max_ns);
+        if (ctx.note[0] != '\0') fprintf(stderr, "  %s", ctx.note);
+        fprintf(stderr, "\n");
     }
 }
 
 int main(int argc, const char *argv[]) {
+    run_cases("alloc_bench", alloc_bench_cases);
     run_cases("buf_bench", buf_bench_cases);
+    run_cases("bufchain_bench", bufchain_bench_cases);
+    run_cases("cmap_bench", cmap_bench_cases);
     run_cases("dict_bench", dict_bench_cases);
+    run_cases("hashfile_bench", hashfile_bench_cases);
     run_cases("heap_bench", heap_bench_cases);
     run_cases("log_stderr", log_bench_cases);
     run_cases("map_bench", map_bench_cases);
+    run_cases("mph_bench", mph_bench_cases);
     run_cases("skiplist_bench", skiplist_bench_cases);
     run_cases("strings_bench", strings_bench_cases);
+    run_cases("u64map_bench", u64map_bench_cases);
     return 0;
 }
@@ -6,6 +6,9 @@ struct bench_ctx {
     double start_at; /* bench start_at */
     double end_at;   /* bench end_at */
     long n;          /* bench times */
+    long bytes;      /* bytes processed per op, reported if set */
+    long max_ns;     /* max latency of a single op, reported if set */
+    char note[64];   /* extra report of the case, printed if set */
 };
 
 struct bench_case {
@@ -2,6 +2,10 @@
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  */
 
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "bench.h"
 #include "buf.h"
 
@@ -15,3 +19,173 @@ void case_buf_puts(struct bench_ctx *ctx) {
     bench_ctx_reset_end_at(ctx);
     buf_free(buf);
 }
+
+/* Consume n frames of 16 bytes one by one from a buffer holding them all,
+ * like a protocol parser draining its input buffer. */
+void case_buf_lrm(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    int i;
+    for (i = 0; i < ctx->n; i++) buf_puts(buf, "frame:0123456789");
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        assert(buf->data[0] == 'f');
+        buf_lrm(buf, 16);
+    }
+    bench_ctx_reset_end_at(ctx);
+    buf_free(buf);
+}
+
+/* Receive frames in chunks of 64 and consume them one by one, the buffer
+ * keeps half a chunk unconsumed. */
+void case_buf_stream(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    int i, j;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i += 64) {
+        for (j = 0; j < 64; j++) buf_puts(buf, "frame:0123456789");
+        while (buf_len(buf) > 32 * 16) buf_lrm(buf, 16);
+    }
+    bench_ctx_reset_end_at(ctx);
+    buf_free(buf);
+}
+
+/* Build a buffer of n * 64 bytes, e.g. a large response. */
+void case_buf_put_large(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    char chunk[64];
+    memset(chunk, 'a', 64);
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        buf_put(buf, chunk, 64);
+    }
+    bench_ctx_reset_end_at(ctx);
+    buf_free(buf);
+}
+
+/* Create short bufs and free them. */
+void case_buf_new_small(struct bench_ctx *ctx) {
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        struct buf *buf = buf("GET /index.html");
+        buf_free(buf);
+    }
+    bench_ctx_reset_end_at(ctx);
+}
+
+/* Read 512 bytes messages from a pipe into a buffer and consume them, the
+ * buffer stays small. */
+void case_buf_read_fd(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    char msg[512];
+    memset(msg, 'a', sizeof(msg));
+    int fds[2], i;
+    assert(pipe(fds) == 0);
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        assert(write(fds[1], msg, sizeof(msg)) == sizeof(msg));
+        assert(buf_read_fd(buf, fds[0], 0) == sizeof(msg));
+        buf_lrm(buf, sizeof(msg));
+    }
+    bench_ctx_reset_end_at(ctx);
+    close(fds[0]);
+    close(fds[1]);
+    buf_free(buf);
+}
+
+#define BUF_BENCH_FANOUT 8 /* number of backends a message goes to */
+
+/* Fan a 4kb message out to backends by copying it into a buffer of
+ * each. */
+void case_buf_fanout_copy(struct bench_ctx *ctx) {
+    struct buf *outs[BUF_BENCH_FANOUT];
+    char msg[4096];
+    memset(msg, 'a', sizeof(msg));
+    int i, j;
+    for (j = 0; j < BUF_BENCH_FANOUT; j++) outs[j] = buf(NULL);
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        struct buf *buf = buf(NULL);
+        buf_put(buf, msg, sizeof(msg));
+        for (j = 0; j < BUF_BENCH_FANOUT; j++)
+            buf_put(outs[j], buf->data, buf->len);
+        buf_free(buf);
+        for (j = 0; j < BUF_BENCH_FANOUT; j++) buf_lrm(outs[j], sizeof(msg));
+    }
+    bench_ctx_reset_end_at(ctx);
+    for (j = 0; j < BUF_BENCH_FANOUT; j++) buf_free(outs[j]);
+}
+
+/* Fan a 4kb message out to backends by slices of the shared buffer. */
+void case_buf_fanout_slice(struct bench_ctx *ctx) {
+    struct buf_slice *outs[BUF_BENCH_FANOUT];
+    char msg[4096];
+    memset(msg, 'a', sizeof(msg));
+    int i, j;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        struct buf *buf = buf(NULL);
+        buf_put(buf, msg, sizeof(msg));
+        struct buf_shared *shared = buf_share(buf);
+        for (j = 0; j < BUF_BENCH_FANOUT; j++)
+            outs[j] = buf_slice(shared, 0, shared->len);
+        buf_shared_free(shared);
+        buf_free(buf);
+        for (j = 0; j < BUF_BENCH_FANOUT; j++) buf_slice_free(outs[j]);
+    }
+    bench_ctx_reset_end_at(ctx);
+}
+
+/* Format n integers and doubles like metrics, by buf_sprintf and by the
+ * buf_put_* functions. */
+void case_buf_sprintf_metric(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        buf_sprintf(buf, "%ld %.3f\n", 1234567L * i, i * 0.731);
+        if (buf->len > 4096) buf_lrm(buf, buf->len);
+    }
+    bench_ctx_reset_end_at(ctx);
+    buf_free(buf);
+}
+
+void case_buf_put_metric(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        buf_put_i64(buf, 1234567L * i);
+        buf_putc(buf, ' ');
+        buf_put_double(buf, i * 0.731, 3);
+        buf_putc(buf, '\n');
+        if (buf->len > 4096) buf_lrm(buf, buf->len);
+    }
+    bench_ctx_reset_end_at(ctx);
+    buf_free(buf);
+}
+
+void case_buf_sprintf_hex(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        buf_sprintf(buf, "%llx", 0x9e3779b97f4a7c15ULL * i);
+        if (buf->len > 4096) buf_lrm(buf, buf->len);
+    }
+    bench_ctx_reset_end_at(ctx);
+    buf_free(buf);
+}
+
+void case_buf_put_hex(struct bench_ctx *ctx) {
+    struct buf *buf = buf(NULL);
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        buf_put_hex(buf, 0x9e3779b97f4a7c15ULL * i);
+        if (buf->len > 4096) buf_lrm(buf, buf->len);
+    }
+    bench_ctx_reset_end_at(ctx);
+    buf_free(buf);
+}
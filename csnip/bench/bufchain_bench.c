@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bufchain.h"
+
+/* Build a chain of n * 64 bytes, e.g. a large response. */
+void case_bufchain_put(struct bench_ctx *ctx) {
+    struct bufchain *chain = bufchain_new(NULL);
+    char chunk[64];
+    memset(chunk, 'a', 64);
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        bufchain_put(chain, chunk, 64);
+    }
+    bench_ctx_reset_end_at(ctx);
+    bufchain_free(chain);
+}
+
+/* Put a 64KB response into a chain of a connection and flush it, n times,
+ * with blocks from libc or a shared slab. */
+static void bufchain_bench_flush(struct bench_ctx *ctx, struct alloc *a) {
+    char resp[64 * 1024];
+    memset(resp, 'a', sizeof(resp));
+    int fd = open("/dev/null", O_WRONLY);
+    assert(fd >= 0);
+    int i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        struct bufchain *chain = bufchain_new(a);
+        bufchain_put(chain, resp, sizeof(resp));
+        while (bufchain_len(chain) > 0) bufchain_write_fd(chain, fd);
+        bufchain_free(chain);
+    }
+    bench_ctx_reset_end_at(ctx);
+    close(fd);
+}
+
+void case_bufchain_flush(struct bench_ctx *ctx) {
+    bufchain_bench_flush(ctx, NULL);
+}
+
+void case_bufchain_flush_slab(struct bench_ctx *ctx) {
+    struct alloc_slab *slab = alloc_slab_new(BUFCHAIN_BLOCK_SIZE);
+    bufchain_bench_flush(ctx, &slab->alloc);
+    alloc_slab_free(slab);
+}
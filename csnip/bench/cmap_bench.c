@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "cmap.h"
+
+#define CMAP_BENCH_KEYS 100000
+#define CMAP_BENCH_THREADS_MAX 32
+
+struct cmap_bench_reader {
+    struct cmap *m;
+    char (*keys)[8];
+    long n;
+};
+
+static void *cmap_bench_read(void *arg) {
+    struct cmap_bench_reader *r = arg;
+    long i;
+    for (i = 0; i < r->n; i++)
+        cmap_get(r->m, r->keys[i % CMAP_BENCH_KEYS]);
+    return NULL;
+}
+
+/* Lookup by given number of threads, n lookups in total, so that ns/op
+ * drops as reads scale with threads. */
+static void cmap_get_bench(struct bench_ctx *ctx, long threads) {
+    struct cmap *m = cmap();
+    /* suite */
+    long i;
+    char(*keys)[8] = malloc(CMAP_BENCH_KEYS * sizeof(*keys));
+    for (i = 0; i < CMAP_BENCH_KEYS; i++) {
+        sprintf(keys[i], "%ld", i);
+        cmap_set(m, keys[i], "val");
+    }
+    pthread_t tids[CMAP_BENCH_THREADS_MAX];
+    struct cmap_bench_reader readers[CMAP_BENCH_THREADS_MAX];
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < threads; i++) {
+        struct cmap_bench_reader r = {m, keys, ctx->n / threads};
+        readers[i] = r;
+        pthread_create(&tids[i], NULL, &cmap_bench_read, &readers[i]);
+    }
+    for (i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    bench_ctx_reset_end_at(ctx);
+    cmap_free(m);
+    free(keys);
+}
+
+void case_cmap_get(struct bench_ctx *ctx) { cmap_get_bench(ctx, 1); }
+
+void case_cmap_get_mt(struct bench_ctx *ctx) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > CMAP_BENCH_THREADS_MAX) threads = CMAP_BENCH_THREADS_MAX;
+    cmap_get_bench(ctx, threads);
+}
+
+void case_cmap_set(struct bench_ctx *ctx) {
+    struct cmap *m = cmap();
+    /* keys suite */
+    int i;
+    char keys[ctx->n][4];
+    for (i = 0; i < ctx->n; i++) sprintf(keys[i], "%d", i & 999);
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        cmap_set(m, keys[i], "val");
+    }
+    bench_ctx_reset_end_at(ctx);
+    cmap_free(m);
+}
@@ -2,8 +2,13 @@
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  */
 
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "bench.h"
+#include "datetime.h"
 #include "dict.h"
 
 void case_dict_set(struct bench_ctx *ctx) {
@@ -56,3 +61,122 @@ void case_dict_pop(struct bench_ctx *ctx) {
     bench_ctx_reset_end_at(ctx);
     dict_free(dict);
 }
+
+/* Set distinct long keys, most of the cost goes to hashing them on sets and
+ * on the resizes. */
+void case_dict_set_long(struct bench_ctx *ctx) {
+    struct dict *dict = dict();
+    /* keys suite */
+    long i;
+    char(*keys)[64] = malloc(ctx->n * sizeof(*keys));
+    for (i = 0; i < ctx->n; i++) sprintf(keys[i], "%063ld", i);
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        dict_set(dict, keys[i], "val");
+    }
+    bench_ctx_reset_end_at(ctx);
+    dict_free(dict);
+    free(keys);
+}
+
+/* Set distinct keys and track the slowest single set, which used to be the
+ * one rehashing the whole dict. */
+void case_dict_set_max(struct bench_ctx *ctx) {
+    struct dict *dict = dict();
+    /* keys suite */
+    long i;
+    char(*keys)[12] = malloc(ctx->n * sizeof(*keys));
+    for (i = 0; i < ctx->n; i++) sprintf(keys[i], "%ld", i);
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        double start_at = datetime_stamp_now();
+        dict_set(dict, keys[i], "val");
+        long ns = (long)(1000000.0 * (datetime_stamp_now() - start_at));
+        if (ns > ctx->max_ns) ctx->max_ns = ns;
+    }
+    bench_ctx_reset_end_at(ctx);
+    dict_free(dict);
+    free(keys);
+}
+
+void case_dict_entry(struct bench_ctx *ctx) {
+    struct dict *dict = dict();
+    /* keys suite */
+    int i;
+    char keys[ctx->n][4];
+    for (i = 0; i < ctx->n; i++) sprintf(keys[i], "%d", i & 999);
+    /* bench: count keys */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        void **val = dict_entry(dict, keys[i], NULL);
+        *val = (void *)((intptr_t)*val + 1);
+    }
+    bench_ctx_reset_end_at(ctx);
+    dict_free(dict);
+}
+
+/* Lookup all keys of a big dict one by one, or by batches of given size,
+ * the table is much larger than the cache. */
+static void dict_iget_bench(struct bench_ctx *ctx, size_t batch) {
+    struct dict *dict = dict();
+    /* suite */
+    long i;
+    char(*keys)[12] = malloc(ctx->n * sizeof(*keys));
+    char **ptrs = malloc(ctx->n * sizeof(char *));
+    size_t *lens = malloc(ctx->n * sizeof(size_t));
+    void *vals[256];
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(keys[i], "%ld", i);
+        ptrs[i] = keys[i];
+        lens[i] = strlen(keys[i]);
+        dict_set(dict, keys[i], "val");
+    }
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    if (batch == 1) {
+        for (i = 0; i < ctx->n; i++) dict_iget(dict, ptrs[i], lens[i]);
+    } else {
+        for (i = 0; i + batch <= ctx->n; i += batch)
+            dict_iget_many(dict, ptrs + i, lens + i, batch, vals);
+    }
+    bench_ctx_reset_end_at(ctx);
+    dict_free(dict);
+    free(keys);
+    free(ptrs);
+    free(lens);
+}
+
+void case_dict_iget(struct bench_ctx *ctx) { dict_iget_bench(ctx, 1); }
+
+void case_dict_iget_many(struct bench_ctx *ctx) { dict_iget_bench(ctx, 64); }
+
+/* Set distinct keys formatted into a reused buffer, lookup and free them
+ * all, the keys are owned by the dict or strdup-ed one by one. */
+static void dict_keys_bench(struct bench_ctx *ctx, int own) {
+    struct dict *dict = own ? dict_new_owned() : dict();
+    long i;
+    char key[24];
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(key, "%ld", i);
+        dict_set(dict, own ? key : strdup(key), "val");
+    }
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(key, "%ld", i);
+        dict_get(dict, key);
+    }
+    if (!own) {
+        struct dict_iter iter = {dict};
+        struct dict_node *node = NULL;
+        dict_each(&iter, node) free(node->key);
+    }
+    dict_free(dict);
+    bench_ctx_reset_end_at(ctx);
+}
+
+void case_dict_keys_strdup(struct bench_ctx *ctx) { dict_keys_bench(ctx, 0); }
+
+void case_dict_keys_owned(struct bench_ctx *ctx) { dict_keys_bench(ctx, 1); }
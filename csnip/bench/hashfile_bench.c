@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "hashfile.h"
+
+#define HASHFILE_BENCH_PATH "hashfile_bench.db"
+
+static void hashfile_bench_dump(long n) {
+    struct hashfile_writer *w = hashfile_writer_new(HASHFILE_BENCH_PATH);
+    char key[24];
+    long i;
+    for (i = 0; i < n; i++) {
+        int len = sprintf(key, "key%ld", i);
+        hashfile_writer_put(w, key, len, "val", 3);
+    }
+    hashfile_writer_close(w);
+}
+
+void case_hashfile_open(struct bench_ctx *ctx) {
+    /* suite */
+    hashfile_bench_dump(1000000);
+    /* bench: startup cost, no parsing */
+    long i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        hashfile_close(hashfile_open(HASHFILE_BENCH_PATH));
+    }
+    bench_ctx_reset_end_at(ctx);
+    unlink(HASHFILE_BENCH_PATH);
+}
+
+void case_hashfile_get(struct bench_ctx *ctx) {
+    /* suite */
+    hashfile_bench_dump(ctx->n);
+    struct hashfile *hf = hashfile_open(HASHFILE_BENCH_PATH);
+    char key[24];
+    long i;
+    /* bench: random order */
+    uint64_t x = 88172645463325252ull;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        int len = sprintf(key, "key%ld", (long)(x % ctx->n));
+        hashfile_iget(hf, key, len, NULL);
+    }
+    bench_ctx_reset_end_at(ctx);
+    hashfile_close(hf);
+    unlink(HASHFILE_BENCH_PATH);
+}
@@ -3,6 +3,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "bench.h"
 #include "heap.h"
 
@@ -45,3 +46,34 @@ void case_heap_top(struct bench_ctx *ctx) {
     bench_ctx_reset_end_at(ctx);
     heap_free(heap);
 }
+
+void case_heap_sort(struct bench_ctx *ctx) {
+    struct heap *heap = heap(&heap_bench_cmp);
+    int *data = malloc(ctx->n * sizeof(int));
+    int i;
+    for (i = 0; i < ctx->n; i++) data[i] = rand();
+    /* bench: a comparator call and a pointer chase per comparison */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) heap_push(heap, &data[i]);
+    for (i = 0; i < ctx->n; i++) heap_pop(heap);
+    bench_ctx_reset_end_at(ctx);
+    heap_free(heap);
+    free(data);
+}
+
+#define heap_bench_less(a, b) ((a) < (b))
+HEAP_DEFINE(heap_bench_ints, int, heap_bench_less)
+
+void case_heap_define_sort(struct bench_ctx *ctx) {
+    struct heap_bench_ints *heap = heap_bench_ints_new();
+    int *data = malloc(ctx->n * sizeof(int));
+    int i;
+    for (i = 0; i < ctx->n; i++) data[i] = rand();
+    /* bench: inlined comparisons on inline ints */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) heap_bench_ints_push(heap, data[i]);
+    for (i = 0; i < ctx->n; i++) heap_bench_ints_pop(heap, NULL);
+    bench_ctx_reset_end_at(ctx);
+    heap_bench_ints_free(heap);
+    free(data);
+}
@@ -2,7 +2,10 @@
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  */
 
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "bench.h"
 #include "map.h"
@@ -57,3 +60,258 @@ void case_map_pop(struct bench_ctx *ctx) {
     bench_ctx_reset_end_at(ctx);
     map_free(m);
 }
+
+/* Lookup keys not in a map filled right up to the load limit, which probes
+ * through the whole cluster unless the probing stops early. */
+void case_map_get_miss(struct bench_ctx *ctx) {
+    struct map *m = map();
+    /* suite */
+    long i;
+    char(*keys)[12] = malloc(ctx->n * sizeof(*keys));
+    char(*miss)[12] = malloc(ctx->n * sizeof(*miss));
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(keys[i], "%ld", i);
+        sprintf(miss[i], "-%ld", i);
+        map_set(m, keys[i], "val");
+    }
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        map_get(m, miss[i]);
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_free(m);
+    free(keys);
+    free(miss);
+}
+
+/* Lookup the keys of a large map in a scattered order, most probes miss
+ * the TLB unless the table is on huge pages. */
+static void map_bench_get_large(struct bench_ctx *ctx, struct map *m) {
+    /* suite */
+    long i;
+    char(*keys)[12] = malloc(ctx->n * sizeof(*keys));
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(keys[i], "%ld", i);
+        map_set(m, keys[i], "val");
+    }
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        map_get(m, keys[(i * 7919) % ctx->n]);
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_free(m);
+    free(keys);
+}
+
+void case_map_get_large(struct bench_ctx *ctx) {
+    map_bench_get_large(ctx, map());
+}
+
+void case_map_get_huge(struct bench_ctx *ctx) {
+    map_bench_get_large(ctx, map_new_huge());
+}
+
+/* Pop a key and set another one back in turns, then lookup all live keys,
+ * reports the lookup cost after heavy set/pop churn. */
+void case_map_churn(struct bench_ctx *ctx) {
+    struct map *m = map();
+    /* suite */
+    long i;
+    char(*keys)[12] = malloc(2 * ctx->n * sizeof(*keys));
+    for (i = 0; i < 2 * ctx->n; i++) sprintf(keys[i], "%ld", i);
+    for (i = 0; i < ctx->n; i++) map_set(m, keys[i], "val");
+    for (i = 0; i < ctx->n; i++) {
+        map_pop(m, keys[i]);
+        map_set(m, keys[ctx->n + i], "val");
+    }
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        map_get(m, keys[ctx->n + i]);
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_free(m);
+    free(keys);
+}
+
+/* Set distinct long keys, most of the cost goes to hashing them on sets and
+ * on the resizes. */
+void case_map_set_long(struct bench_ctx *ctx) {
+    struct map *m = map();
+    /* keys suite */
+    long i;
+    char(*keys)[64] = malloc(ctx->n * sizeof(*keys));
+    for (i = 0; i < ctx->n; i++) sprintf(keys[i], "%063ld", i);
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        map_set(m, keys[i], "val");
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_free(m);
+    free(keys);
+}
+
+/* Hash keys of given length at varying offsets of a buffer, the results
+ * are summed up so that the calls can't be optimized out. */
+static void map_hash_bench(struct bench_ctx *ctx, size_t len) {
+    char buf[256 + 8];
+    long i;
+    uint64_t sum = 0;
+    for (i = 0; i < sizeof(buf); i++) buf[i] = 'a' + i % 26;
+    ctx->bytes = len;
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        sum += map_hash(buf + (i & 7), len, i);
+    }
+    bench_ctx_reset_end_at(ctx);
+    if (sum == 0) fprintf(stderr, "*");
+}
+
+void case_map_hash_4(struct bench_ctx *ctx) { map_hash_bench(ctx, 4); }
+void case_map_hash_16(struct bench_ctx *ctx) { map_hash_bench(ctx, 16); }
+void case_map_hash_64(struct bench_ctx *ctx) { map_hash_bench(ctx, 64); }
+void case_map_hash_256(struct bench_ctx *ctx) { map_hash_bench(ctx, 256); }
+
+void case_map_entry(struct bench_ctx *ctx) {
+    struct map *m = map();
+    /* keys suite */
+    int i;
+    char keys[ctx->n][4];
+    for (i = 0; i < ctx->n; i++) sprintf(keys[i], "%d", i & 999);
+    /* bench: count keys */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        void **val = map_entry(m, keys[i], NULL);
+        *val = (void *)((intptr_t)*val + 1);
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_free(m);
+}
+
+/* Lookup all keys of a big map one by one, or by batches of given size,
+ * the table is much larger than the cache. */
+static void map_iget_bench(struct bench_ctx *ctx, size_t batch) {
+    struct map *m = map();
+    /* suite */
+    long i;
+    char(*keys)[12] = malloc(ctx->n * sizeof(*keys));
+    char **ptrs = malloc(ctx->n * sizeof(char *));
+    size_t *lens = malloc(ctx->n * sizeof(size_t));
+    void *vals[256];
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(keys[i], "%ld", i);
+        ptrs[i] = keys[i];
+        lens[i] = strlen(keys[i]);
+        map_set(m, keys[i], "val");
+    }
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    if (batch == 1) {
+        for (i = 0; i < ctx->n; i++) map_iget(m, ptrs[i], lens[i]);
+    } else {
+        for (i = 0; i + batch <= ctx->n; i += batch)
+            map_iget_many(m, ptrs + i, lens + i, batch, vals);
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_free(m);
+    free(keys);
+    free(ptrs);
+    free(lens);
+}
+
+void case_map_iget(struct bench_ctx *ctx) { map_iget_bench(ctx, 1); }
+
+void case_map_iget_many(struct bench_ctx *ctx) { map_iget_bench(ctx, 64); }
+
+/* Set distinct keys formatted into a reused buffer, lookup and free them
+ * all, the keys are owned by the map or strdup-ed one by one. */
+static void map_keys_bench(struct bench_ctx *ctx, int own) {
+    struct map *m = own ? map_new_owned() : map();
+    long i;
+    char key[24];
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(key, "%ld", i);
+        map_set(m, own ? key : strdup(key), "val");
+    }
+    for (i = 0; i < ctx->n; i++) {
+        sprintf(key, "%ld", i);
+        map_get(m, key);
+    }
+    if (!own) {
+        struct map_iter iter = {m};
+        struct map_node *node = NULL;
+        map_each(&iter, node) free(node->key);
+    }
+    map_free(m);
+    bench_ctx_reset_end_at(ctx);
+}
+
+void case_map_keys_strdup(struct bench_ctx *ctx) { map_keys_bench(ctx, 0); }
+
+void case_map_keys_owned(struct bench_ctx *ctx) { map_keys_bench(ctx, 1); }
+
+#define map_bench_int_hash(key) ((uint64_t)(key))
+#define map_bench_int_eq(a, b) ((a) == (b))
+MAP_DEFINE(map_bench_ints, uint64_t, char *, map_bench_int_hash,
+           map_bench_int_eq)
+
+void case_map_define_get(struct bench_ctx *ctx) {
+    struct map_bench_ints *m = map_bench_ints_new();
+    /* suite */
+    long i;
+    for (i = 0; i < ctx->n; i++) map_bench_ints_set(m, i, "val");
+    /* bench: random order, same as u64map_get */
+    uint64_t x = 88172645463325252ull;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        map_bench_ints_get(m, x % ctx->n);
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_bench_ints_free(m);
+}
+
+#define MAP_BENCH_PROBE_CAP 131072 /* table size of the probe benches */
+
+/* Fill a map of MAP_BENCH_PROBE_CAP slots to the given load factor (in
+ * percent, over half the load limit so the table size holds), lookup its
+ * keys in a scattered order and report the probe lengths: the average and
+ * max probe distance of the nodes, and the groups probed per lookup. */
+static void map_probe_bench(struct bench_ctx *ctx, int load) {
+    struct map *m = map();
+    /* suite */
+    long i, n = (long)MAP_BENCH_PROBE_CAP * load / 100;
+    char(*keys)[12] = malloc(n * sizeof(*keys));
+    for (i = 0; i < n; i++) {
+        sprintf(keys[i], "%ld", i);
+        map_set(m, keys[i], "val");
+    }
+    map_stats_counting(m, 1);
+    /* bench */
+    uint64_t x = 88172645463325252ull;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        map_get(m, keys[x % n]);
+    }
+    bench_ctx_reset_end_at(ctx);
+    struct map_stats stats;
+    map_stats(m, &stats);
+    snprintf(ctx->note, sizeof(ctx->note),
+             "load %.2f dist avg %.2f max %zu groups/get %.2f", stats.load,
+             stats.dist_avg, stats.dist_max, stats.probes_avg);
+    map_free(m);
+    free(keys);
+}
+
+void case_map_probe_40(struct bench_ctx *ctx) { map_probe_bench(ctx, 40); }
+
+void case_map_probe_55(struct bench_ctx *ctx) { map_probe_bench(ctx, 55); }
+
+void case_map_probe_70(struct bench_ctx *ctx) { map_probe_bench(ctx, 70); }
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "map.h"
+#include "mph.h"
+
+static char **mph_bench_keys(long n) {
+    char **keys = malloc(n * sizeof(char *));
+    long i;
+    for (i = 0; i < n; i++) {
+        keys[i] = malloc(24);
+        sprintf(keys[i], "key%ld", i);
+    }
+    return keys;
+}
+
+static void mph_bench_keys_free(char **keys, long n) {
+    long i;
+    for (i = 0; i < n; i++) free(keys[i]);
+    free(keys);
+}
+
+void case_mph_new(struct bench_ctx *ctx) {
+    char **keys = mph_bench_keys(ctx->n);
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    struct mph *m = mph_new(keys, NULL, ctx->n);
+    bench_ctx_reset_end_at(ctx);
+    mph_free(m);
+    mph_bench_keys_free(keys, ctx->n);
+}
+
+void case_mph_get(struct bench_ctx *ctx) {
+    char **keys = mph_bench_keys(ctx->n);
+    /* suite: a table of keys ordered by index */
+    struct mph *m = mph_new(keys, NULL, ctx->n);
+    char **table = malloc(ctx->n * sizeof(char *));
+    long i;
+    for (i = 0; i < ctx->n; i++) table[mph_index(m, keys[i])] = keys[i];
+    /* bench: random order, one probe and one compare */
+    uint64_t x = 88172645463325252ull;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        char *key = keys[x % ctx->n];
+        size_t len = strlen(key);
+        size_t idx = mph_iindex(m, key, len);
+        if (strncmp(table[idx], key, len + 1) != 0) abort();
+    }
+    bench_ctx_reset_end_at(ctx);
+    free(table);
+    mph_free(m);
+    mph_bench_keys_free(keys, ctx->n);
+}
+
+void case_mph_map_get(struct bench_ctx *ctx) {
+    char **keys = mph_bench_keys(ctx->n);
+    /* suite: the same keys in a map */
+    struct map *m = map();
+    long i;
+    for (i = 0; i < ctx->n; i++) map_set(m, keys[i], keys[i]);
+    /* bench: random order */
+    uint64_t x = 88172645463325252ull;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        char *key = keys[x % ctx->n];
+        map_iget(m, key, strlen(key));
+    }
+    bench_ctx_reset_end_at(ctx);
+    map_free(m);
+    mph_bench_keys_free(keys, ctx->n);
+}
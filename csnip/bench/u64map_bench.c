@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "u64map.h"
+
+void case_u64map_set(struct bench_ctx *ctx) {
+    struct u64map *m = u64map();
+    /* bench */
+    long i;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        u64map_set(m, i, "val");
+    }
+    bench_ctx_reset_end_at(ctx);
+    u64map_free(m);
+}
+
+void case_u64map_get(struct bench_ctx *ctx) {
+    struct u64map *m = u64map();
+    /* suite */
+    long i;
+    for (i = 0; i < ctx->n; i++) u64map_set(m, i, "val");
+    /* bench: random order */
+    uint64_t x = 88172645463325252ull;
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        u64map_get(m, x % ctx->n);
+    }
+    bench_ctx_reset_end_at(ctx);
+    u64map_free(m);
+}
+
+void case_u64map_pop(struct bench_ctx *ctx) {
+    struct u64map *m = u64map();
+    /* suite */
+    long i;
+    for (i = 0; i < ctx->n; i++) u64map_set(m, i, "val");
+    /* bench */
+    bench_ctx_reset_start_at(ctx);
+    for (i = 0; i < ctx->n; i++) {
+        u64map_pop(m, i);
+    }
+    bench_ctx_reset_end_at(ctx);
+    u64map_free(m);
+}
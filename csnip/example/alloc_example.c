@@ -0,0 +1,31 @@
+// cc alloc_example.c alloc.c list.c
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "alloc.h"
+#include "list.h"
+
+int main(int argc, const char *argv[]) {
+    /* allocate list nodes from a slab */
+    struct alloc_slab *slab = alloc_slab_new(sizeof(struct list_node));
+    struct list *list = list_new_alloc(&slab->alloc);
+    assert(list_push(list, "a") == LIST_OK);
+    assert(list_push(list, "b") == LIST_OK);
+    /* popped nodes go back to the slab */
+    assert(list_pop(list) != NULL);
+    list_free(list);
+    alloc_slab_free(slab);
+    /* allocate per request memory from an arena */
+    struct alloc_arena *arena = alloc_arena_new(0);
+    int i;
+    for (i = 0; i < 3; i++) {
+        char *s = alloc_malloc(&arena->alloc, 32);
+        sprintf(s, "request %d", i);
+        printf("%s\n", s);
+        /* release all memory of the request at once */
+        alloc_arena_reset(arena);
+    }
+    alloc_arena_free(arena);
+    return 0;
+}
@@ -1,4 +1,4 @@
-// cc buf_example.c buf.c
+// cc buf_example.c buf.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
@@ -0,0 +1,25 @@
+// cc bufchain_example.c bufchain.c alloc.c
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "bufchain.h"
+
+int main(int argc, const char *argv[]) {
+    /* blocks from a slab are reused by the chains of the thread */
+    struct alloc_slab *blocks = alloc_slab_new(BUFCHAIN_BLOCK_SIZE);
+    struct bufchain *chain = bufchain_new(&blocks->alloc);
+    /* append data, it's never moved */
+    assert(bufchain_puts(chain, "hello ") == BUFCHAIN_OK);
+    assert(bufchain_puts(chain, "world\n") == BUFCHAIN_OK);
+    printf("chain length is %zu\n", bufchain_len(chain));
+    fflush(stdout);
+    /* flush to stdout by one writev, written data is consumed */
+    while (bufchain_len(chain) > 0)
+        if (bufchain_write_fd(chain, STDOUT_FILENO) < 0) break;
+    /* free the chain and the blocks */
+    bufchain_free(chain);
+    alloc_slab_free(blocks);
+    return 0;
+}
@@ -1,4 +1,4 @@
-// cc cfg_example.c cfg.c buf.c
+// cc cfg_example.c cfg.c buf.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
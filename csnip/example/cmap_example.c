@@ -0,0 +1,35 @@
+// cc cmap_example.c cmap.c map.c alloc.c -pthread
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "cmap.h"
+
+static void *reader(void *arg) {
+    struct cmap *m = arg;
+    /* lookups never lock nor wait for writers */
+    int i;
+    for (i = 0; i < 100000; i++) assert(cmap_get(m, "key1") != NULL);
+    return NULL;
+}
+
+int main(int argc, const char *argv[]) {
+    /* allocate a new cmap with 16 shards */
+    struct cmap *m = cmap();
+    /* set keys and values to cmap, keys are copied */
+    assert(cmap_set(m, "key1", "val1") == CMAP_OK);
+    assert(cmap_set(m, "key2", "val2") == CMAP_OK);
+    /* read from other threads while writing */
+    pthread_t tid;
+    pthread_create(&tid, NULL, &reader, m);
+    assert(cmap_set(m, "key3", "val3") == CMAP_OK);
+    assert(cmap_pop(m, "key2") != NULL);
+    pthread_join(tid, NULL);
+    printf("len: %zu, key1 => %s\n", cmap_len(m), (char *)cmap_get(m, "key1"));
+    /* no one is reading now, free popped nodes and replaced tables */
+    cmap_reclaim(m);
+    /* free the cmap */
+    cmap_free(m);
+    return 0;
+}
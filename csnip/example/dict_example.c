@@ -1,4 +1,4 @@
-// cc dict_example.c dict.c
+// cc dict_example.c dict.c map.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
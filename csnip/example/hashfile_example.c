@@ -0,0 +1,34 @@
+// cc hashfile_example.c hashfile.c map.c dict.c alloc.c
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hashfile.h"
+#include "map.h"
+
+int main(int argc, const char *argv[]) {
+    /* build a map and dump it to a hash file, vals are strings */
+    struct map *m = map();
+    assert(map_set(m, "key1", "val1") == MAP_OK);
+    assert(map_set(m, "key2", "val2") == MAP_OK);
+    assert(hashfile_dump_map(m, "example.db", NULL) == HASHFILE_OK);
+    map_free(m);
+    /* or write records one by one */
+    struct hashfile_writer *w = hashfile_writer_new("example2.db");
+    assert(w != NULL);
+    assert(hashfile_writer_put(w, "key", 3, "val", 3) == HASHFILE_OK);
+    assert(hashfile_writer_close(w) == HASHFILE_OK);
+    /* open the hash file, it's mapped, not loaded */
+    struct hashfile *hf = hashfile_open("example.db");
+    assert(hf != NULL);
+    assert(hashfile_len(hf) == 2);
+    /* get val by key, it points into the file */
+    printf("key1 => %s\n", hashfile_get(hf, "key1"));
+    assert(hashfile_get(hf, "key3") == NULL);
+    /* close the hash file */
+    hashfile_close(hf);
+    remove("example.db");
+    remove("example2.db");
+    return 0;
+}
@@ -1,4 +1,4 @@
-// cc heap_example.c heap.c
+// cc heap_example.c heap.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
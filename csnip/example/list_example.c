@@ -1,4 +1,4 @@
-// cc list_example.c list.c
+// cc list_example.c list.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
@@ -1,4 +1,4 @@
-// cc map_example.c map.c
+// cc map_example.c map.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
@@ -0,0 +1,38 @@
+// cc mph_example.c mph.c map.c alloc.c
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mph.h"
+
+int main(int argc, const char *argv[]) {
+    /* a static key set */
+    char *keys[] = {"get", "set", "del", "ping"};
+    char *descs[] = {"get a key", "set a key", "delete a key", "ping"};
+    /* build a mph from the keys */
+    struct mph *m = mph_new(keys, NULL, 4);
+    assert(m != NULL);
+    /* place the entries by index */
+    char *ktable[4], *vtable[4];
+    int i;
+    for (i = 0; i < 4; i++) {
+        size_t idx = mph_index(m, keys[i]);
+        ktable[idx] = keys[i];
+        vtable[idx] = descs[i];
+    }
+    /* lookup: one probe and one compare */
+    size_t idx = mph_index(m, "del");
+    if (strcmp(ktable[idx], "del") == 0) printf("del => %s\n", vtable[idx]);
+    idx = mph_index(m, "quit");
+    assert(strcmp(ktable[idx], "quit") != 0);
+    /* save to file and load it back */
+    assert(mph_dump(m, "example.mph") == MPH_OK);
+    struct mph *m2 = mph_load("example.mph");
+    assert(m2 != NULL && mph_index(m2, "del") == mph_index(m, "del"));
+    remove("example.mph");
+    /* free the mphs */
+    mph_free(m);
+    mph_free(m2);
+    return 0;
+}
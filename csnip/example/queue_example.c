@@ -1,4 +1,4 @@
-// cc queue_example.c queue.c
+// cc queue_example.c queue.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
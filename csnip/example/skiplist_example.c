@@ -1,4 +1,4 @@
-// cc skiplist_example.c skiplist.c
+// cc skiplist_example.c skiplist.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
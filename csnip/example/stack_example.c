@@ -1,4 +1,4 @@
-// cc stack_example.c stack.c
+// cc stack_example.c stack.c alloc.c
 
 #include <assert.h>
 #include <stdio.h>
@@ -0,0 +1,32 @@
+// cc u64map_example.c u64map.c
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "u64map.h"
+
+int main(int argc, const char *argv[]) {
+    /* allocate a new u64map */
+    struct u64map *m = u64map();
+    /* set integer keys, e.g. fds, no need to format them to strings */
+    assert(u64map_set(m, 3, "conn3") == U64MAP_OK);
+    assert(u64map_set(m, 7, "conn7") == U64MAP_OK);
+    assert(u64map_set(m, 0, "conn0") == U64MAP_OK);
+    /* get map length */
+    assert(u64map_len(m) == 3);
+    /* get data by key */
+    assert(u64map_get(m, 7) != NULL);
+    assert(u64map_get(m, 8) == NULL);
+    /* pop a key */
+    assert(u64map_pop(m, 7) != NULL);
+    /* iterate the map */
+    struct u64map_iter iter = {m};
+    struct u64map_node *node = NULL;
+    u64map_each(&iter, node) {
+        printf("%llu => %s\n", (unsigned long long)node->key,
+               (char *)node->val);
+    }
+    /* free the map */
+    u64map_free(m);
+    return 0;
+}
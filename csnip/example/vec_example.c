@@ -0,0 +1,33 @@
+// cc vec_example.c alloc.c
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "vec.h"
+
+struct point {
+    int x;
+    int y;
+};
+
+/* define a vec of points, stored inline */
+VEC_DEFINE(points, struct point)
+
+int main(int argc, const char *argv[]) {
+    /* allocate a new vec */
+    struct points *v = points_new();
+    /* push elements */
+    struct point p = {1, 2};
+    assert(points_push(v, p) == VEC_OK);
+    p.x = 3;
+    assert(points_push(v, p) == VEC_OK);
+    /* get vec length */
+    assert(points_len(v) == 2);
+    /* get element by index */
+    printf("(%d, %d)\n", points_at(v, 1)->x, points_at(v, 1)->y);
+    /* pop the last element */
+    assert(points_pop(v, &p) == 1 && p.x == 3);
+    /* free the vec */
+    points_free(v);
+    return 0;
+}
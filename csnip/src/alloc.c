@@ -0,0 +1,397 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+
+/* Round size up to ALLOC_ALIGN. */
+static inline size_t alloc_align(size_t size) {
+    return (size + ALLOC_ALIGN - 1) & ~(size_t)(ALLOC_ALIGN - 1);
+}
+
+static void *alloc_libc_malloc(void *ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *alloc_libc_realloc(void *ctx, void *ptr, size_t old_size,
+                                size_t size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, size);
+}
+
+static void alloc_libc_free(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+static struct alloc alloc_libc_funcs = {
+    &alloc_libc_malloc, &alloc_libc_realloc, &alloc_libc_free, NULL};
+static __thread struct alloc *alloc_thread = &alloc_libc_funcs;
+
+/* Get the libc malloc allocator, thread safe. */
+struct alloc *alloc_libc(void) { return &alloc_libc_funcs; }
+
+/* Get the default allocator of the calling thread. */
+struct alloc *alloc_default(void) { return alloc_thread; }
+
+/* Set the default allocator of the calling thread, NULL for libc malloc.
+ * Other threads keep theirs, so a shipped allocator set as default is used
+ * by its thread only. Containers keep the allocator they are created with,
+ * and memory must be freed by the allocator it's from. */
+void alloc_set_default(struct alloc *a) {
+    alloc_thread = a != NULL ? a : &alloc_libc_funcs;
+}
+
+/* Allocate memory from allocator, NULL for the default. */
+void *alloc_malloc(struct alloc *a, size_t size) {
+    if (a == NULL) a = alloc_thread;
+    return (a->malloc)(a->ctx, size);
+}
+
+/* Resize memory allocated from allocator, NULL for the default. */
+void *alloc_realloc(struct alloc *a, void *ptr, size_t old_size,
+                    size_t size) {
+    if (a == NULL) a = alloc_thread;
+    return (a->realloc)(a->ctx, ptr, old_size, size);
+}
+
+/* Free memory allocated from allocator, NULL for the default. */
+void alloc_free(struct alloc *a, void *ptr, size_t size) {
+    if (a == NULL) a = alloc_thread;
+    if (ptr != NULL) (a->free)(a->ctx, ptr, size);
+}
+
+static void *alloc_arena_malloc(void *ctx, size_t size) {
+    struct alloc_arena *arena = ctx;
+
+    size = alloc_align(size);
+
+    if (size > (size_t)(arena->end - arena->ptr)) {
+        size_t chunk_size = arena->chunk_size;
+
+        if (size > chunk_size) chunk_size = size;
+
+        struct alloc_arena_chunk *chunk =
+            malloc(sizeof(struct alloc_arena_chunk) + chunk_size);
+
+        if (chunk == NULL) return NULL;
+
+        chunk->size = chunk_size;
+
+        /* a large allocation takes a chunk of its own, behind the current
+         * one, which keeps serving */
+        if (size > arena->chunk_size && arena->chunks != NULL) {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+            return chunk->data;
+        }
+
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->ptr = chunk->data;
+        arena->end = chunk->data + chunk_size;
+    }
+
+    arena->last = arena->ptr;
+    arena->ptr += size;
+    return arena->last;
+}
+
+static void *alloc_arena_realloc(void *ctx, void *ptr, size_t old_size,
+                                 size_t size) {
+    struct alloc_arena *arena = ctx;
+
+    if (ptr == NULL) return alloc_arena_malloc(ctx, size);
+
+    /* the last allocation grows or shrinks in place */
+    if (ptr == arena->last &&
+        alloc_align(size) <= (size_t)(arena->end - arena->last)) {
+        arena->ptr = arena->last + alloc_align(size);
+        return ptr;
+    }
+
+    if (size <= old_size) return ptr;
+
+    void *new_ptr = alloc_arena_malloc(ctx, size);
+
+    if (new_ptr != NULL) memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+static void alloc_arena_release(void *ctx, void *ptr, size_t size) {
+    struct alloc_arena *arena = ctx;
+    (void)size;
+
+    /* only the last allocation is taken back */
+    if (ptr == arena->last) {
+        arena->ptr = arena->last;
+        arena->last = NULL;
+    }
+}
+
+/* Create an arena allocating chunks of given size, 0 for the default. */
+struct alloc_arena *alloc_arena_new(size_t chunk_size) {
+    struct alloc_arena *arena = malloc(sizeof(struct alloc_arena));
+
+    if (arena != NULL) {
+        arena->alloc.malloc = &alloc_arena_malloc;
+        arena->alloc.realloc = &alloc_arena_realloc;
+        arena->alloc.free = &alloc_arena_release;
+        arena->alloc.ctx = arena;
+        arena->chunk_size =
+            alloc_align(chunk_size > 0 ? chunk_size : ALLOC_ARENA_CHUNK);
+        arena->chunks = NULL;
+        arena->ptr = NULL;
+        arena->end = NULL;
+        arena->last = NULL;
+    }
+    return arena;
+}
+
+/* Free arena and all memory allocated from it. */
+void alloc_arena_free(struct alloc_arena *arena) {
+    if (arena != NULL) {
+        while (arena->chunks != NULL) {
+            struct alloc_arena_chunk *next = arena->chunks->next;
+            free(arena->chunks);
+            arena->chunks = next;
+        }
+        free(arena);
+    }
+}
+
+/* Free all memory allocated from arena at once. The current chunk is kept
+ * for the following allocations. */
+void alloc_arena_reset(struct alloc_arena *arena) {
+    assert(arena != NULL);
+
+    if (arena->chunks == NULL) return;
+
+    while (arena->chunks->next != NULL) {
+        struct alloc_arena_chunk *next = arena->chunks->next->next;
+        free(arena->chunks->next);
+        arena->chunks->next = next;
+    }
+
+    arena->ptr = arena->chunks->data;
+    arena->last = NULL;
+}
+
+static void *alloc_slab_malloc(void *ctx, size_t size) {
+    struct alloc_slab *slab = ctx;
+
+    if (size > slab->size) return malloc(size);
+
+    if (slab->free_objs == NULL) {
+        struct alloc_slab_block *block = malloc(
+            sizeof(struct alloc_slab_block) + slab->objs * slab->size);
+
+        if (block == NULL) return NULL;
+
+        block->next = slab->blocks;
+        slab->blocks = block;
+
+        /* link in reverse, so objects are taken in address order */
+        size_t i = slab->objs;
+
+        while (i > 0) {
+            void **obj = (void **)(block->data + --i * slab->size);
+            *obj = slab->free_objs;
+            slab->free_objs = obj;
+        }
+    }
+
+    void **obj = slab->free_objs;
+    slab->free_objs = *obj;
+    return obj;
+}
+
+static void alloc_slab_release(void *ctx, void *ptr, size_t size) {
+    struct alloc_slab *slab = ctx;
+
+    if (size > slab->size) {
+        free(ptr);
+        return;
+    }
+
+    *(void **)ptr = slab->free_objs;
+    slab->free_objs = ptr;
+}
+
+static void *alloc_slab_realloc(void *ctx, void *ptr, size_t old_size,
+                                size_t size) {
+    struct alloc_slab *slab = ctx;
+
+    if (ptr == NULL) return alloc_slab_malloc(ctx, size);
+
+    if (old_size > slab->size && size > slab->size)
+        return realloc(ptr, size);
+
+    if (old_size <= slab->size && size <= slab->size) return ptr;
+
+    void *new_ptr = alloc_slab_malloc(ctx, size);
+
+    if (new_ptr == NULL) return NULL;
+
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    alloc_slab_release(ctx, ptr, old_size);
+    return new_ptr;
+}
+
+/* Create a slab allocator for objects of given size, in blocks of
+ * ALLOC_SLAB_BLOCK bytes. Larger allocations go to libc. */
+struct alloc_slab *alloc_slab_new(size_t size) {
+    struct alloc_slab *slab = malloc(sizeof(struct alloc_slab));
+
+    if (slab != NULL) {
+        slab->alloc.malloc = &alloc_slab_malloc;
+        slab->alloc.realloc = &alloc_slab_realloc;
+        slab->alloc.free = &alloc_slab_release;
+        slab->alloc.ctx = slab;
+        slab->size = alloc_align(size > 0 ? size : 1);
+        slab->objs = ALLOC_SLAB_BLOCK / slab->size;
+        if (slab->objs == 0) slab->objs = 1;
+        slab->blocks = NULL;
+        slab->free_objs = NULL;
+    }
+    return slab;
+}
+
+/* Free slab allocator and all objects allocated from it. The larger
+ * allocations passed to libc are not freed. */
+void alloc_slab_free(struct alloc_slab *slab) {
+    if (slab != NULL) {
+        while (slab->blocks != NULL) {
+            struct alloc_slab_block *next = slab->blocks->next;
+            free(slab->blocks);
+            slab->blocks = next;
+        }
+        free(slab);
+    }
+}
+
+/* Round size up to ALLOC_HUGE_PAGE. */
+static inline size_t alloc_huge_round(size_t size) {
+    return (size + ALLOC_HUGE_PAGE - 1) & ~(size_t)(ALLOC_HUGE_PAGE - 1);
+}
+
+/* Touch each page of memory, so later accesses take no page faults. */
+static void alloc_huge_prefault(char *p, size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i += ALLOC_PAGE) ((volatile char *)p)[i] = 0;
+}
+
+/* Map memory of given size (rounded to huge pages) from the reserved huge
+ * pages, or else aligned to the huge page size and advised for transparent
+ * huge pages. The memory is zeroed and pre-faulted, unless `lazy`: then it
+ * is only advised, pages are faulted in on first touch. */
+static void *alloc_huge_map(size_t size, int lazy) {
+    char *p;
+
+#ifdef MAP_HUGETLB
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    p = lazy ? MAP_FAILED
+             : mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+    if (p != MAP_FAILED) return p;
+#endif
+
+    /* map one more huge page and trim to the aligned part */
+    p = mmap(NULL, size + ALLOC_HUGE_PAGE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED) return NULL;
+
+    size_t head = (ALLOC_HUGE_PAGE - (uintptr_t)p % ALLOC_HUGE_PAGE) %
+                  ALLOC_HUGE_PAGE;
+
+    if (head > 0) munmap(p, head);
+    munmap(p + head + size, ALLOC_HUGE_PAGE - head);
+    p += head;
+
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+    if (!lazy) alloc_huge_prefault(p, size);
+    return p;
+}
+
+/* Allocate zeroed memory backed by huge pages if possible, pre-faulted.
+ * Allocations smaller than a huge page go to libc. Free it by
+ * `alloc_huge_free` with the same size. */
+void *alloc_huge(size_t size) {
+    if (size < ALLOC_HUGE_PAGE) return calloc(1, size > 0 ? size : 1);
+    return alloc_huge_map(alloc_huge_round(size), 0);
+}
+
+/* Allocate zeroed memory advised for transparent huge pages, not
+ * pre-faulted: the pages are faulted in as they are touched, e.g. for a
+ * table filled a bit at a time. Free it by `alloc_huge_free`. */
+void *alloc_huge_lazy(size_t size) {
+    if (size < ALLOC_HUGE_PAGE) return calloc(1, size > 0 ? size : 1);
+    return alloc_huge_map(alloc_huge_round(size), 1);
+}
+
+/* Resize memory from `alloc_huge`, the grown part is not zeroed. Memory
+ * stays in place while it fits in its huge pages. */
+void *alloc_huge_realloc(void *ptr, size_t old_size, size_t size) {
+    if (ptr == NULL) return alloc_huge(size);
+
+    if (old_size < ALLOC_HUGE_PAGE && size < ALLOC_HUGE_PAGE)
+        return realloc(ptr, size > 0 ? size : 1);
+
+    if (old_size >= ALLOC_HUGE_PAGE && size >= ALLOC_HUGE_PAGE) {
+        size_t old_mapped = alloc_huge_round(old_size);
+        size_t mapped = alloc_huge_round(size);
+
+        if (mapped == old_mapped) return ptr;
+
+        if (mapped < old_mapped) {
+            munmap((char *)ptr + mapped, old_mapped - mapped);
+            return ptr;
+        }
+#ifdef MREMAP_MAYMOVE
+        /* move the page tables instead of copying */
+        char *p = mremap(ptr, old_mapped, mapped, MREMAP_MAYMOVE);
+
+        if (p != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(p, mapped, MADV_HUGEPAGE);
+#endif
+            alloc_huge_prefault(p + old_mapped, mapped - old_mapped);
+            return p;
+        }
+#endif
+    }
+
+    void *new_ptr = alloc_huge(size);
+
+    if (new_ptr == NULL) return NULL;
+
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    alloc_huge_free(ptr, old_size);
+    return new_ptr;
+}
+
+/* Free memory from `alloc_huge` of given size. */
+void alloc_huge_free(void *ptr, size_t size) {
+    if (ptr == NULL) return;
+
+    if (size < ALLOC_HUGE_PAGE)
+        free(ptr);
+    else
+        munmap(ptr, alloc_huge_round(size));
+}
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ *
+ * Pluggable memory allocators. An allocator is a table of functions with
+ * a context, containers created with one (e.g. `list_new_alloc`) allocate
+ * their nodes from it, others from the default of the thread creating
+ * them, which is libc malloc unless set. Frees are sized, so allocators
+ * need no headers. Shipped allocators, not thread safe, one per thread or
+ * container:
+ *
+ *   arena   bump allocator, frees are no-ops, all memory is released at
+ *           once by `alloc_arena_reset`, e.g. per request
+ *   slab    fixed-size objects on a free list, e.g. nodes of a container,
+ *           larger requests fall back to libc
+ *
+ * Large arrays (e.g. hashtables) may be backed by huge pages instead, by
+ * `alloc_huge`: probes into them then miss the TLB far less often. Tables
+ * filled a bit at a time take `alloc_huge_lazy`, not pre-faulted.
+ *
+ * deps: None.
+ */
+
+#ifndef __ALLOC_H__
+#define __ALLOC_H__
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define ALLOC_ALIGN 16                    /* alignment of allocations */
+#define ALLOC_ARENA_CHUNK (64 * 1024)     /* default arena chunk size */
+#define ALLOC_SLAB_BLOCK (4 * 1024)       /* slab block size */
+#define ALLOC_PAGE (4 * 1024)             /* page size, stride of pre-fault */
+#define ALLOC_HUGE_PAGE (2 * 1024 * 1024) /* huge page size */
+
+/* allocator interface, `realloc` and `free` are given the size the memory
+ * was allocated or last resized with. */
+struct alloc {
+    void *(*malloc)(void *ctx, size_t size);
+    void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t size);
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx; /* allocator state, passed to the functions */
+};
+
+struct alloc_arena_chunk {
+    struct alloc_arena_chunk *next; /* next (older) chunk */
+    size_t size;                    /* chunk data size */
+    char data[];                    /* chunk memory */
+};
+
+struct alloc_arena {
+    struct alloc alloc;               /* allocator interface */
+    size_t chunk_size;                /* chunk size */
+    struct alloc_arena_chunk *chunks; /* chunks, the current first */
+    char *ptr;                        /* free memory in current chunk */
+    char *end;                        /* end of current chunk */
+    char *last;                       /* last allocation, may grow */
+};
+
+struct alloc_slab_block {
+    struct alloc_slab_block *next; /* next (older) block */
+    size_t unused;                 /* padding */
+    char data[];                   /* objects memory */
+};
+
+struct alloc_slab {
+    struct alloc alloc;              /* allocator interface */
+    size_t size;                     /* object size */
+    size_t objs;                     /* objects per block */
+    struct alloc_slab_block *blocks; /* blocks */
+    void *free_objs;                 /* free objects, linked in place */
+};
+
+struct alloc *alloc_libc(void);
+struct alloc *alloc_default(void);
+void alloc_set_default(struct alloc *a);
+void *alloc_malloc(struct alloc *a, size_t size);
+void *alloc_realloc(struct alloc *a, void *ptr, size_t old_size,
+                    size_t size);
+void alloc_free(struct alloc *a, void *ptr, size_t size);
+struct alloc_arena *alloc_arena_new(size_t chunk_size);
+void alloc_arena_free(struct alloc_arena *arena);
+void alloc_arena_reset(struct alloc_arena *arena); /* O(chunks) */
+struct alloc_slab *alloc_slab_new(size_t size);
+void alloc_slab_free(struct alloc_slab *slab); /* O(blocks) */
+void *alloc_huge(size_t size);
+void *alloc_huge_lazy(size_t size);
+void *alloc_huge_realloc(void *ptr, size_t old_size, size_t size);
+void alloc_huge_free(void *ptr, size_t size);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
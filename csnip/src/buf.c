@@ -4,10 +4,14 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "buf.h"
 
@@ -19,8 +23,11 @@ struct buf *buf_new(const char *s) {
 
     if (buf != NULL) {
         buf->len = 0;
-        buf->cap = 0;
-        buf->data = NULL;
+        buf->cap = BUF_SMALL_CAP;
+        buf->data = buf->small;
+        buf->off = 0;
+        buf->max = BUF_CAP_MAX;
+        buf->alloc = alloc_default();
 
         if (s != NULL) {
             if (buf_puts(buf, s) != BUF_OK) return NULL;
@@ -33,51 +40,132 @@ struct buf *buf_new(const char *s) {
 struct buf *buf_empty(void) {
     return buf_new(NULL);
 }
+
+/* Create empty buffer with an allocator for its data, NULL for the
+ * default. */
+struct buf *buf_new_alloc(struct alloc *a) {
+    struct buf *buf = buf_new(NULL);
+
+    if (buf != NULL && a != NULL) buf->alloc = a;
+    return buf;
+}
+
+/* Free the data memory of a buffer, unless it's the inline storage. */
+static void buf_data_free(struct buf *buf) {
+    char *mem = buf->data - buf->off;
+
+    if (mem != buf->small)
+        alloc_free(buf->alloc, mem, buf->off + buf->cap);
+}
+
 /* Free a buffer and its data, no operation is performed
  * if the buffer is NULL. */
 void buf_free(struct buf *buf) {
     if (buf != NULL) {
-        if (buf->data != NULL) free(buf->data);
+        buf_data_free(buf);
         free(buf);
     }
 }
 
-/* Clear a buffer and the data memory will also be freed. */
+/* Clear a buffer and the data memory will also be freed, the buffer is
+ * back to its inline storage. */
 void buf_clear(struct buf *buf) {
     assert(buf != NULL);
 
-    if (buf->data != NULL) free(buf->data);
-    buf->data = NULL;
+    buf_data_free(buf);
+    buf->data = buf->small;
+    buf->off = 0;
     buf->len = 0;
-    buf->cap = 0;
+    buf->cap = BUF_SMALL_CAP;
+}
+
+/* Move the data to the start of the memory, reclaiming the consumed
+ * bytes. */
+static void buf_compact(struct buf *buf) {
+    if (buf->off == 0) return;
+
+    memmove(buf->data - buf->off, buf->data, buf->len);
+    buf->data -= buf->off;
+    buf->cap += buf->off;
+    buf->off = 0;
+}
+
+/* Move the data into memory of given cap, which holds its length. */
+static int buf_realloc(struct buf *buf, size_t cap) {
+    char *data;
+
+    buf_compact(buf);
+
+    if (buf->data == buf->small) {
+        if ((data = alloc_malloc(buf->alloc, cap)) == NULL) return BUF_ENOMEM;
+        memcpy(data, buf->small, buf->len);
+    } else {
+        data = alloc_realloc(buf->alloc, buf->data, buf->cap, cap);
+        if (data == NULL) return BUF_ENOMEM;
+    }
+
+    buf->data = data;
+    buf->cap = cap;
+    return BUF_OK;
 }
 
-/* Grow a buffer's capacity to given size, the new capacity is
- * calculated like k*unit>=cap, by default, the unit is current cap,
- * if the unit is large enough, use BUF_UNIT_MAX instead. */
+/* Grow a buffer's capacity to given size, the capacity is doubled (at
+ * least) so puts are amortized O(1), up to the buffer's max capacity. */
 int buf_grow(struct buf *buf, size_t cap) {
     assert(buf != NULL);
 
-    if (cap > BUF_CAP_MAX) return BUF_ENOMEM;
+    if (cap > buf->max) return BUF_ENOMEM;
 
     if (cap <= buf->cap) return BUF_OK;
 
-    size_t unit = buf->cap;
+    /* reclaim the consumed bytes first, the memmove is no more than what a
+     * realloc would copy */
+    buf_compact(buf);
 
-    if (unit > BUF_UNIT_MAX) unit = BUF_UNIT_MAX;
+    if (cap <= buf->cap) return BUF_OK;
 
-    if (unit < BUF_UNIT_MIN) unit = BUF_UNIT_MIN;
+    size_t new_cap = buf->cap * 2;
 
-    size_t new_cap = buf->cap + unit;
-    while (new_cap < cap) new_cap += unit;
+    if (new_cap < cap) new_cap = cap;
 
-    char *data = realloc(buf->data, new_cap * sizeof(char));
+    if (new_cap > buf->max) new_cap = buf->max;
 
-    if (data == NULL) return BUF_ENOMEM;
+    return buf_realloc(buf, new_cap);
+}
 
-    buf->data = data;
-    buf->cap = new_cap;
-    return BUF_OK;
+/* Reserve capacity for `len` more bytes. */
+int buf_reserve(struct buf *buf, size_t len) {
+    assert(buf != NULL);
+
+    if (len > buf->max) return BUF_ENOMEM;
+    return buf_grow(buf, buf->len + len);
+}
+
+/* Shrink buffer memory to its length, short data goes back to the inline
+ * storage. The capacity of heap memory is exactly the length after. */
+int buf_shrink_to_fit(struct buf *buf) {
+    assert(buf != NULL);
+
+    buf_compact(buf);
+
+    if (buf->data == buf->small || buf->cap == buf->len) return BUF_OK;
+
+    if (buf->len <= BUF_SMALL_CAP) {
+        char *data = buf->data;
+        memcpy(buf->small, data, buf->len);
+        alloc_free(buf->alloc, data, buf->cap);
+        buf->data = buf->small;
+        buf->cap = BUF_SMALL_CAP;
+        return BUF_OK;
+    }
+    return buf_realloc(buf, buf->len);
+}
+
+/* Set the max capacity of a buffer, BUF_CAP_MAX by default. Growing over
+ * it fails with BUF_ENOMEM. */
+void buf_set_max(struct buf *buf, size_t max) {
+    assert(buf != NULL);
+    buf->max = max;
 }
 
 /* Put chars on the end of a buffer */
@@ -159,17 +247,171 @@ int buf_sprintf(struct buf *buf, const char *fmt, ...) {
     return BUF_OK;
 }
 
-/* Romve part of buf on the left. */
+/* Two digits of 0..99 each. */
+static const char buf_digits[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Powers of 10 of the fast double precisions. */
+static const uint64_t buf_pow10[] = {
+    1,      10,      100,      1000,      10000,
+    100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+/* Get the number of decimal digits of v. */
+static size_t buf_u64_digits(uint64_t v) {
+    size_t n = 1;
+
+    for (;;) {
+        if (v < 10) return n;
+        if (v < 100) return n + 1;
+        if (v < 1000) return n + 2;
+        if (v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
+    }
+}
+
+/* Write the n decimal digits of v to p, backward by two digits a time,
+ * zeros are padded on the left. */
+static void buf_u64_write(char *p, size_t n, uint64_t v) {
+    p += n;
+
+    while (v >= 100) {
+        size_t i = (size_t)(v % 100) * 2;
+        v /= 100;
+        *--p = buf_digits[i + 1];
+        *--p = buf_digits[i];
+        n -= 2;
+    }
+
+    if (v >= 10) {
+        *--p = buf_digits[v * 2 + 1];
+        *--p = buf_digits[v * 2];
+        n -= 2;
+    } else {
+        *--p = '0' + v;
+        n -= 1;
+    }
+
+    while (n-- > 0) *--p = '0';
+}
+
+/* Put an unsigned integer in decimal to the end of a buffer, like "%llu"
+ * but without vsnprintf. */
+int buf_put_u64(struct buf *buf, uint64_t v) {
+    size_t n = buf_u64_digits(v);
+    int error = buf_grow(buf, buf->len + n);
+
+    if (error == BUF_OK) {
+        buf_u64_write(buf->data + buf->len, n, v);
+        buf->len += n;
+    }
+    return error;
+}
+
+/* Put a signed integer in decimal to the end of a buffer, like "%lld". */
+int buf_put_i64(struct buf *buf, int64_t v) {
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    size_t n = buf_u64_digits(u) + (v < 0);
+    int error = buf_grow(buf, buf->len + n);
+
+    if (error == BUF_OK) {
+        char *p = buf->data + buf->len;
+
+        if (v < 0) *p++ = '-';
+        buf_u64_write(p, n - (v < 0), u);
+        buf->len += n;
+    }
+    return error;
+}
+
+/* Put an unsigned integer in lowercase hex to the end of a buffer, like
+ * "%llx". */
+int buf_put_hex(struct buf *buf, uint64_t v) {
+    size_t n = (64 - __builtin_clzll(v | 1) + 3) / 4;
+    int error = buf_grow(buf, buf->len + n);
+
+    if (error == BUF_OK) {
+        char *p = buf->data + buf->len + n;
+
+        do {
+            *--p = "0123456789abcdef"[v & 0xf];
+            v >>= 4;
+        } while (v > 0);
+        buf->len += n;
+    }
+    return error;
+}
+
+/* Put a double with `prec` digits after the point to the end of a buffer,
+ * the same as "%.*f". Precisions up to BUF_DOUBLE_PREC_MAX of values under
+ * 1e15 after scaling are formatted as integers. Others, the values whose
+ * rounding is too close to call, infinities and nans go to
+ * `buf_sprintf`. */
+int buf_put_double(struct buf *buf, double v, int prec) {
+    assert(buf != NULL);
+    assert(prec >= 0);
+
+    double a = v < 0 ? -v : v;
+
+    if (!isfinite(v) || prec > BUF_DOUBLE_PREC_MAX)
+        return buf_sprintf(buf, "%.*f", prec, v);
+
+    /* the scaled value is off by half an ulp at most, exact ties and
+     * values within the error of a tie are left to vsnprintf */
+    double scaled = a * buf_pow10[prec];
+
+    if (scaled >= 1e15) return buf_sprintf(buf, "%.*f", prec, v);
+
+    uint64_t r = (uint64_t)scaled;
+    double frac = scaled - (double)r;
+    double err = scaled * 1e-15;
+
+    if (frac - 0.5 <= err && 0.5 - frac <= err)
+        return buf_sprintf(buf, "%.*f", prec, v);
+
+    if (frac > 0.5) r++;
+
+    uint64_t ip = r / buf_pow10[prec];
+    int neg = signbit(v) != 0;
+    size_t ipn = buf_u64_digits(ip);
+    size_t n = neg + ipn + (prec > 0 ? prec + 1 : 0);
+    int error = buf_grow(buf, buf->len + n);
+
+    if (error == BUF_OK) {
+        char *p = buf->data + buf->len;
+
+        if (neg) *p++ = '-';
+        buf_u64_write(p, ipn, ip);
+
+        if (prec > 0) {
+            p[ipn] = '.';
+            buf_u64_write(p + ipn + 1, prec, r % buf_pow10[prec]);
+        }
+        buf->len += n;
+    }
+    return error;
+}
+
+/* Romve part of buf on the left. The data pointer moves forward, so it's
+ * O(1), the bytes are reclaimed on grow or once the buf is drained. */
 void buf_lrm(struct buf *buf, size_t len) {
     assert(buf != NULL);
 
-    if (len > buf->len) {
+    if (len >= buf->len) {
         buf->len = 0;
+        buf_compact(buf);
         return;
     }
 
+    buf->data += len;
+    buf->off += len;
+    buf->cap -= len;
     buf->len -= len;
-    memmove(buf->data, buf->data + len, buf->len);
 }
 
 /* Get buf length. */
@@ -183,3 +425,177 @@ size_t buf_cap(struct buf *buf) {
     assert(buf != NULL);
     return buf->cap;
 }
+
+/* Read from fd once, appending to buffer. The read fills the free space of
+ * the buffer and a stack spill area by one `readv`, the buffer only grows
+ * by what is read into the spill, so idle buffers stay small. A `hint` of
+ * the expected size reserves the space beforehand, 0 for none. Returns
+ * like read(2): the number of bytes read, 0 on EOF, -1 on error with errno
+ * set, EAGAIN if a non-blocking fd is drained, ENOMEM if the buffer can't
+ * hold more (the spilled bytes are lost if it fails to grow). */
+ssize_t buf_read_fd(struct buf *buf, int fd, size_t hint) {
+    assert(buf != NULL);
+
+    if (hint > 0 && buf_reserve(buf, hint) != BUF_OK) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    char spill[BUF_READ_SPILL];
+    size_t room = buf->max > buf->len ? buf->max - buf->len : 0;
+    size_t avail = buf->cap - buf->len;
+    struct iovec iov[2];
+
+    if (room == 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (avail > room) avail = room;
+
+    iov[0].iov_base = buf->data + buf->len;
+    iov[0].iov_len = avail;
+    iov[1].iov_base = spill;
+    iov[1].iov_len = room - avail;
+
+    if (iov[1].iov_len > sizeof(spill)) iov[1].iov_len = sizeof(spill);
+
+    ssize_t n;
+
+    do {
+        n = readv(fd, iov, 2);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) return n;
+
+    if ((size_t)n <= avail) {
+        buf->len += n;
+        return n;
+    }
+
+    buf->len += avail;
+
+    if (buf_put(buf, spill, n - avail) != BUF_OK) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return n;
+}
+
+/* Write buffer data to fd once, the written bytes are consumed from the
+ * buffer in O(1). Returns like write(2): the number of bytes written, -1
+ * on error with errno set, EAGAIN if a non-blocking fd is full. */
+ssize_t buf_write_fd(struct buf *buf, int fd) {
+    assert(buf != NULL);
+
+    if (buf->len == 0) return 0;
+
+    ssize_t n;
+
+    do {
+        n = write(fd, buf->data, buf->len);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) buf_lrm(buf, n);
+    return n;
+}
+
+/* Share the data of a buffer as a refcounted immutable block. Heap memory
+ * is taken over without copying, short inline data is copied. The buffer
+ * is left empty and can be reused. Returns the block with one reference
+ * held by the caller, NULL on no memory (the buffer is untouched). */
+struct buf_shared *buf_share(struct buf *buf) {
+    assert(buf != NULL);
+
+    struct buf_shared *shared;
+    int inline_data = buf->data - buf->off == buf->small;
+
+    if (inline_data)
+        shared = malloc(sizeof(struct buf_shared) + buf->len);
+    else
+        shared = malloc(sizeof(struct buf_shared));
+
+    if (shared == NULL) return NULL;
+
+    shared->refs = 1;
+    shared->len = buf->len;
+    shared->alloc = buf->alloc;
+
+    if (inline_data) {
+        shared->data = (char *)(shared + 1);
+        shared->mem = NULL;
+        shared->size = 0;
+        memcpy(shared->data, buf->data, buf->len);
+    } else {
+        shared->data = buf->data;
+        shared->mem = buf->data - buf->off;
+        shared->size = buf->off + buf->cap;
+    }
+
+    buf->data = buf->small;
+    buf->off = 0;
+    buf->len = 0;
+    buf->cap = BUF_SMALL_CAP;
+    return shared;
+}
+
+/* Release a reference of a shared block, the last one frees it. Safe to
+ * release from any thread, if the allocator of the buffer is. */
+void buf_shared_free(struct buf_shared *shared) {
+    if (shared == NULL) return;
+
+    if (__atomic_sub_fetch(&shared->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    if (shared->mem != NULL)
+        alloc_free(shared->alloc, shared->mem, shared->size);
+    free(shared);
+}
+
+/* Create a view of `len` bytes at `off` of a shared block, the length is
+ * cut to the end of the block. The slice holds a reference of the block.
+ * Returns NULL on no memory. */
+struct buf_slice *buf_slice(struct buf_shared *shared, size_t off,
+                            size_t len) {
+    assert(shared != NULL);
+    assert(off <= shared->len);
+
+    struct buf_slice *slice = malloc(sizeof(struct buf_slice));
+
+    if (slice != NULL) {
+        if (len > shared->len - off) len = shared->len - off;
+
+        __atomic_add_fetch(&shared->refs, 1, __ATOMIC_RELAXED);
+        slice->shared = shared;
+        slice->data = shared->data + off;
+        slice->len = len;
+    }
+    return slice;
+}
+
+/* Free a slice and release its reference of the block. */
+void buf_slice_free(struct buf_slice *slice) {
+    if (slice != NULL) {
+        buf_shared_free(slice->shared);
+        free(slice);
+    }
+}
+
+/* Write slice data to fd once, the written bytes are consumed from the
+ * view, the block is untouched. Returns like `buf_write_fd`. */
+ssize_t buf_slice_write_fd(struct buf_slice *slice, int fd) {
+    assert(slice != NULL);
+
+    if (slice->len == 0) return 0;
+
+    ssize_t n;
+
+    do {
+        n = write(fd, slice->data, slice->len);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) {
+        slice->data += n;
+        slice->len -= n;
+    }
+    return n;
+}
@@ -1,8 +1,21 @@
 /**
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
- * Dynamic buffer implementation.
- * deps: None.
+ * Dynamic buffer implementation. Short data is stored inline in the struct,
+ * longer on the heap, growing by doubling. Consuming from the left by
+ * `buf_lrm` just moves `data` forward, the consumed bytes are reclaimed
+ * once the buffer must grow. `buf_read_fd` and `buf_write_fd` move data
+ * between a buffer and a (non-blocking) fd, e.g. in event callbacks.
+ * `buf_share` turns a buffer's data into a refcounted immutable block,
+ * without copying, its `buf_slice` views can be queued on many writers
+ * (fan-out) and the block is freed when the last reference is released:
+ *
+ *   struct buf_shared *shared = buf_share(buf);
+ *   for (i = 0; i < n; i++)
+ *       queue_push(conns[i]->out, buf_slice(shared, 0, shared->len));
+ *   buf_shared_free(shared);
+ *
+ * deps: alloc.c
  */
 
 #ifndef __BUF_H__
@@ -10,14 +23,18 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
+
+#include "alloc.h"
 
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
-#define BUF_CAP_MAX 64 * 1024 * 1024 /* max buffer capacity: 64mb */
-#define BUF_UNIT_MIN 1               /* min buffer realloc unit: 1 */
-#define BUF_UNIT_MAX 1024 * 1024     /* max buffer realloc unit: 1mb */
+#define BUF_CAP_MAX 64 * 1024 * 1024 /* default max capacity: 64mb */
+#define BUF_SMALL_CAP 32             /* inline storage size */
+#define BUF_READ_SPILL 64 * 1024     /* stack spill size of reads */
+#define BUF_DOUBLE_PREC_MAX 9        /* max precision of fast doubles */
 
 #define buf(s) buf_new(s)
 #define str(b) buf_str(b)
@@ -29,25 +46,60 @@ enum {
 };
 
 struct buf {
-    size_t len; /* buffer length */
-    size_t cap; /* buffer capacity */
-    char *data; /* real buffer pointer */
+    size_t len;                /* buffer length */
+    size_t cap;                /* buffer capacity, from data */
+    char *data;                /* real buffer pointer */
+    size_t off;                /* consumed bytes before data */
+    size_t max;                /* max capacity */
+    struct alloc *alloc;       /* allocator of data, NULL for the default */
+    char small[BUF_SMALL_CAP]; /* inline storage of short data */
+};
+
+struct buf_shared {
+    size_t refs;         /* number of references, atomic */
+    char *data;          /* immutable data */
+    size_t len;          /* data length */
+    char *mem;           /* memory taken from the buf, NULL if inline */
+    size_t size;         /* memory size */
+    struct alloc *alloc; /* allocator of memory */
+};
+
+struct buf_slice {
+    struct buf_shared *shared; /* block referenced */
+    char *data;                /* slice data, in the block */
+    size_t len;                /* slice length */
 };
 
 struct buf *buf_new(const char *s);
 struct buf *buf_empty(void);
+struct buf *buf_new_alloc(struct alloc *a);
 void buf_free(struct buf *buf);
 void buf_clear(struct buf *buf);
 int buf_grow(struct buf *buf, size_t cap);
+int buf_reserve(struct buf *buf, size_t len);
+int buf_shrink_to_fit(struct buf *buf);
+void buf_set_max(struct buf *buf, size_t max);
 int buf_put(struct buf *buf, char *data, size_t len);
 int buf_puts(struct buf *buf, const char *s);
 int buf_putc(struct buf *buf, char ch);
 char *buf_str(struct buf *buf);
 int buf_isempty(struct buf *buf);
 int buf_sprintf(struct buf *buf, const char *fmt, ...);
+int buf_put_u64(struct buf *buf, uint64_t v);
+int buf_put_i64(struct buf *buf, int64_t v);
+int buf_put_hex(struct buf *buf, uint64_t v);
+int buf_put_double(struct buf *buf, double v, int prec);
 void buf_lrm(struct buf *buf, size_t len);
 size_t buf_len(struct buf *buf);
 size_t buf_cap(struct buf *buf);
+ssize_t buf_read_fd(struct buf *buf, int fd, size_t hint);
+ssize_t buf_write_fd(struct buf *buf, int fd);
+struct buf_shared *buf_share(struct buf *buf);
+void buf_shared_free(struct buf_shared *shared);
+struct buf_slice *buf_slice(struct buf_shared *shared, size_t off,
+                            size_t len);
+void buf_slice_free(struct buf_slice *slice);
+ssize_t buf_slice_write_fd(struct buf_slice *slice, int fd);
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "bufchain.h"
+
+/* data capacity of a block */
+#define BUFCHAIN_BLOCK_CAP (BUFCHAIN_BLOCK_SIZE - sizeof(struct bufchain_block))
+
+/* Create an empty chain with an allocator for its blocks, NULL for the
+ * default. */
+struct bufchain *bufchain_new(struct alloc *a) {
+    struct bufchain *chain = malloc(sizeof(struct bufchain));
+
+    if (chain != NULL) {
+        chain->head = NULL;
+        chain->tail = NULL;
+        chain->len = 0;
+        chain->blocks = 0;
+        chain->alloc = a != NULL ? a : alloc_default();
+    }
+    return chain;
+}
+
+/* Free chain and its blocks. */
+void bufchain_free(struct bufchain *chain) {
+    if (chain != NULL) {
+        bufchain_clear(chain);
+        free(chain);
+    }
+}
+
+/* Free the head block of chain. */
+static void bufchain_shift(struct bufchain *chain) {
+    struct bufchain_block *block = chain->head;
+
+    chain->head = block->next;
+    if (chain->head == NULL) chain->tail = NULL;
+    chain->blocks--;
+    alloc_free(chain->alloc, block, BUFCHAIN_BLOCK_SIZE);
+}
+
+/* Clear chain, all blocks are freed. */
+void bufchain_clear(struct bufchain *chain) {
+    assert(chain != NULL);
+
+    while (chain->head != NULL) bufchain_shift(chain);
+    chain->len = 0;
+}
+
+/* Get chain data length. */
+size_t bufchain_len(struct bufchain *chain) {
+    assert(chain != NULL);
+    return chain->len;
+}
+
+/* Put chars on the end of a chain, into the free space of the last block
+ * and new blocks. The data in the chain is never moved. */
+int bufchain_put(struct bufchain *chain, char *data, size_t len) {
+    assert(chain != NULL);
+    assert(data != NULL || len == 0);
+
+    while (len > 0) {
+        struct bufchain_block *block = chain->tail;
+
+        if (block == NULL || block->end == BUFCHAIN_BLOCK_CAP) {
+            block = alloc_malloc(chain->alloc, BUFCHAIN_BLOCK_SIZE);
+
+            if (block == NULL) return BUFCHAIN_ENOMEM;
+
+            block->next = NULL;
+            block->start = 0;
+            block->end = 0;
+
+            if (chain->tail != NULL)
+                chain->tail->next = block;
+            else
+                chain->head = block;
+            chain->tail = block;
+            chain->blocks++;
+        }
+
+        size_t size = BUFCHAIN_BLOCK_CAP - block->end;
+
+        if (size > len) size = len;
+
+        memcpy(block->data + block->end, data, size);
+        block->end += size;
+        chain->len += size;
+        data += size;
+        len -= size;
+    }
+    return BUFCHAIN_OK;
+}
+
+/* Put null-terminated chars to the end of a chain. */
+int bufchain_puts(struct bufchain *chain, const char *s) {
+    return bufchain_put(chain, (char *)s, strlen(s));
+}
+
+/* Remove data of given length from the chain head, blocks consumed are
+ * freed. */
+void bufchain_lrm(struct bufchain *chain, size_t len) {
+    assert(chain != NULL);
+
+    if (len > chain->len) len = chain->len;
+
+    chain->len -= len;
+
+    while (len > 0) {
+        struct bufchain_block *block = chain->head;
+        size_t size = block->end - block->start;
+
+        if (size > len) {
+            block->start += len;
+            return;
+        }
+
+        len -= size;
+        bufchain_shift(chain);
+    }
+}
+
+/* Fill at most n iovecs with the data of chain from its head, without
+ * consuming it. Returns the number of iovecs filled. */
+size_t bufchain_peek(struct bufchain *chain, struct iovec *iov, size_t n) {
+    assert(chain != NULL);
+    assert(iov != NULL || n == 0);
+
+    struct bufchain_block *block = chain->head;
+    size_t i = 0;
+
+    for (; block != NULL && i < n; block = block->next) {
+        iov[i].iov_base = block->data + block->start;
+        iov[i].iov_len = block->end - block->start;
+        i++;
+    }
+    return i;
+}
+
+/* Write chain data to fd by one writev of at most BUFCHAIN_IOV_MAX blocks,
+ * the written data is consumed. Returns like write(2): the number of bytes
+ * written, -1 on error with errno set, EAGAIN if a non-blocking fd is
+ * full. */
+ssize_t bufchain_write_fd(struct bufchain *chain, int fd) {
+    assert(chain != NULL);
+
+    struct iovec iov[BUFCHAIN_IOV_MAX];
+    size_t n = bufchain_peek(chain, iov, BUFCHAIN_IOV_MAX);
+
+    if (n == 0) return 0;
+
+    ssize_t written;
+
+    do {
+        written = writev(fd, iov, n);
+    } while (written < 0 && errno == EINTR);
+
+    if (written > 0) bufchain_lrm(chain, written);
+    return written;
+}
@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ *
+ * Chained block buffer, for large payloads. Data is appended into a chain
+ * of fixed-size blocks, so it never moves once written and has no size
+ * limit, consumed blocks are freed from the head. The blocks are from an
+ * allocator, a slab of BUFCHAIN_BLOCK_SIZE shared by the chains of a
+ * thread reuses them across connections, e.g.
+ *
+ *   struct alloc_slab *blocks = alloc_slab_new(BUFCHAIN_BLOCK_SIZE);
+ *   struct bufchain *chain = bufchain_new(&blocks->alloc);
+ *
+ * `bufchain_write_fd` flushes a chain by one writev of its blocks.
+ * deps: alloc.c
+ */
+
+#ifndef __BUFCHAIN_H__
+#define __BUFCHAIN_H__
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "alloc.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define BUFCHAIN_BLOCK_SIZE (16 * 1024) /* block size, header included */
+#define BUFCHAIN_IOV_MAX 1024           /* max blocks written at once, as
+                                         * IOV_MAX on linux */
+
+enum {
+    BUFCHAIN_OK = 0,     /* operation is ok */
+    BUFCHAIN_ENOMEM = 1, /* no memory error */
+};
+
+struct bufchain_block {
+    struct bufchain_block *next; /* next block */
+    size_t start;                /* data start in block */
+    size_t end;                  /* data end in block */
+    char data[];                 /* block data */
+};
+
+struct bufchain {
+    struct bufchain_block *head; /* first block, consumed from */
+    struct bufchain_block *tail; /* last block, appended to */
+    size_t len;                  /* data length */
+    size_t blocks;               /* number of blocks */
+    struct alloc *alloc;         /* allocator of blocks */
+};
+
+struct bufchain *bufchain_new(struct alloc *a);
+void bufchain_free(struct bufchain *chain);
+void bufchain_clear(struct bufchain *chain);
+size_t bufchain_len(struct bufchain *chain); /* O(1) */
+int bufchain_put(struct bufchain *chain, char *data, size_t len);
+int bufchain_puts(struct bufchain *chain, const char *s);
+void bufchain_lrm(struct bufchain *chain, size_t len); /* O(blocks) */
+size_t bufchain_peek(struct bufchain *chain, struct iovec *iov, size_t n);
+ssize_t bufchain_write_fd(struct bufchain *chain, int fd);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
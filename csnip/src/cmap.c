@@ -0,0 +1,467 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmap.h"
+#include "map.h"
+
+/* popped slots keep this node, probes go on over it */
+static struct cmap_node cmap_tomb;
+#define CMAP_TOMB (&cmap_tomb)
+
+/* reader slot of a thread, the epoch it's reading in, 0 when not reading */
+struct cmap_reader {
+    uint64_t epoch; /* epoch announced, 0 for none */
+    int used;       /* if taken by a thread */
+} __attribute__((aligned(CMAP_CACHELINE)));
+
+/* the epochs are shared by all cmaps, a thread gets one reader slot */
+static uint64_t cmap_epoch = 1;
+static struct cmap_reader cmap_readers[CMAP_READERS_MAX];
+static size_t cmap_readers_top = 0; /* slots ever taken, scanned up to */
+static __thread struct cmap_reader *cmap_self = NULL;
+static pthread_key_t cmap_reader_key;
+static pthread_once_t cmap_reader_once = PTHREAD_ONCE_INIT;
+
+/* Release the reader slot of an exiting thread. */
+static void cmap_reader_exit(void *arg) {
+    struct cmap_reader *r = arg;
+    __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+}
+
+static void cmap_reader_init(void) {
+    pthread_key_create(&cmap_reader_key, &cmap_reader_exit);
+}
+
+/* Get the reader slot of this thread, taken on its first read and released
+ * when it exits, NULL if all are taken. */
+static struct cmap_reader *cmap_reader(void) {
+    if (cmap_self != NULL) return cmap_self;
+
+    pthread_once(&cmap_reader_once, &cmap_reader_init);
+
+    size_t i;
+
+    for (i = 0; i < CMAP_READERS_MAX; i++) {
+        struct cmap_reader *r = &cmap_readers[i];
+        int unused = 0;
+
+        if (!__atomic_compare_exchange_n(&r->used, &unused, 1, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            continue;
+
+        size_t top = __atomic_load_n(&cmap_readers_top, __ATOMIC_RELAXED);
+
+        while (top < i + 1 &&
+               !__atomic_compare_exchange_n(&cmap_readers_top, &top, i + 1, 0,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            ;
+
+        pthread_setspecific(cmap_reader_key, r);
+        return cmap_self = r;
+    }
+    return NULL;
+}
+
+/* Start reading a shard: announce the global epoch, nothing retired from
+ * now on is freed before the announcement is cleared. Without a reader
+ * slot, the shard is locked instead. */
+static struct cmap_reader *cmap_read_begin(struct cmap_shard *shard) {
+    struct cmap_reader *r = cmap_reader();
+
+    if (r == NULL) {
+        pthread_mutex_lock(&shard->lock);
+        return NULL;
+    }
+
+    /* the fence orders the announcement before the reads of the shard */
+    uint64_t epoch = __atomic_load_n(&cmap_epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&r->epoch, epoch, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return r;
+}
+
+/* End reading a shard, started by `cmap_read_begin`. */
+static void cmap_read_end(struct cmap_shard *shard, struct cmap_reader *r) {
+    if (r == NULL)
+        pthread_mutex_unlock(&shard->lock);
+    else
+        __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* Get the epoch to stamp a retired object with, after it's unlinked. */
+static uint64_t cmap_retire_epoch(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&cmap_epoch, __ATOMIC_SEQ_CST);
+}
+
+/* Free the retired nodes and tables of a shard that no reader can be on:
+ * the global epoch is advanced, then the ones retired before the oldest
+ * epoch announced are freed, all if no thread is reading. Must be called
+ * with the shard lock. */
+static void cmap_shard_collect(struct cmap_shard *shard) {
+    uint64_t min = __atomic_add_fetch(&cmap_epoch, 1, __ATOMIC_SEQ_CST);
+    size_t i, top = __atomic_load_n(&cmap_readers_top, __ATOMIC_SEQ_CST);
+
+    for (i = 0; i < top; i++) {
+        uint64_t e = __atomic_load_n(&cmap_readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (e != 0 && e < min) min = e;
+    }
+
+    /* the lists are the latest first, epochs never go back */
+    struct cmap_node **node = &shard->nodes;
+
+    while (*node != NULL && (*node)->epoch >= min) node = &(*node)->retired;
+
+    while (*node != NULL) {
+        struct cmap_node *next = (*node)->retired;
+        free(*node);
+        *node = next;
+        shard->retired--;
+    }
+
+    struct cmap_table **t = &shard->tables;
+
+    while (*t != NULL && (*t)->epoch >= min) t = &(*t)->retired;
+
+    while (*t != NULL) {
+        struct cmap_table *next = (*t)->retired;
+        free(*t);
+        *t = next;
+        shard->retired--;
+    }
+
+    shard->reclaim_at = shard->retired + CMAP_RECLAIM_BATCH;
+}
+
+/* Count a retired object of a shard, reclaims once a batch is retired since
+ * the last time. Must be called with the shard lock. */
+static void cmap_shard_retired(struct cmap_shard *shard) {
+    if (++shard->retired >= shard->reclaim_at) cmap_shard_collect(shard);
+}
+
+/* Get the shard of a key hash, by the high bits, the low bits are taken
+ * by the slot index. */
+static inline struct cmap_shard *cmap_shard(struct cmap *m, uint64_t hash) {
+    return &m->shards[(hash >> 40) & m->mask];
+}
+
+/* Find the slot of a key in table, NULL on not found. Safe to call without
+ * the shard lock: the node is loaded before the slot hash, which is set
+ * before the node is published. */
+static struct cmap_slot *cmap_find(struct cmap_table *t, char *key,
+                                   size_t len, uint64_t hash) {
+    if (t == NULL) return NULL;
+
+    size_t mask = t->cap - 1;
+    size_t i = hash & mask;
+
+    /* the load limit keeps empty slots in every table, probes end */
+    for (;; i = (i + 1) & mask) {
+        struct cmap_slot *slot = &t->slots[i];
+        struct cmap_node *node =
+            __atomic_load_n(&slot->node, __ATOMIC_ACQUIRE);
+
+        if (node == NULL) return NULL;
+
+        if (node != CMAP_TOMB && slot->hash == hash && node->len == len &&
+            memcmp(node->key, key, len) == 0)
+            return slot;
+    }
+}
+
+/* Put a node into a table which doesn't have the key, returns the slot. */
+static struct cmap_slot *cmap_table_put(struct cmap_table *t,
+                                        struct cmap_node *node,
+                                        uint64_t hash) {
+    size_t mask = t->cap - 1;
+    size_t i = hash & mask;
+
+    while (t->slots[i].node != NULL) i = (i + 1) & mask;
+
+    struct cmap_slot *slot = &t->slots[i];
+    slot->hash = hash;
+    __atomic_store_n(&slot->node, node, __ATOMIC_RELEASE);
+    t->used++;
+    return slot;
+}
+
+/* Resize shard to hold one more node, by a new table with the live nodes
+ * of the current one. The current table is left as is for the readers on
+ * it, and retired. Must be called with the shard lock. */
+static int cmap_resize(struct cmap_shard *shard) {
+    size_t cap = CMAP_CAP_INIT;
+
+    while (cap * CMAP_LOAD_LIMIT < 2 * (shard->len + 1)) cap *= 2;
+
+    struct cmap_table *t =
+        malloc(sizeof(struct cmap_table) + cap * sizeof(struct cmap_slot));
+
+    if (t == NULL) return CMAP_ENOMEM;
+
+    t->cap = cap;
+    t->used = 0;
+    t->retired = NULL;
+    memset(t->slots, 0, cap * sizeof(struct cmap_slot));
+
+    struct cmap_table *old = shard->table;
+
+    if (old != NULL) {
+        size_t i;
+
+        for (i = 0; i < old->cap; i++) {
+            struct cmap_node *node = old->slots[i].node;
+            if (node != NULL && node != CMAP_TOMB)
+                cmap_table_put(t, node, old->slots[i].hash);
+        }
+    }
+
+    __atomic_store_n(&shard->table, t, __ATOMIC_RELEASE);
+
+    if (old != NULL) {
+        old->epoch = cmap_retire_epoch();
+        old->retired = shard->tables;
+        shard->tables = old;
+        cmap_shard_retired(shard);
+    }
+    return CMAP_OK;
+}
+
+/* Create new cmap with given number of shards, rounded up to 2**. */
+struct cmap *cmap_new(size_t shards) {
+    struct cmap *m = malloc(sizeof(struct cmap));
+
+    if (m == NULL) return NULL;
+
+    size_t n = 1;
+
+    while (n < shards) n *= 2;
+
+    if (posix_memalign((void **)&m->shards, CMAP_CACHELINE,
+                       n * sizeof(struct cmap_shard)) != 0) {
+        free(m);
+        return NULL;
+    }
+
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        struct cmap_shard *shard = &m->shards[i];
+        shard->table = NULL;
+        shard->len = 0;
+        shard->nodes = NULL;
+        shard->tables = NULL;
+        shard->retired = 0;
+        shard->reclaim_at = CMAP_RECLAIM_BATCH;
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+
+    m->mask = n - 1;
+    m->seed = map_seed();
+    return m;
+}
+
+/* Free all the retired nodes and tables of a shard. */
+static void cmap_shard_reclaim(struct cmap_shard *shard) {
+    while (shard->nodes != NULL) {
+        struct cmap_node *node = shard->nodes;
+        shard->nodes = node->retired;
+        free(node);
+    }
+
+    while (shard->tables != NULL) {
+        struct cmap_table *t = shard->tables;
+        shard->tables = t->retired;
+        free(t);
+    }
+    shard->retired = 0;
+}
+
+/* Free cmap, no other thread may be using it. */
+void cmap_free(struct cmap *m) {
+    if (m == NULL) return;
+
+    size_t i, j;
+
+    for (i = 0; i <= m->mask; i++) {
+        struct cmap_shard *shard = &m->shards[i];
+        struct cmap_table *t = shard->table;
+
+        if (t != NULL) {
+            for (j = 0; j < t->cap; j++)
+                if (t->slots[j].node != CMAP_TOMB) free(t->slots[j].node);
+            free(t);
+        }
+
+        cmap_shard_reclaim(shard);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    free(m->shards);
+    free(m);
+}
+
+/* Free the popped nodes and the tables replaced by resizes that no reader
+ * can be on, without waiting for a batch of retires. Safe to call while
+ * other threads read and write. */
+void cmap_reclaim(struct cmap *m) {
+    assert(m != NULL);
+
+    size_t i;
+
+    for (i = 0; i <= m->mask; i++) {
+        struct cmap_shard *shard = &m->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        cmap_shard_collect(shard);
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/* Get cmap length, may be outdated while writers run. */
+size_t cmap_len(struct cmap *m) {
+    assert(m != NULL);
+
+    size_t i, len = 0;
+
+    for (i = 0; i <= m->mask; i++)
+        len += __atomic_load_n(&m->shards[i].len, __ATOMIC_RELAXED);
+    return len;
+}
+
+/* Set a key into cmap, the key is copied. */
+int cmap_iset(struct cmap *m, char *key, size_t len, void *val) {
+    assert(m != NULL);
+    assert(key != NULL);
+
+    uint64_t hash = map_hash(key, len, m->seed);
+    struct cmap_shard *shard = cmap_shard(m, hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    struct cmap_slot *slot = cmap_find(shard->table, key, len, hash);
+
+    if (slot != NULL) {
+        __atomic_store_n(&slot->node->val, val, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&shard->lock);
+        return CMAP_OK;
+    }
+
+    struct cmap_table *t = shard->table;
+    struct cmap_node *node = malloc(sizeof(struct cmap_node) + len);
+
+    if (node == NULL ||
+        ((t == NULL || t->cap * CMAP_LOAD_LIMIT < t->used + 1) &&
+         cmap_resize(shard) != CMAP_OK)) {
+        pthread_mutex_unlock(&shard->lock);
+        free(node);
+        return CMAP_ENOMEM;
+    }
+
+    node->retired = NULL;
+    node->epoch = 0;
+    node->val = val;
+    node->len = len;
+    memcpy(node->key, key, len);
+    cmap_table_put(shard->table, node, hash);
+    __atomic_store_n(&shard->len, shard->len + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&shard->lock);
+    return CMAP_OK;
+}
+
+/* Set a NULL-terminated key into cmap. */
+int cmap_set(struct cmap *m, char *key, void *val) {
+    return cmap_iset(m, key, strlen(key), val);
+}
+
+/* Get val by key from cmap, NULL on not found. Never blocks, unless the
+ * thread has no reader slot. */
+void *cmap_iget(struct cmap *m, char *key, size_t len) {
+    assert(m != NULL);
+    assert(key != NULL);
+
+    uint64_t hash = map_hash(key, len, m->seed);
+    struct cmap_shard *shard = cmap_shard(m, hash);
+    struct cmap_reader *r = cmap_read_begin(shard);
+    struct cmap_table *t = __atomic_load_n(&shard->table, __ATOMIC_ACQUIRE);
+    struct cmap_slot *slot = cmap_find(t, key, len, hash);
+    void *val = NULL;
+
+    if (slot != NULL) {
+        /* the node may be popped meanwhile, but it's not freed before the
+         * read ends */
+        struct cmap_node *node =
+            __atomic_load_n(&slot->node, __ATOMIC_ACQUIRE);
+
+        if (node != CMAP_TOMB)
+            val = __atomic_load_n(&node->val, __ATOMIC_ACQUIRE);
+    }
+
+    cmap_read_end(shard, r);
+    return val;
+}
+
+/* Get val by NULL-terminated key from cmap, NULL on not found. */
+void *cmap_get(struct cmap *m, char *key) {
+    return cmap_iget(m, key, strlen(key));
+}
+
+/* Test if a key is in cmap. Never blocks, unless the thread has no reader
+ * slot. */
+int cmap_ihas(struct cmap *m, char *key, size_t len) {
+    assert(m != NULL);
+    assert(key != NULL);
+
+    uint64_t hash = map_hash(key, len, m->seed);
+    struct cmap_shard *shard = cmap_shard(m, hash);
+    struct cmap_reader *r = cmap_read_begin(shard);
+    struct cmap_table *t = __atomic_load_n(&shard->table, __ATOMIC_ACQUIRE);
+    int has = cmap_find(t, key, len, hash) != NULL;
+
+    cmap_read_end(shard, r);
+    return has;
+}
+
+/* Test if a NULL-terminated key is in cmap. */
+int cmap_has(struct cmap *m, char *key) {
+    return cmap_ihas(m, key, strlen(key));
+}
+
+/* Pop a key from cmap, NULL on not found. The node is retired. */
+void *cmap_ipop(struct cmap *m, char *key, size_t len) {
+    assert(m != NULL);
+    assert(key != NULL);
+
+    uint64_t hash = map_hash(key, len, m->seed);
+    struct cmap_shard *shard = cmap_shard(m, hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    struct cmap_slot *slot = cmap_find(shard->table, key, len, hash);
+
+    if (slot == NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+
+    struct cmap_node *node = slot->node;
+    void *val = node->val;
+    __atomic_store_n(&slot->node, CMAP_TOMB, __ATOMIC_RELEASE);
+    node->epoch = cmap_retire_epoch();
+    node->retired = shard->nodes;
+    shard->nodes = node;
+    __atomic_store_n(&shard->len, shard->len - 1, __ATOMIC_RELAXED);
+    cmap_shard_retired(shard);
+    pthread_mutex_unlock(&shard->lock);
+    return val;
+}
+
+/* Pop a NULL-terminated key from cmap, NULL on not found. */
+void *cmap_pop(struct cmap *m, char *key) {
+    return cmap_ipop(m, key, strlen(key));
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ *
+ * Concurrent hashtable implementation, keys are sharded across power of 2
+ * segments. Writers lock the shard, readers never lock nor retry: they
+ * probe the shard table published by an atomic pointer, and a resize
+ * publishes a new table without touching the old one. Popped nodes and old
+ * tables are retired, and freed by epochs: a reading thread announces the
+ * global epoch in a slot of its own while it reads, and writers free what
+ * was retired before the oldest epoch announced, every CMAP_RECLAIM_BATCH
+ * retires of a shard. Threads over CMAP_READERS_MAX read under the shard
+ * lock.
+ * deps: map.c alloc.c
+ */
+
+#ifndef __CMAP_H__
+#define __CMAP_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define CMAP_LOAD_LIMIT 0.72  /* load factor, tombstones included */
+#define CMAP_CAP_INIT 16      /* init shard table size: must be 2** */
+#define CMAP_SHARDS 16        /* default number of shards: must be 2** */
+#define CMAP_CACHELINE 64     /* shards are aligned to cache lines */
+#define CMAP_READERS_MAX 256  /* max threads reading without lock */
+#define CMAP_RECLAIM_BATCH 64 /* retires of a shard between reclaims */
+
+#define cmap() cmap_new(CMAP_SHARDS)
+
+enum {
+    CMAP_OK = 0,     /* operation is ok */
+    CMAP_ENOMEM = 1, /* no memory error */
+};
+
+struct cmap_node {
+    struct cmap_node *retired; /* next retired node */
+    uint64_t epoch;            /* global epoch when retired */
+    void *val;                 /* value data */
+    size_t len;                /* key length */
+    char key[];                /* key string, copied */
+};
+
+struct cmap_slot {
+    uint64_t hash;          /* key hash, set once before node */
+    struct cmap_node *node; /* node, NULL for empty, or tombstone */
+};
+
+struct cmap_table {
+    size_t cap;                 /* table capacity */
+    size_t used;                /* used slots, tombstones included */
+    struct cmap_table *retired; /* next retired table */
+    uint64_t epoch;             /* global epoch when retired */
+    struct cmap_slot slots[];   /* table slots */
+};
+
+struct cmap_shard {
+    /* read by readers, on a cache line of its own */
+    struct cmap_table *table; /* current table, replaced on resize */
+    /* written by writers */
+    pthread_mutex_t lock __attribute__((aligned(CMAP_CACHELINE)));
+    size_t len;                /* shard length */
+    struct cmap_node *nodes;   /* retired nodes, the latest first */
+    struct cmap_table *tables; /* retired tables, the latest first */
+    size_t retired;            /* number of retired nodes and tables */
+    size_t reclaim_at;         /* reclaim once this many are retired */
+} __attribute__((aligned(CMAP_CACHELINE)));
+
+struct cmap {
+    size_t mask;               /* number of shards - 1 */
+    uint64_t seed;             /* key hash seed */
+    struct cmap_shard *shards; /* shards */
+};
+
+struct cmap *cmap_new(size_t shards);
+void cmap_free(struct cmap *m);
+void cmap_reclaim(struct cmap *m);
+size_t cmap_len(struct cmap *m);                                 /* O(S) */
+int cmap_set(struct cmap *m, char *key, void *val);              /* O(1) */
+void *cmap_get(struct cmap *m, char *key);                       /* O(1) */
+int cmap_has(struct cmap *m, char *key);                         /* O(1) */
+void *cmap_pop(struct cmap *m, char *key);                       /* O(1) */
+int cmap_iset(struct cmap *m, char *key, size_t len, void *val); /* O(1) */
+void *cmap_iget(struct cmap *m, char *key, size_t len);          /* O(1) */
+int cmap_ihas(struct cmap *m, char *key, size_t len);            /* O(1) */
+void *cmap_ipop(struct cmap *m, char *key, size_t len);          /* O(1) */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -3,60 +3,35 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include "dict.h"
+#include "map.h"
 
 static size_t dict_table_sizes[] = {
     7,        17,       37,        79,        163,       331,        673,
     1361,     2729,     5471,      10949,     21911,     43853,      87719,
     175447,   350899,   701819,    1403641,   2807303,   5614657,    11229331,
-    44917381, 89834777, 179669557, 359339171, 718678369, 1437356741, 2147483647,
+    22458671, 44917381, 89834777,  179669557, 359339171, 718678369, 1437356741,
+    2147483647,
 };
 
 static size_t dict_idx_max =
-    sizeof(dict_table_sizes) / sizeof(dict_table_sizes[0]) - 1; /* 28 */
-
-static uint32_t dict_hash(char *key, size_t len) {
-    /* DJBX33A hash function from PHP */
-    register int hash = 5381;
-    for (; len >= 8; len -= 8) {
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-    }
-    switch (len) {
-        case 7:
-            hash = ((hash << 5) + hash) + *key++;
-        case 6:
-            hash = ((hash << 5) + hash) + *key++;
-        case 5:
-            hash = ((hash << 5) + hash) + *key++;
-        case 4:
-            hash = ((hash << 5) + hash) + *key++;
-        case 3:
-            hash = ((hash << 5) + hash) + *key++;
-        case 2:
-            hash = ((hash << 5) + hash) + *key++;
-        case 1:
-            hash = ((hash << 5) + hash) + *key++;
-            break;
-        case 0:
-            break;
-    }
-    return hash;
+    sizeof(dict_table_sizes) / sizeof(dict_table_sizes[0]) - 1; /* 29 */
+
+/* Default hash function, the same as `map_hash` (wyhash). */
+uint64_t dict_hash(char *key, size_t len, uint64_t seed) {
+    return map_hash(key, len, seed);
 }
 
-/* Get table size idx. */
-size_t dict_table_idx(size_t idx, char *key, size_t len) {
+/* Get table index by key hash, maps the 32 bits hash onto the table size by
+ * a multiplication and a shift instead of a division. */
+size_t dict_table_idx(size_t idx, uint32_t hash) {
     assert(idx <= dict_idx_max);
-    return dict_hash(key, len) % dict_table_sizes[idx];
+    return ((uint64_t)hash * dict_table_sizes[idx]) >> 32;
 }
 
 /* If two key equals. */
@@ -65,116 +40,270 @@ int dict_key_equals(char *key1, size_t len1, char *key2, size_t len2) {
     return 0;
 }
 
-/* Create dict node. */
-struct dict_node *dict_node_new(char *key, size_t len, void *val) {
-    struct dict_node *node = malloc(sizeof(struct dict_node));
+/* Create dict node, taken from the free list of the dict. The free list is
+ * refilled by a new slab, sized twice the last one up to DICT_SLAB_MAX. */
+struct dict_node *dict_node_new(struct dict *dict, char *key, size_t len,
+                                uint32_t hash, void *val) {
+    if (dict->free_nodes == NULL) {
+        size_t size = DICT_SLAB_MIN;
 
-    if (node != NULL) {
-        node->key = key;
-        node->len = len;
-        node->val = val;
-        node->next = NULL;
+        if (dict->slabs != NULL) size = dict->slabs->size * 2;
+
+        if (size > DICT_SLAB_MAX) size = DICT_SLAB_MAX;
+
+        struct dict_slab *slab = alloc_malloc(
+            dict->alloc,
+            sizeof(struct dict_slab) + size * sizeof(struct dict_node));
+
+        if (slab == NULL) return NULL;
+
+        slab->size = size;
+        slab->next = dict->slabs;
+        dict->slabs = slab;
+
+        /* link in reverse, so nodes are taken in address order */
+        while (size > 0) {
+            struct dict_node *node = &slab->nodes[--size];
+            node->next = dict->free_nodes;
+            dict->free_nodes = node;
+        }
     }
+
+    struct dict_node *node = dict->free_nodes;
+    dict->free_nodes = node->next;
+    node->key = key;
+    node->len = len;
+    node->val = val;
+    node->hash = hash;
+    node->next = NULL;
     return node;
 }
 
-/* Free dict node. */
-void dict_node_free(struct dict_node *node) {
-    if (node != NULL) free(node);
+/* Free dict node, back to the free list of the dict. */
+void dict_node_free(struct dict *dict, struct dict_node *node) {
+    if (node != NULL) {
+        node->next = dict->free_nodes;
+        dict->free_nodes = node;
+    }
 }
 
-/* Resize and rehash dict. */
-int dict_resize(struct dict *dict) {
-    assert(dict != NULL && dict->idx <= dict_idx_max);
+/* Get timestamp (in microseconds) for now. */
+static long dict_now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return 1000000 * tv.tv_sec + tv.tv_usec;
+}
 
-    size_t new_idx = dict->idx + 1;
+/* Create a zeroed table of the size at given index. */
+static struct dict_node **dict_table_new(struct dict *dict, size_t idx) {
+    size_t size = dict_table_sizes[idx] * sizeof(struct dict_node *);
 
-    if (new_idx > dict_idx_max) return DICT_ENOMEM;
+    /* pages are faulted in as rehashing and sets reach them, pre-faulting
+     * the whole table here would stall the set resizing it */
+    if (dict->huge) return alloc_huge_lazy(size);
+    /* calloc maps zeroed pages for large tables, no O(N) init here */
+    return calloc(1, size);
+}
 
-    size_t new_table_size = dict_table_sizes[new_idx];
-    struct dict_node **new_table =
-        malloc(new_table_size * sizeof(struct dict_node *));
+/* Free a table of the size at given index. */
+static void dict_table_free(struct dict *dict, struct dict_node **table,
+                            size_t idx) {
+    if (dict->huge)
+        alloc_huge_free(table, dict_table_sizes[idx] * sizeof(*table));
+    else
+        free(table);
+}
 
-    /* init table to all NULL */
-    size_t index;
-    for (index = 0; index < new_table_size; index++) new_table[index] = NULL;
+/* Migrate at most n non-empty buckets of the old table into the new table,
+ * visiting at most n * 10 empty ones. The old table is freed once all of
+ * its buckets are migrated. Returns 1 if there are still buckets to
+ * migrate, else 0. */
+static int dict_rehash(struct dict *dict, size_t n) {
+    if (dict->old_table == NULL) return 0;
 
-    size_t table_size = dict_table_sizes[dict->idx];
+    size_t old_table_size = dict_table_sizes[dict->old_idx];
+    size_t empty_visits = n * 10;
 
-    for (index = 0; index < table_size; index++) {
-        struct dict_node *node = (dict->table)[index];
+    while (n > 0 && dict->rehash_pos < old_table_size) {
+        struct dict_node *node = (dict->old_table)[dict->rehash_pos];
+
+        if (node == NULL) {
+            dict->rehash_pos++;
+            if (--empty_visits == 0) break;
+            continue;
+        }
 
+        /* relink nodes to the new table */
         while (node != NULL) {
-            struct dict_node *new_node =
-                dict_node_new(node->key, node->len, node->val);
-
-            if (new_node == NULL) return DICT_ENOMEM;
-
-            size_t new_index =
-                dict_table_idx(new_idx, new_node->key, new_node->len);
-            struct dict_node *cursor = new_table[new_index];
-
-            if (cursor == NULL) {
-                /* set as head node */
-                new_table[new_index] = new_node;
-            } else {
-                while (cursor->next != NULL) cursor = cursor->next;
-                /* set as last node */
-                cursor->next = new_node;
-            }
-            /* shift next */
             struct dict_node *next = node->next;
-            dict_node_free(node);
+            size_t index = dict_table_idx(dict->idx, node->hash);
+            node->next = (dict->table)[index];
+            (dict->table)[index] = node;
             node = next;
         }
+
+        (dict->old_table)[dict->rehash_pos++] = NULL;
+        n--;
     }
 
-    free(dict->table);
+    if (dict->rehash_pos < old_table_size) return 1;
+
+    dict_table_free(dict, dict->old_table, dict->old_idx);
+    dict->old_table = NULL;
+    return 0;
+}
+
+/* Resize dict to the table size at given index. The current table becomes
+ * the old table, of which the nodes are migrated into the new table bucket
+ * by bucket on following sets and pops or by `dict_rehash_step`. A
+ * rehashing in progress is finished at once first, sets and pops never
+ * resize while rehashing. */
+int dict_resize(struct dict *dict, size_t new_idx) {
+    assert(dict != NULL && dict->idx <= dict_idx_max);
+
+    if (new_idx > dict_idx_max) return DICT_ENOMEM;
+
+    struct dict_node **new_table = dict_table_new(dict, new_idx);
+
+    if (new_table == NULL) return DICT_ENOMEM;
+
+    /* finish the rehashing in progress, if any */
+    while (dict_rehash(dict, 1024))
+        ;
+
+    dict->old_table = dict->table;
+    dict->old_idx = dict->idx;
+    dict->rehash_pos = 0;
     dict->table = new_table;
     dict->idx = new_idx;
     return DICT_OK;
 }
 
+/* Migrate buckets of the old table until done or the time budget (in
+ * microseconds) runs out, e.g. to be called from an event loop timer.
+ * Returns 1 if there are still buckets to migrate, else 0. */
+int dict_rehash_step(struct dict *dict, long budget_us) {
+    assert(dict != NULL);
+
+    long start_at = dict_now_us();
+
+    while (dict_rehash(dict, 100))
+        if (dict_now_us() - start_at >= budget_us) return 1;
+    return 0;
+}
+
+/* Find the link to the node of key, in the new table and then in the old
+ * table if rehashing, NULL on not found. */
+static struct dict_node **dict_find(struct dict *dict, char *key, size_t len,
+                                    uint32_t hash) {
+    struct dict_node **link = &(dict->table)[dict_table_idx(dict->idx, hash)];
+    uint64_t probes = 0;
+
+    for (; *link != NULL; link = &(*link)->next, probes++)
+        if ((*link)->hash == hash &&
+            dict_key_equals((*link)->key, (*link)->len, key, len))
+            goto end;
+
+    if (dict->old_table == NULL) goto end;
+
+    link = &(dict->old_table)[dict_table_idx(dict->old_idx, hash)];
+
+    for (; *link != NULL; link = &(*link)->next, probes++)
+        if ((*link)->hash == hash &&
+            dict_key_equals((*link)->key, (*link)->len, key, len))
+            goto end;
+end:
+    if (dict->counting) {
+        dict->lookups++;
+        dict->probes += probes + (*link != NULL);
+    }
+    return *link != NULL ? link : NULL;
+}
+
 /* Create new empty dict. */
-struct dict *dict_new(void) {
+struct dict *dict_new(void) { return dict_new_hash(NULL); }
+
+/* Create new empty dict with a hash function, NULL for the default
+ * `dict_hash`. Each dict hashes with its own random seed. */
+struct dict *dict_new_hash(dict_hash_t hash) {
     struct dict *dict = malloc(sizeof(struct dict));
 
     if (dict != NULL) {
         dict->idx = 0;
         dict->len = 0;
-
-        size_t table_size = dict_table_sizes[dict->idx];
-        dict->table = malloc(table_size * sizeof(struct node *));
+        dict->hash = hash != NULL ? hash : &dict_hash;
+        dict->seed = map_seed();
+        dict->old_idx = 0;
+        dict->old_table = NULL;
+        dict->rehash_pos = 0;
+        dict->slabs = NULL;
+        dict->free_nodes = NULL;
+        dict->alloc = alloc_default();
+        dict->own = 0;
+        memset(&dict->keys, 0, sizeof(dict->keys));
+        dict->counting = 0;
+        dict->lookups = 0;
+        dict->probes = 0;
+        dict->huge = 0;
+        dict->shrink = DICT_SHRINK_LIMIT;
+        dict->table = dict_table_new(dict, dict->idx);
 
         if (dict->table == NULL) return NULL;
+    }
+    return dict;
+}
 
-        size_t index;
+/* Create a dict owning its keys: keys are copied into an arena of the
+ * dict on set, and freed on pop or along with the dict. */
+struct dict *dict_new_owned(void) {
+    struct dict *dict = dict_new_hash(NULL);
 
-        for (index = 0; index < table_size; index++)
-            (dict->table)[index] = NULL;
-    }
+    if (dict != NULL) dict->own = 1;
+    return dict;
+}
+
+/* Create a dict with an allocator for its node slabs, NULL for the
+ * default. The tables and the owned keys are from libc. */
+struct dict *dict_new_alloc(struct alloc *a) {
+    struct dict *dict = dict_new_hash(NULL);
+
+    if (dict != NULL && a != NULL) dict->alloc = a;
     return dict;
 }
 
-/* Clear dict. */
+/* Create a dict with its tables backed by huge pages if possible, see
+ * `alloc_huge_lazy`. The tables are faulted in lazily, not on resize. */
+struct dict *dict_new_huge(void) {
+    struct dict *dict = dict_new_hash(NULL);
+
+    if (dict != NULL) dict->huge = 1;
+    return dict;
+}
+
+/* Clear dict. All nodes are released at once by freeing the slabs. */
 void dict_clear(struct dict *dict) {
     assert(dict != NULL && dict->idx <= dict_idx_max);
 
-    size_t index;
-    size_t table_size = dict_table_sizes[dict->idx];
-
-    for (index = 0; index < table_size; index++) {
-        struct dict_node *node = (dict->table)[index];
+    memset(dict->table, 0,
+           dict_table_sizes[dict->idx] * sizeof(struct dict_node *));
 
-        while (node != NULL) {
-            struct dict_node *next = node->next;
-            dict_node_free(node);
-            dict->len -= 1;
-            node = next;
-        }
+    if (dict->old_table != NULL) {
+        dict_table_free(dict, dict->old_table, dict->old_idx);
+        dict->old_table = NULL;
+    }
 
-        (dict->table)[index] = NULL;
+    while (dict->slabs != NULL) {
+        struct dict_slab *next = dict->slabs->next;
+        alloc_free(dict->alloc, dict->slabs,
+                   sizeof(struct dict_slab) +
+                       dict->slabs->size * sizeof(struct dict_node));
+        dict->slabs = next;
     }
+
+    map_keys_clear(&dict->keys);
+
+    dict->free_nodes = NULL;
+    dict->len = 0;
 }
 
 /* Free dict. */
@@ -182,7 +311,7 @@ void dict_free(struct dict *dict) {
     if (dict != NULL) {
         dict_clear(dict);
 
-        if (dict->table != NULL) free(dict->table);
+        dict_table_free(dict, dict->table, dict->idx);
 
         free(dict);
     }
@@ -200,46 +329,65 @@ size_t dict_cap(struct dict *dict) {
     return dict_table_sizes[dict->idx];
 }
 
-/* Set a key into dict. */
-int dict_iset(struct dict *dict, char *key, size_t len, void *val) {
+/* Get the node of a key in dict, created with NULL val if not found,
+ * NULL on no memory. */
+static struct dict_node *dict_entry_node(struct dict *dict, char *key,
+                                         size_t len, int *inserted) {
     assert(dict != NULL);
 
-    if ((dict_table_sizes[dict->idx] * DICT_LOAD_LIMIT < dict->len + 1) &&
-        dict_resize(dict) != DICT_OK)
-        return DICT_ENOMEM;
+    if (inserted != NULL) *inserted = 0;
 
-    size_t index = dict_table_idx(dict->idx, key, len);
-    struct dict_node *node = (dict->table)[index];
+    dict_rehash(dict, DICT_REHASH_UNIT);
 
-    /* try to find this key. */
-    while (node != NULL) {
-        if (dict_key_equals(node->key, node->len, key, len)) {
-            node->key = key;
-            node->len = len;
-            node->val = val;
-            return DICT_OK;
-        }
-        node = node->next;
+    /* grow once over the load limit; while rehashing the grow waits and
+     * the migration is sped up instead, so that no set migrates the whole
+     * old table and the load does not go far over the limit */
+    if (dict_table_sizes[dict->idx] * DICT_LOAD_LIMIT < dict->len + 1) {
+        dict_rehash(dict, DICT_REHASH_UNIT * DICT_REHASH_BOOST);
+
+        if (dict->old_table == NULL &&
+            dict_resize(dict, dict->idx + 1) != DICT_OK)
+            return NULL;
     }
 
-    /* create node if not found */
-    struct dict_node *new_node = dict_node_new(key, len, val);
+    uint32_t hash = (dict->hash)(key, len, dict->seed);
+    struct dict_node **link = dict_find(dict, key, len, hash);
 
-    if (new_node == NULL) return DICT_ENOMEM;
+    if (link != NULL) return *link;
 
-    /* rewind to list head */
-    node = (dict->table)[index];
+    /* create node if not found */
+    if (dict->own && (key = map_keys_put(&dict->keys, key, len)) == NULL)
+        return NULL;
+
+    struct dict_node *node = dict_node_new(dict, key, len, hash, NULL);
 
     if (node == NULL) {
-        /* if list is empty, set as head node */
-        (dict->table)[index] = new_node;
-    } else {
-        /* else append as tail node */
-        while (node->next != NULL) node = node->next;
-        node->next = new_node;
+        if (dict->own) map_keys_drop(&dict->keys, key, len);
+        return NULL;
     }
 
+    /* new nodes always go to the head of the list in new table */
+    size_t index = dict_table_idx(dict->idx, hash);
+    node->next = (dict->table)[index];
+    (dict->table)[index] = node;
     dict->len += 1;
+
+    if (inserted != NULL) *inserted = 1;
+    return node;
+}
+
+/* Set a key into dict. */
+int dict_iset(struct dict *dict, char *key, size_t len, void *val) {
+    struct dict_node *node = dict_entry_node(dict, key, len, NULL);
+
+    if (node == NULL) return DICT_ENOMEM;
+
+    /* owned keys are kept, the caller's key may be gone */
+    if (!dict->own) {
+        node->key = key;
+        node->len = len;
+    }
+    node->val = val;
     return DICT_OK;
 }
 
@@ -248,18 +396,36 @@ int dict_set(struct dict *dict, char *key, void *val) {
     return dict_iset(dict, key, strlen(key), val);
 }
 
-/* Get val by key from dict, NULL on not found. */
+/* Get the val slot of a key in dict, the key is set with NULL val if not
+ * found, e.g. to count keys:
+ *
+ *   void **val = dict_ientry(dict, key, len, NULL);
+ *   if (val != NULL) *val = (void *)((intptr_t)*val + 1);
+ *
+ * The key is hashed and looked up once. If `inserted` is not NULL, it's set
+ * to 1 if the key is new and inserted else 0. The slot is valid until the
+ * key is popped. Returns NULL on no memory. */
+void **dict_ientry(struct dict *dict, char *key, size_t len, int *inserted) {
+    struct dict_node *node = dict_entry_node(dict, key, len, inserted);
+
+    if (node == NULL) return NULL;
+    return &node->val;
+}
+
+/* Get the val slot of a NULL-terminated key in dict. */
+void **dict_entry(struct dict *dict, char *key, int *inserted) {
+    return dict_ientry(dict, key, strlen(key), inserted);
+}
+
+/* Get val by key from dict, NULL on not found. Lookups never migrate
+ * buckets, so they are safe during an iteration. */
 void *dict_iget(struct dict *dict, char *key, size_t len) {
     assert(dict != NULL);
 
-    size_t index = dict_table_idx(dict->idx, key, len);
-    struct dict_node *node = (dict->table)[index];
-
-    while (node != NULL) {
-        if (dict_key_equals(node->key, node->len, key, len)) return node->val;
-        node = node->next;
-    }
+    uint32_t hash = (dict->hash)(key, len, dict->seed);
+    struct dict_node **link = dict_find(dict, key, len, hash);
 
+    if (link != NULL) return (*link)->val;
     return NULL;
 }
 
@@ -268,18 +434,48 @@ void *dict_get(struct dict *dict, char *key) {
     return dict_iget(dict, key, strlen(key));
 }
 
-/* Test if a key is in dict. */
-int dict_ihas(struct dict *dict, char *key, size_t len) {
+/* Get vals of n keys from dict into `vals`, NULL on not found. Every
+ * `DICT_BATCH_UNIT` keys are hashed and their buckets prefetched, then the
+ * chain heads, before any of them is looked up, so that the cache misses
+ * of big tables overlap. Returns the number of keys found. */
+size_t dict_iget_many(struct dict *dict, char **keys, size_t *lens, size_t n,
+                      void **vals) {
     assert(dict != NULL);
+    assert(n == 0 || (keys != NULL && lens != NULL && vals != NULL));
 
-    size_t index = dict_table_idx(dict->idx, key, len);
-    struct dict_node *node = (dict->table)[index];
+    size_t i, k, found = 0;
+    uint32_t hashes[DICT_BATCH_UNIT];
+    struct dict_node **buckets[DICT_BATCH_UNIT];
 
-    while (node != NULL) {
-        if (dict_key_equals(node->key, node->len, key, len)) return 1;
-        node = node->next;
+    for (i = 0; i < n; i += DICT_BATCH_UNIT) {
+        size_t batch = n - i < DICT_BATCH_UNIT ? n - i : DICT_BATCH_UNIT;
+
+        for (k = 0; k < batch; k++) {
+            hashes[k] = (dict->hash)(keys[i + k], lens[i + k], dict->seed);
+            buckets[k] = &(dict->table)[dict_table_idx(dict->idx, hashes[k])];
+            __builtin_prefetch(buckets[k]);
+        }
+
+        for (k = 0; k < batch; k++)
+            if (*buckets[k] != NULL) __builtin_prefetch(*buckets[k]);
+
+        for (k = 0; k < batch; k++) {
+            struct dict_node **link =
+                dict_find(dict, keys[i + k], lens[i + k], hashes[k]);
+            vals[i + k] = link != NULL ? (*link)->val : NULL;
+            if (link != NULL) found++;
+        }
     }
+    return found;
+}
 
+/* Test if a key is in dict. */
+int dict_ihas(struct dict *dict, char *key, size_t len) {
+    assert(dict != NULL);
+
+    uint32_t hash = (dict->hash)(key, len, dict->seed);
+
+    if (dict_find(dict, key, len, hash) != NULL) return 1;
     return 0;
 }
 
@@ -292,28 +488,29 @@ int dict_has(struct dict *dict, char *key) {
 void *dict_ipop(struct dict *dict, char *key, size_t len) {
     assert(dict != NULL);
 
-    size_t index = dict_table_idx(dict->idx, key, len);
-    struct dict_node *node = (dict->table)[index];
-    struct dict_node *prev = NULL;
-
-    while (node != NULL) {
-        if (dict_key_equals(node->key, node->len, key, len)) {
-            if (prev == NULL) {
-                (dict->table)[index] = node->next;
-            } else {
-                prev->next = node->next;
-            }
-            void *val = node->val;
-            dict_node_free(node);
-            dict->len -= 1;
-            return val;
-        }
-
-        prev = node;
-        node = node->next;
-    }
-
-    return NULL;
+    dict_rehash(dict, DICT_REHASH_UNIT);
+
+    uint32_t hash = (dict->hash)(key, len, dict->seed);
+    struct dict_node **link = dict_find(dict, key, len, hash);
+
+    if (link == NULL) return NULL;
+
+    struct dict_node *node = *link;
+    void *val = node->val;
+    *link = node->next;
+    if (dict->own) map_keys_drop(&dict->keys, node->key, node->len);
+    dict_node_free(dict, node);
+    dict->len -= 1;
+
+    /* move to the previous table size once it is light enough and the
+     * nodes fill under half its load limit, so that it does not grow back
+     * soon whatever the ratio of the two sizes; not while rehashing, keeps
+     * the bigger table on no memory */
+    if (dict->old_table == NULL && dict->idx > 0 &&
+        dict->len < dict_table_sizes[dict->idx] * dict->shrink &&
+        dict->len < dict_table_sizes[dict->idx - 1] * DICT_LOAD_LIMIT / 2)
+        dict_resize(dict, dict->idx - 1);
+    return val;
 }
 
 /* Pop a key from dict by NULL-terminated key, NULL on not found. */
@@ -321,6 +518,56 @@ void *dict_pop(struct dict *dict, char *key) {
     return dict_ipop(dict, key, strlen(key));
 }
 
+/* Shrink dict to the smallest table that holds its nodes under the load
+ * limit, the rehashing is done at once. */
+int dict_shrink_to_fit(struct dict *dict) {
+    assert(dict != NULL);
+
+    size_t idx = 0;
+
+    while (dict_table_sizes[idx] * DICT_LOAD_LIMIT < dict->len) idx++;
+
+    if (idx < dict->idx && dict_resize(dict, idx) != DICT_OK)
+        return DICT_ENOMEM;
+
+    while (dict_rehash(dict, 1024))
+        ;
+
+    if (!dict->own || dict->keys.live == dict->keys.len) return DICT_OK;
+
+    /* pack the keys out of blocks with popped keys into new blocks, the
+     * keys packed so far are kept on no memory */
+    struct map_keys keys = {NULL, 0, 0, 0};
+    size_t index, size = dict_table_sizes[dict->idx];
+    int err = DICT_OK;
+
+    for (index = 0; index < size && err == DICT_OK; index++) {
+        struct dict_node *node = dict->table[index];
+
+        for (; node != NULL && err == DICT_OK; node = node->next) {
+            char *key =
+                map_keys_pack(&dict->keys, &keys, node->key, node->len);
+
+            if (key == NULL)
+                err = DICT_ENOMEM;
+            else
+                node->key = key;
+        }
+    }
+    map_keys_merge(&dict->keys, &keys);
+    return err;
+}
+
+/* Set the load factor under which the dict shrinks on pop,
+ * DICT_SHRINK_LIMIT by default, 0 to never shrink. It must be under half
+ * the load limit. A dict shrinks only if its nodes fill the smaller table
+ * under half the load limit too, so it does not grow back at once. */
+void dict_set_shrink_limit(struct dict *dict, double limit) {
+    assert(dict != NULL);
+    assert(limit >= 0 && limit < DICT_LOAD_LIMIT / 2);
+    dict->shrink = limit;
+}
+
 /* Create dict iter, e.g.
  *
  *   struct dict_iter *iter = dict_iter_new(dict);
@@ -349,6 +596,11 @@ void *dict_pop(struct dict *dict, char *key) {
  *      node->key..
  *      node->val..
  *   }
+ *
+ * Get and has are safe during the iteration, they don't migrate nodes.
+ * Set and pop may migrate nodes between tables while the dict is
+ * rehashing, and pop may shrink the dict, so don't call them during the
+ * iteration.
  * */
 struct dict_iter *dict_iter_new(struct dict *dict) {
     assert(dict != NULL);
@@ -368,7 +620,8 @@ void dict_iter_free(struct dict_iter *iter) {
     if (iter != NULL) free(iter);
 }
 
-/* Get current node and seek next, NULL on end. */
+/* Get current node and seek next, NULL on end. The old table is iterated
+ * before the new table while rehashing. */
 struct dict_node *dict_iter_next(struct dict_iter *iter) {
     assert(iter != NULL && iter->dict != NULL);
 
@@ -380,15 +633,24 @@ struct dict_node *dict_iter_next(struct dict_iter *iter) {
     }
 
     assert(dict->idx <= dict_idx_max);
-    size_t table_size = dict_table_sizes[dict->idx];
+    size_t old_table_size = 0;
 
-    if (iter->index >= table_size) return NULL;
+    if (dict->old_table != NULL)
+        old_table_size = dict_table_sizes[dict->old_idx];
+
+    size_t table_size = old_table_size + dict_table_sizes[dict->idx];
 
     if (iter->node != NULL) iter->node = iter->node->next;
 
     while (iter->node == NULL) {
         if (iter->index >= table_size) return NULL;
-        iter->node = (dict->table)[iter->index++];
+
+        size_t index = iter->index++;
+
+        if (index < old_table_size)
+            iter->node = (dict->old_table)[index];
+        else
+            iter->node = (dict->table)[index - old_table_size];
     }
     return iter->node;
 }
@@ -399,3 +661,130 @@ void dict_iter_rewind(struct dict_iter *iter) {
     iter->node = NULL;
     iter->index = 0;
 }
+
+/* Get the first hash after the bucket of given table where hash `c` is. */
+static uint64_t dict_scan_end(size_t idx, uint64_t c) {
+    uint64_t size = dict_table_sizes[idx];
+    uint64_t b = dict_table_idx(idx, (uint32_t)c);
+    return (((b + 1) << 32) + size - 1) / size;
+}
+
+/* Call `fn` on the nodes in the bucket of given table where hash `c` is,
+ * of which the hash is in [c, hi). */
+static void dict_scan_bucket(struct dict_node **table, size_t idx, uint64_t c,
+                             uint64_t hi, dict_scan_t fn, void *data) {
+    struct dict_node *node = table[dict_table_idx(idx, (uint32_t)c)];
+
+    while (node != NULL) {
+        struct dict_node *next = node->next;
+        if (node->hash >= c && node->hash < hi) (fn)(node, data);
+        node = next;
+    }
+}
+
+/* Scan dict incrementally, e.g.
+ *
+ *   size_t cursor = 0;
+ *   do {
+ *       cursor = dict_scan(dict, cursor, 100, fn, data);
+ *   } while (cursor != 0);
+ *
+ * Each call visits about `count` buckets from the cursor and calls `fn` on
+ * their nodes, returns the cursor to continue with, 0 on end. Table sizes
+ * are primes, so the cursor is a hash value instead of a bucket index:
+ * buckets cover ascending hash ranges in every table size, a node present
+ * for the whole scan is visited at least once even if the dict resizes or
+ * rehashes between calls. `fn` must not set or pop on the dict. */
+size_t dict_scan(struct dict *dict, size_t cursor, size_t count,
+                 dict_scan_t fn, void *data) {
+    assert(dict != NULL);
+
+    if (dict->table == NULL) return 0;
+    if (count == 0) count = 1;
+
+    uint64_t c = cursor;
+
+    do {
+        uint64_t hi = dict_scan_end(dict->idx, c);
+
+        /* visit the matching bucket of both tables while rehashing, up to
+         * the lower bucket end, the rest is left to the next round */
+        if (dict->old_table != NULL) {
+            uint64_t old_hi = dict_scan_end(dict->old_idx, c);
+            if (old_hi < hi) hi = old_hi;
+            dict_scan_bucket(dict->old_table, dict->old_idx, c, hi, fn, data);
+        }
+        dict_scan_bucket(dict->table, dict->idx, c, hi, fn, data);
+        c = hi;
+    } while (c < ((uint64_t)1 << 32) && --count > 0);
+
+    if (c >= ((uint64_t)1 << 32)) return 0;
+    return (size_t)c;
+}
+
+/* Count the chain lengths of buckets into stats. */
+static void dict_stats_table(struct dict_node **table, size_t start,
+                             size_t end, struct dict_stats *stats,
+                             size_t *chains) {
+    size_t index;
+
+    for (index = start; index < end; index++) {
+        size_t len = 0;
+        struct dict_node *node = table[index];
+
+        for (; node != NULL; node = node->next) len++;
+
+        stats->chains[len < DICT_STATS_BINS ? len : DICT_STATS_BINS - 1]++;
+
+        if (len > stats->chain_max) stats->chain_max = len;
+
+        if (len > 0) (*chains)++;
+    }
+}
+
+/* Get the stats of dict, to tell e.g. bad hash distributions by the chain
+ * lengths. The buckets of the old table not migrated yet are counted in
+ * too. The lookup counters are set if counting. */
+void dict_stats(struct dict *dict, struct dict_stats *stats) {
+    assert(dict != NULL && dict->idx <= dict_idx_max);
+    assert(stats != NULL);
+
+    memset(stats, 0, sizeof(struct dict_stats));
+
+    size_t cap = dict_table_sizes[dict->idx], chains = 0;
+    stats->cap = cap;
+    stats->len = dict->len;
+    stats->load = (double)dict->len / cap;
+    stats->bytes = sizeof(struct dict) + cap * sizeof(struct dict_node *) +
+                   dict->keys.cap;
+    dict_stats_table(dict->table, 0, cap, stats, &chains);
+
+    if (dict->old_table != NULL) {
+        size_t old_cap = dict_table_sizes[dict->old_idx];
+        stats->bytes += old_cap * sizeof(struct dict_node *);
+        dict_stats_table(dict->old_table, dict->rehash_pos, old_cap, stats,
+                         &chains);
+    }
+
+    struct dict_slab *slab;
+
+    for (slab = dict->slabs; slab != NULL; slab = slab->next)
+        stats->bytes += sizeof(struct dict_slab) +
+                        slab->size * sizeof(struct dict_node);
+
+    if (chains > 0) stats->chain_avg = (double)dict->len / chains;
+
+    stats->lookups = dict->lookups;
+
+    if (dict->lookups > 0)
+        stats->probes_avg = (double)dict->probes / dict->lookups;
+}
+
+/* Turn on or off the counting of lookups for `dict_stats`, which costs a
+ * branch and two adds per lookup. The counters are reset. */
+void dict_stats_counting(struct dict *dict, int on) {
+    assert(dict != NULL);
+    dict->counting = on;
+    dict->lookups = 0;
+    dict->probes = 0;
+}
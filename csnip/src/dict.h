@@ -1,8 +1,10 @@
 /**
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
- * Dynamic sized list-based hashtable implementation.
- * deps: None
+ * Dynamic sized list-based hashtable implementation, growing by incremental
+ * rehashing: the nodes are migrated to the new table a few buckets at a
+ * time on each set and pop, lookups leave the tables as they are.
+ * deps: map.c alloc.c
  */
 
 #ifndef __DICT_H__
@@ -11,15 +13,28 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "alloc.h"
+#include "map.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
-#define DICT_LOAD_LIMIT 0.72 /* load factor */
+#define DICT_LOAD_LIMIT 0.72   /* load factor */
+#define DICT_SHRINK_LIMIT 0.18 /* default load factor to shrink under */
+#define DICT_REHASH_UNIT 1     /* buckets to migrate on each write */
+#define DICT_REHASH_BOOST 8    /* times more over the load limit */
+#define DICT_SLAB_MIN 8        /* nodes in the first node slab */
+#define DICT_SLAB_MAX 4096     /* max nodes in a node slab */
+#define DICT_BATCH_UNIT 16     /* keys prefetched at once */
+#define DICT_STATS_BINS 16     /* chain length histogram size */
 #define dict() dict_new()
 #define dict_iter(dict) dict_iter_new(dict)
 #define dict_each(iter, node) while (((node) = dict_iter_next((iter))) != NULL)
 
+/* key hash function type, the seed is random per dict. */
+typedef uint64_t (*dict_hash_t)(char *key, size_t len, uint64_t seed);
+
 enum {
     DICT_OK = 0,     /* operation is ok */
     DICT_ENOMEM = 1, /* no memory error */
@@ -29,13 +44,49 @@ struct dict_node {
     char *key;              /* key string */
     size_t len;             /* key length will be set on `node_new` */
     void *val;              /* value data */
+    uint32_t hash;          /* cached key hash, the low 32 bits */
     struct dict_node *next; /* next node */
 };
 
+struct dict_slab {
+    struct dict_slab *next;   /* next (older) slab */
+    size_t size;              /* number of nodes */
+    struct dict_node nodes[]; /* node memory */
+};
+
 struct dict {
-    size_t idx;               /* index in table sizes */
-    size_t len;               /* dict length */
-    struct dict_node **table; /* node table */
+    size_t idx;                   /* index in table sizes */
+    size_t len;                   /* dict length */
+    struct dict_node **table;     /* node table */
+    dict_hash_t hash;             /* key hash function */
+    uint64_t seed;                /* key hash seed */
+    size_t old_idx;               /* index in table sizes of old table */
+    struct dict_node **old_table; /* old table under rehashing, or NULL */
+    size_t rehash_pos;            /* next bucket to migrate in old table */
+    struct dict_slab *slabs;      /* slabs where nodes are allocated from */
+    struct dict_node *free_nodes; /* free nodes, linked by `next` */
+    struct alloc *alloc;          /* allocator of node slabs */
+    int own;                      /* if keys are copied into the key arena */
+    struct map_keys keys;         /* key arena, see map.h */
+    int counting;                 /* if lookups are counted */
+    uint64_t lookups;             /* lookups counted */
+    uint64_t probes;              /* nodes visited by the lookups counted */
+    int huge;                     /* if the tables are from `alloc_huge_lazy` */
+    double shrink;                /* load factor to shrink under, 0 for
+                                   * never */
+};
+
+struct dict_stats {
+    size_t cap;                     /* dict capacity */
+    size_t len;                     /* dict length */
+    double load;                    /* load factor, len / cap */
+    size_t chains[DICT_STATS_BINS]; /* buckets by chain length, the last
+                                     * bin for the longer */
+    size_t chain_max;               /* max chain length */
+    double chain_avg;               /* average length of non-empty chains */
+    size_t bytes;                   /* memory used by dict */
+    uint64_t lookups;               /* lookups counted */
+    double probes_avg;              /* average nodes visited per lookup */
 };
 
 struct dict_iter {
@@ -44,7 +95,14 @@ struct dict_iter {
     struct dict_node *node; /* current dict node */
 };
 
+/* scan callback type, called with each node and the user data. */
+typedef void (*dict_scan_t)(struct dict_node *node, void *data);
+
 struct dict *dict_new(void);
+struct dict *dict_new_hash(dict_hash_t hash);
+struct dict *dict_new_owned(void);
+struct dict *dict_new_alloc(struct alloc *a);
+struct dict *dict_new_huge(void);
 void dict_clear(struct dict *dict); /* O(N) */
 void dict_free(struct dict *dict);
 size_t dict_len(struct dict *dict);                    /* O(1) */
@@ -61,6 +119,19 @@ int dict_iset(struct dict *dict, char *key, size_t len, void *val); /* O(1) */
 void *dict_iget(struct dict *dict, char *key, size_t len);          /* O(1) */
 void *dict_ipop(struct dict *dict, char *key, size_t len);          /* O(1) */
 int dict_ihas(struct dict *dict, char *key, size_t len);            /* O(1) */
+uint64_t dict_hash(char *key, size_t len, uint64_t seed);           /* O(N) */
+int dict_rehash_step(struct dict *dict, long budget_us);
+size_t dict_scan(struct dict *dict, size_t cursor, size_t count,
+                 dict_scan_t fn, void *data);
+int dict_shrink_to_fit(struct dict *dict); /* O(N) */
+void dict_set_shrink_limit(struct dict *dict, double limit);
+void **dict_entry(struct dict *dict, char *key, int *inserted); /* O(1) */
+void **dict_ientry(struct dict *dict, char *key, size_t len,
+                   int *inserted); /* O(1) */
+size_t dict_iget_many(struct dict *dict, char **keys, size_t *lens, size_t n,
+                      void **vals); /* O(n) */
+void dict_stats(struct dict *dict, struct dict_stats *stats); /* O(N) */
+void dict_stats_counting(struct dict *dict, int on);          /* O(1) */
 
 #if defined(__cplusplus)
 }
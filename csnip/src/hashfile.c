@@ -0,0 +1,324 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dict.h"
+#include "hashfile.h"
+#include "map.h"
+
+/* Open a hash file by mmap, NULL on failure or if it's not a valid hash
+ * file. */
+struct hashfile *hashfile_open(char *path) {
+    assert(path != NULL);
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) return NULL;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 ||
+        (size_t)st.st_size < sizeof(struct hashfile_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) return NULL;
+
+    size_t size = st.st_size;
+    struct hashfile_header *head = (struct hashfile_header *)data;
+
+    /* validate the header, so lookups only check record bounds and stop
+     * after all slots */
+    if (memcmp(head->magic, HASHFILE_MAGIC, 8) != 0 || head->cap == 0 ||
+        (head->cap & (head->cap - 1)) != 0 || head->len >= head->cap ||
+        head->slots % 8 != 0 || head->slots < sizeof(*head) ||
+        head->slots > size ||
+        (size - head->slots) / sizeof(struct hashfile_slot) < head->cap) {
+        munmap(data, size);
+        return NULL;
+    }
+
+    struct hashfile *hf = malloc(sizeof(struct hashfile));
+
+    if (hf == NULL) {
+        munmap(data, size);
+        return NULL;
+    }
+
+    hf->data = data;
+    hf->size = size;
+    hf->head = head;
+    hf->slots = (struct hashfile_slot *)(data + head->slots);
+    return hf;
+}
+
+/* Close a hash file, the vals got from it are gone. */
+void hashfile_close(struct hashfile *hf) {
+    if (hf != NULL) {
+        munmap(hf->data, hf->size);
+        free(hf);
+    }
+}
+
+/* Get the number of records in hash file. */
+size_t hashfile_len(struct hashfile *hf) {
+    assert(hf != NULL);
+    return hf->head->len;
+}
+
+/* Get val by key from hash file, NULL on not found. The val points into
+ * the mapped file and is NULL-terminated, its length is set to `vlen` if
+ * not NULL. */
+char *hashfile_iget(struct hashfile *hf, char *key, size_t len,
+                    size_t *vlen) {
+    assert(hf != NULL);
+    assert(key != NULL);
+
+    uint64_t hash = map_hash(key, len, hf->head->seed);
+    uint64_t mask = hf->head->cap - 1;
+    uint64_t i = hash & mask, n;
+
+    /* the load limit keeps empty slots, probes end there; a corrupted file
+     * may have none, probes end after all slots */
+    for (n = 0; n < hf->head->cap; n++, i = (i + 1) & mask) {
+        struct hashfile_slot *slot = &hf->slots[i];
+
+        if (slot->off == 0) return NULL;
+
+        if (slot->hash != hash) continue;
+
+        uint32_t lens[2];
+
+        if (slot->off > hf->head->slots - sizeof(lens)) return NULL;
+
+        char *rec = hf->data + slot->off;
+        memcpy(lens, rec, sizeof(lens));
+
+        if (hf->head->slots - slot->off - sizeof(lens) <
+            (uint64_t)lens[0] + lens[1] + 2)
+            return NULL;
+
+        if (lens[0] == len && memcmp(rec + sizeof(lens), key, len) == 0) {
+            if (vlen != NULL) *vlen = lens[1];
+            return rec + sizeof(lens) + len + 1;
+        }
+    }
+    return NULL;
+}
+
+/* Get val by NULL-terminated key from hash file, NULL on not found. */
+char *hashfile_get(struct hashfile *hf, char *key) {
+    return hashfile_iget(hf, key, strlen(key), NULL);
+}
+
+/* Create a hash file writer, the file is written to a temporary path and
+ * renamed to `path` on close, so readers never see a partial file. NULL
+ * on failure. */
+struct hashfile_writer *hashfile_writer_new(char *path) {
+    assert(path != NULL);
+
+    struct hashfile_writer *w = malloc(sizeof(struct hashfile_writer));
+
+    if (w == NULL) return NULL;
+
+    size_t len = strlen(path);
+    w->path = malloc(2 * len + sizeof(HASHFILE_TMP_SUFFIX) + 1);
+
+    if (w->path == NULL) {
+        free(w);
+        return NULL;
+    }
+
+    w->tmp = w->path + len + 1;
+    memcpy(w->path, path, len + 1);
+    memcpy(w->tmp, path, len);
+    memcpy(w->tmp + len, HASHFILE_TMP_SUFFIX, sizeof(HASHFILE_TMP_SUFFIX));
+
+    w->fp = fopen(w->tmp, "wb");
+
+    struct hashfile_header head;
+    memset(&head, 0, sizeof(head));
+
+    /* the header is written on close */
+    if (w->fp == NULL || fwrite(&head, sizeof(head), 1, w->fp) != 1) {
+        if (w->fp != NULL) {
+            fclose(w->fp);
+            unlink(w->tmp);
+        }
+        free(w->path);
+        free(w);
+        return NULL;
+    }
+
+    w->seed = map_seed();
+    w->off = sizeof(head);
+    w->slots = NULL;
+    w->len = 0;
+    w->cap = 0;
+    return w;
+}
+
+/* Put a record into hash file writer. Keys should be unique, lookups get
+ * the first record of a key. */
+int hashfile_writer_put(struct hashfile_writer *w, char *key, size_t len,
+                        char *val, size_t vlen) {
+    assert(w != NULL && w->fp != NULL);
+    assert(key != NULL);
+    assert(val != NULL || vlen == 0);
+
+    if (len > UINT32_MAX || vlen > UINT32_MAX) return HASHFILE_ETOOBIG;
+
+    if (w->len == w->cap) {
+        size_t cap = w->cap == 0 ? 1024 : w->cap * 2;
+        struct hashfile_slot *slots =
+            realloc(w->slots, cap * sizeof(struct hashfile_slot));
+
+        if (slots == NULL) return HASHFILE_ENOMEM;
+
+        w->slots = slots;
+        w->cap = cap;
+    }
+
+    uint32_t lens[2] = {len, vlen};
+
+    if (fwrite(lens, sizeof(lens), 1, w->fp) != 1 ||
+        fwrite(key, 1, len, w->fp) != len || fputc(0, w->fp) == EOF ||
+        (vlen > 0 && fwrite(val, 1, vlen, w->fp) != vlen) ||
+        fputc(0, w->fp) == EOF)
+        return HASHFILE_EWRITE;
+
+    w->slots[w->len].hash = map_hash(key, len, w->seed);
+    w->slots[w->len].off = w->off;
+    w->len++;
+    w->off += sizeof(lens) + len + vlen + 2;
+    return HASHFILE_OK;
+}
+
+/* Write the slots after the records, then the header. */
+static int hashfile_writer_finish(struct hashfile_writer *w) {
+    struct hashfile_header head;
+    memcpy(head.magic, HASHFILE_MAGIC, 8);
+    head.seed = w->seed;
+    head.len = w->len;
+    head.cap = 2;
+    head.slots = (w->off + 7) & ~(uint64_t)7;
+
+    while (head.cap * HASHFILE_LOAD_LIMIT < w->len + 1) head.cap *= 2;
+
+    struct hashfile_slot *slots =
+        calloc(head.cap, sizeof(struct hashfile_slot));
+
+    if (slots == NULL) return HASHFILE_ENOMEM;
+
+    size_t i;
+
+    for (i = 0; i < w->len; i++) {
+        uint64_t j = w->slots[i].hash & (head.cap - 1);
+
+        while (slots[j].off != 0) j = (j + 1) & (head.cap - 1);
+        slots[j] = w->slots[i];
+    }
+
+    char pad[8] = {0};
+    int err = 0;
+
+    err |= fwrite(pad, 1, head.slots - w->off, w->fp) != head.slots - w->off;
+    err |= fwrite(slots, sizeof(struct hashfile_slot), head.cap, w->fp) !=
+           head.cap;
+    err |= fseek(w->fp, 0, SEEK_SET) != 0;
+    err |= fwrite(&head, sizeof(head), 1, w->fp) != 1;
+    err |= fflush(w->fp) != 0;
+    err |= fsync(fileno(w->fp)) != 0;
+    free(slots);
+
+    if (err) return HASHFILE_EWRITE;
+    return HASHFILE_OK;
+}
+
+/* Close the file and free the writer, the file is renamed to the final
+ * path if `err` is ok, else removed. Returns the error. */
+static int hashfile_writer_end(struct hashfile_writer *w, int err) {
+    if (fclose(w->fp) != 0 && err == HASHFILE_OK) err = HASHFILE_EWRITE;
+
+    if (err == HASHFILE_OK && rename(w->tmp, w->path) != 0)
+        err = HASHFILE_ERENAME;
+
+    if (err != HASHFILE_OK) unlink(w->tmp);
+
+    free(w->slots);
+    free(w->path);
+    free(w);
+    return err;
+}
+
+/* Finish the hash file and free the writer. On failure the file at the
+ * path is left as is. */
+int hashfile_writer_close(struct hashfile_writer *w) {
+    assert(w != NULL && w->fp != NULL);
+    return hashfile_writer_end(w, hashfile_writer_finish(w));
+}
+
+/* Get the length of a val dumped, by `vlen` or as a NULL-terminated
+ * string, NULL as empty. */
+static size_t hashfile_vlen(hashfile_vlen_t vlen, void *val) {
+    if (vlen != NULL) return val != NULL ? (vlen)(val) : 0;
+    return val != NULL ? strlen(val) : 0;
+}
+
+/* Write a map to a hash file, the val lengths are given by `vlen`, NULL
+ * for NULL-terminated string vals. */
+int hashfile_dump_map(struct map *m, char *path, hashfile_vlen_t vlen) {
+    assert(m != NULL);
+
+    struct hashfile_writer *w = hashfile_writer_new(path);
+
+    if (w == NULL) return HASHFILE_EOPEN;
+
+    struct map_iter iter = {m};
+    struct map_node *node = NULL;
+    int err = HASHFILE_OK;
+
+    while (err == HASHFILE_OK && (node = map_iter_next(&iter)) != NULL) {
+        err = hashfile_writer_put(w, node->key, node->len, node->val,
+                                  hashfile_vlen(vlen, node->val));
+    }
+
+    if (err != HASHFILE_OK) return hashfile_writer_end(w, err);
+    return hashfile_writer_close(w);
+}
+
+/* Write a dict to a hash file, the val lengths are given by `vlen`, NULL
+ * for NULL-terminated string vals. */
+int hashfile_dump_dict(struct dict *dict, char *path, hashfile_vlen_t vlen) {
+    assert(dict != NULL);
+
+    struct hashfile_writer *w = hashfile_writer_new(path);
+
+    if (w == NULL) return HASHFILE_EOPEN;
+
+    struct dict_iter iter = {dict};
+    struct dict_node *node = NULL;
+    int err = HASHFILE_OK;
+
+    while (err == HASHFILE_OK && (node = dict_iter_next(&iter)) != NULL) {
+        err = hashfile_writer_put(w, node->key, node->len, node->val,
+                                  hashfile_vlen(vlen, node->val));
+    }
+
+    if (err != HASHFILE_OK) return hashfile_writer_end(w, err);
+    return hashfile_writer_close(w);
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ *
+ * Immutable on-disk hashtable, in the style of cdb. A file is written once
+ * by a writer, e.g. from a map or dict, then read by mmap: lookups parse
+ * and allocate nothing, and processes reading a file share its page cache.
+ * Layout (native byte order):
+ *
+ *   header  | magic, hash seed, number of records and slots, slots offset
+ *   records | key length (u32), val length (u32), key, '\0', val, '\0'
+ *   slots   | key hash (u64), record offset (u64), 0 for empty slots
+ *
+ * Maps and dicts are dumped with a function giving the length of a val,
+ * NULL if the vals are NULL-terminated strings (NULL for empty).
+ *
+ * deps: map.c dict.c alloc.c
+ */
+
+#ifndef __HASHFILE_H__
+#define __HASHFILE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dict.h"
+#include "map.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define HASHFILE_MAGIC "CSNIPHF1"  /* file magic, 8 bytes */
+#define HASHFILE_LOAD_LIMIT 0.5    /* load factor of slots */
+#define HASHFILE_TMP_SUFFIX ".tmp" /* writer writes to path + suffix */
+
+enum {
+    HASHFILE_OK = 0,      /* operation is ok */
+    HASHFILE_ENOMEM = 1,  /* no memory error */
+    HASHFILE_EOPEN = 2,   /* failed to open file */
+    HASHFILE_EWRITE = 3,  /* failed to write to file */
+    HASHFILE_ERENAME = 4, /* failed to rename file */
+    HASHFILE_ETOOBIG = 5, /* key or val is too large */
+};
+
+/* val length function type, for the vals dumped from a map or dict. */
+typedef size_t (*hashfile_vlen_t)(void *val);
+
+struct hashfile_header {
+    char magic[8];  /* HASHFILE_MAGIC */
+    uint64_t seed;  /* key hash seed */
+    uint64_t len;   /* number of records */
+    uint64_t cap;   /* number of slots, 2** */
+    uint64_t slots; /* slots offset */
+};
+
+struct hashfile_slot {
+    uint64_t hash; /* key hash */
+    uint64_t off;  /* record offset, 0 for empty */
+};
+
+struct hashfile {
+    char *data;                   /* mapped file */
+    size_t size;                  /* file size */
+    struct hashfile_header *head; /* header, at the file start */
+    struct hashfile_slot *slots;  /* slots, in the file */
+};
+
+struct hashfile_writer {
+    FILE *fp;                    /* file to write */
+    char *path;                  /* final path */
+    char *tmp;                   /* path written, renamed on close */
+    uint64_t seed;               /* key hash seed */
+    uint64_t off;                /* offset of the next record */
+    struct hashfile_slot *slots; /* slots of records written, in order */
+    size_t len;                  /* number of records written */
+    size_t cap;                  /* capacity of `slots` */
+};
+
+struct hashfile *hashfile_open(char *path);
+void hashfile_close(struct hashfile *hf);
+size_t hashfile_len(struct hashfile *hf);           /* O(1) */
+char *hashfile_get(struct hashfile *hf, char *key); /* O(1) */
+char *hashfile_iget(struct hashfile *hf, char *key, size_t len,
+                    size_t *vlen); /* O(1) */
+struct hashfile_writer *hashfile_writer_new(char *path);
+int hashfile_writer_put(struct hashfile_writer *w, char *key, size_t len,
+                        char *val, size_t vlen);
+int hashfile_writer_close(struct hashfile_writer *w);
+int hashfile_dump_map(struct map *m, char *path, hashfile_vlen_t vlen);
+int hashfile_dump_dict(struct dict *dict, char *path, hashfile_vlen_t vlen);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
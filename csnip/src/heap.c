@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "alloc.h"
 #include "heap.h"
 
 /* Create an empty heap. */
@@ -16,14 +17,27 @@ struct heap *heap_new(heap_cmp_t cmp) {
         heap->len = 0;
         heap->cmp = cmp;
         heap->data = NULL;
+        heap->huge = 0;
     }
     return heap;
 }
 
+/* Create an empty heap with its data backed by huge pages if possible, see
+ * `alloc_huge`. */
+struct heap *heap_new_huge(heap_cmp_t cmp) {
+    struct heap *heap = heap_new(cmp);
+
+    if (heap != NULL) heap->huge = 1;
+    return heap;
+}
+
 /* Free heap. */
 void heap_free(struct heap *heap) {
     if (heap != NULL) {
-        if (heap->data != NULL) free(heap->data);
+        if (heap->huge)
+            alloc_huge_free(heap->data, heap->cap * sizeof(void *));
+        else
+            free(heap->data);
         free(heap);
     }
 }
@@ -63,7 +77,10 @@ int heap_grow(struct heap *heap, size_t cap) {
     size_t new_cap = heap->cap + unit;
     while (new_cap < cap) new_cap += unit;
 
-    void **data = realloc(heap->data, new_cap * sizeof(void *));
+    void **data =
+        heap->huge ? alloc_huge_realloc(heap->data, heap->cap * sizeof(void *),
+                                        new_cap * sizeof(void *))
+                   : realloc(heap->data, new_cap * sizeof(void *));
     if (data == NULL) return HEAP_ENOMEM;
 
     heap->data = data;
@@ -1,14 +1,26 @@
 /**
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
- * Array based binary heap (or priority queue) implementation.
- * deps: None.
+ * Array based binary heap (or priority queue) implementation. Besides the
+ * heap of `void *` with a comparator, `HEAP_DEFINE(name, T, less)` defines
+ * a typed min heap `struct name` storing elements of type T inline, with
+ * static inline functions `name_new`, `name_push`, `name_pop` etc., where
+ * `less(a, b)` is inlined, `name_new_alloc` takes an allocator for the heap
+ * and its data, e.g.
+ *
+ *   #define timer_less(a, b) ((a).fire_at < (b).fire_at)
+ *   HEAP_DEFINE(timers, struct timer, timer_less)
+ *
+ * deps: alloc.c
  */
 
 #ifndef __HEAP_H__
 #define __HEAP_H__
 
 #include <stddef.h>
+#include <stdlib.h>
+
+#include "alloc.h"
 
 #if defined(__cplusplus)
 extern "C" {
@@ -17,6 +29,7 @@ extern "C" {
 #define HEAP_CAP_MAX 16 * 1024 * 1024 /* max memory capacity: 16mb */
 #define HEAP_UNIT_MIN 1               /* min heap realloc unit: 1 */
 #define HEAP_UNIT_MAX 1024            /* max heap realloc unit: 1kb */
+#define HEAP_CAP_INIT 16              /* init capacity of typed heaps */
 
 #define heap(cmp) heap_new(cmp)
 
@@ -33,9 +46,11 @@ struct heap {
     size_t cap;     /* heap capacity */
     size_t len;     /* heap length */
     heap_cmp_t cmp; /* node data comparator */
+    int huge;       /* if data is from `alloc_huge` */
 };
 
 struct heap *heap_new(heap_cmp_t cmp);
+struct heap *heap_new_huge(heap_cmp_t cmp);
 void heap_free(struct heap *heap);
 void heap_clear(struct heap *heap); /* O(1). */
 size_t heap_len(struct heap *heap); /* O(1) */
@@ -51,6 +66,115 @@ void heap_siftdown(struct heap *heap, size_t start_idx,
                    size_t idx);                  /* O(logN) */
 void heap_siftup(struct heap *heap, size_t idx); /* O(logN) */
 
+#define HEAP_DEFINE(name, T, less)                                           \
+    struct name {                                                            \
+        T *data;             /* heap array data */                           \
+        size_t cap;          /* heap capacity */                             \
+        size_t len;          /* heap length */                               \
+        struct alloc *alloc; /* allocator of heap and data */                \
+    };                                                                       \
+                                                                             \
+    /* Create an empty heap with an allocator for the heap and its data,     \
+     * NULL for the default. */                                              \
+    static inline struct name *name##_new_alloc(struct alloc *a) {           \
+        if (a == NULL) a = alloc_default();                                  \
+                                                                             \
+        struct name *heap = alloc_malloc(a, sizeof(struct name));            \
+                                                                             \
+        if (heap != NULL) {                                                  \
+            heap->data = NULL;                                               \
+            heap->len = 0;                                                   \
+            heap->cap = 0;                                                   \
+            heap->alloc = a;                                                 \
+        }                                                                    \
+        return heap;                                                         \
+    }                                                                        \
+                                                                             \
+    /* Create an empty heap. */                                              \
+    static inline struct name *name##_new(void) {                            \
+        return name##_new_alloc(NULL);                                       \
+    }                                                                        \
+                                                                             \
+    /* Free heap. */                                                         \
+    static inline void name##_free(struct name *heap) {                      \
+        if (heap != NULL) {                                                  \
+            alloc_free(heap->alloc, heap->data, heap->cap * sizeof(T));      \
+            alloc_free(heap->alloc, heap, sizeof(struct name));              \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    /* Clear heap, the memory is kept. */                                    \
+    static inline void name##_clear(struct name *heap) { heap->len = 0; }    \
+                                                                             \
+    /* Get heap length. */                                                   \
+    static inline size_t name##_len(struct name *heap) { return heap->len; } \
+                                                                             \
+    /* Get heap capacity. */                                                 \
+    static inline size_t name##_cap(struct name *heap) { return heap->cap; } \
+                                                                             \
+    /* Grow heap capacity to at least given cap, by doubling. */             \
+    static inline int name##_grow(struct name *heap, size_t cap) {           \
+        if (cap <= heap->cap) return HEAP_OK;                                \
+                                                                             \
+        size_t new_cap = heap->cap > 0 ? heap->cap : HEAP_CAP_INIT;          \
+                                                                             \
+        while (new_cap < cap) new_cap *= 2;                                  \
+                                                                             \
+        T *data = alloc_realloc(heap->alloc, heap->data,                     \
+                                heap->cap * sizeof(T), new_cap * sizeof(T)); \
+                                                                             \
+        if (data == NULL) return HEAP_ENOMEM;                                \
+                                                                             \
+        heap->data = data;                                                   \
+        heap->cap = new_cap;                                                 \
+        return HEAP_OK;                                                      \
+    }                                                                        \
+                                                                             \
+    /* Push an element to heap. */                                           \
+    static inline int name##_push(struct name *heap, T e) {                  \
+        if (heap->len == heap->cap &&                                        \
+            name##_grow(heap, heap->len + 1) != HEAP_OK)                     \
+            return HEAP_ENOMEM;                                              \
+                                                                             \
+        size_t idx = heap->len++;                                            \
+                                                                             \
+        while (idx > 0) {                                                    \
+            size_t parent_idx = (idx - 1) >> 1;                              \
+            if (!(less(e, heap->data[parent_idx]))) break;                   \
+            heap->data[idx] = heap->data[parent_idx];                        \
+            idx = parent_idx;                                                \
+        }                                                                    \
+        heap->data[idx] = e;                                                 \
+        return HEAP_OK;                                                      \
+    }                                                                        \
+                                                                             \
+    /* Pop the smallest element from heap into `e` if not NULL. Returns 1    \
+     * on popped, 0 if the heap is empty. */                                 \
+    static inline int name##_pop(struct name *heap, T *e) {                  \
+        if (heap->len == 0) return 0;                                        \
+                                                                             \
+        if (e != NULL) *e = heap->data[0];                                   \
+                                                                             \
+        T tail = heap->data[--heap->len];                                    \
+        size_t len = heap->len, idx = 0, child_idx = 1;                      \
+                                                                             \
+        for (; child_idx < len; child_idx = idx * 2 + 1) {                   \
+            if (child_idx + 1 < len &&                                       \
+                less(heap->data[child_idx + 1], heap->data[child_idx]))      \
+                child_idx++;                                                 \
+            if (!(less(heap->data[child_idx], tail))) break;                 \
+            heap->data[idx] = heap->data[child_idx];                         \
+            idx = child_idx;                                                 \
+        }                                                                    \
+        if (len > 0) heap->data[idx] = tail;                                 \
+        return 1;                                                            \
+    }                                                                        \
+                                                                             \
+    /* Get the smallest element of heap, NULL on empty. */                   \
+    static inline T *name##_top(struct name *heap) {                         \
+        return heap->len > 0 ? &heap->data[0] : NULL;                        \
+    }
+
 #if defined(__cplusplus)
 }
 #endif
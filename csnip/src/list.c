@@ -7,9 +7,9 @@
 
 #include "list.h"
 
-/* Create list node with data. */
-struct list_node *list_node_new(void *data) {
-    struct list_node *node = malloc(sizeof(struct list_node));
+/* Create list node with data from allocator. */
+static struct list_node *list_node_alloc(struct alloc *a, void *data) {
+    struct list_node *node = alloc_malloc(a, sizeof(struct list_node));
 
     if (node != NULL) {
         node->data = data;
@@ -19,19 +19,32 @@ struct list_node *list_node_new(void *data) {
     return node;
 }
 
-/* Free list node. */
+/* Create list node with data, from libc malloc whatever the default
+ * allocator, so that `list_node_free` frees it to where it's from. */
+struct list_node *list_node_new(void *data) {
+    return list_node_alloc(alloc_libc(), data);
+}
+
+/* Free list node created by `list_node_new`. */
 void list_node_free(struct list_node *node) {
-    if (node != NULL) free(node);
+    alloc_free(alloc_libc(), node, sizeof(struct list_node));
 }
 
 /* Create an empty list. */
-struct list *list_new(void) {
-    struct list *list = malloc(sizeof(struct list));
+struct list *list_new(void) { return list_new_alloc(NULL); }
+
+/* Create an empty list with an allocator for the list and its nodes, NULL
+ * for the default. */
+struct list *list_new_alloc(struct alloc *a) {
+    if (a == NULL) a = alloc_default();
+
+    struct list *list = alloc_malloc(a, sizeof(struct list));
 
     if (list != NULL) {
         list->head = NULL;
         list->tail = NULL;
         list->len = 0;
+        list->alloc = a;
     }
     return list;
 }
@@ -40,7 +53,7 @@ struct list *list_new(void) {
 void list_free(struct list *list) {
     if (list != NULL) {
         list_clear(list);
-        free(list);
+        alloc_free(list->alloc, list, sizeof(struct list));
     }
 }
 
@@ -61,7 +74,7 @@ size_t list_len(struct list *list) {
 int list_lpush(struct list *list, void *data) {
     assert(list != NULL);
 
-    struct list_node *node = list_node_new(data);
+    struct list_node *node = list_node_alloc(list->alloc, data);
 
     if (node == NULL) return LIST_ENOMEM;
 
@@ -86,7 +99,7 @@ int list_lpush(struct list *list, void *data) {
 int list_rpush(struct list *list, void *data) {
     assert(list != NULL);
 
-    struct list_node *node = list_node_new(data);
+    struct list_node *node = list_node_alloc(list->alloc, data);
 
     if (node == NULL) return LIST_ENOMEM;
 
@@ -133,7 +146,7 @@ void *list_lpop(struct list *list) {
     list->len -= 1;
 
     void *data = head->data;
-    list_node_free(head);
+    alloc_free(list->alloc, head, sizeof(struct list_node));
     return data;
 }
 
@@ -163,7 +176,7 @@ void *list_rpop(struct list *list) {
     list->len -= 1;
 
     void *data = tail->data;
-    list_node_free(tail);
+    alloc_free(list->alloc, tail, sizeof(struct list_node));
     return data;
 }
 
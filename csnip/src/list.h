@@ -2,7 +2,7 @@
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
  * Double-linked list implementation.
- * deps: None.
+ * deps: alloc.c
  */
 
 #ifndef __LIST_H__
@@ -10,6 +10,8 @@
 
 #include <stdlib.h>
 
+#include "alloc.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -36,6 +38,7 @@ struct list {
     struct list_node *head; /* head node */
     struct list_node *tail; /* last node */
     size_t len;             /* list length */
+    struct alloc *alloc;    /* allocator of list and nodes */
 };
 
 struct list_iter {
@@ -46,6 +49,7 @@ struct list_iter {
 struct list_node *list_node_new(void *data);
 void list_node_free(struct list_node *node);
 struct list *list_new(void);
+struct list *list_new_alloc(struct alloc *a);
 void list_free(struct list *list);
 void list_clear(struct list *list);
 size_t list_len(struct list *list);            /* O(1) */
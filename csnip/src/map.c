@@ -4,45 +4,155 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "alloc.h"
 #include "map.h"
 
-/* Hash function. */
-static uint32_t map_hash(char *key, size_t len) {
-    /* DJBX33A hash function from PHP */
-    register int hash = 5381;
-    for (; len >= 8; len -= 8) {
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
-        hash = ((hash << 5) + hash) + *key++;
+/* Multiply two 64 bits integers, the 128 bits product goes to (a, b). */
+static inline void map_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t t = ll + (hl << 32), lo = t + (lh << 32);
+    uint64_t c = (t < ll) + (lo < t);
+    *a = lo;
+    *b = hh + (hl >> 32) + (lh >> 32) + c;
+#endif
+}
+
+/* Multiply two 64 bits integers and fold the 128 bits product. */
+static inline uint64_t map_mix(uint64_t a, uint64_t b) {
+    map_mum(&a, &b);
+    return a ^ b;
+}
+
+/* Read 8, 4 or up to 3 bytes as an integer. */
+static inline uint64_t map_r8(uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t map_r4(uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t map_r3(uint8_t *p, size_t k) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+/* Default hash function, wyhash by Wang Yi, which reads the key a word at
+ * a time and mixes by 64x64 bits multiplications. */
+uint64_t map_hash(char *key, size_t len, uint64_t seed) {
+    static const uint64_t s[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                  0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+    uint8_t *p = (uint8_t *)key;
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t k = (len >> 3) << 2;
+            a = (map_r4(p) << 32) | map_r4(p + k);
+            b = (map_r4(p + len - 4) << 32) | map_r4(p + len - 4 - k);
+        } else if (len > 0) {
+            a = map_r3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = map_mix(map_r8(p) ^ s[1], map_r8(p + 8) ^ seed);
+                seed1 = map_mix(map_r8(p + 16) ^ s[2], map_r8(p + 24) ^ seed1);
+                seed2 = map_mix(map_r8(p + 32) ^ s[3], map_r8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+
+        for (; i > 16; i -= 16, p += 16)
+            seed = map_mix(map_r8(p) ^ s[1], map_r8(p + 8) ^ seed);
+
+        a = map_r8(p + i - 16);
+        b = map_r8(p + i - 8);
     }
-    switch (len) {
-        case 7:
-            hash = ((hash << 5) + hash) + *key++;
-        case 6:
-            hash = ((hash << 5) + hash) + *key++;
-        case 5:
-            hash = ((hash << 5) + hash) + *key++;
-        case 4:
-            hash = ((hash << 5) + hash) + *key++;
-        case 3:
-            hash = ((hash << 5) + hash) + *key++;
-        case 2:
-            hash = ((hash << 5) + hash) + *key++;
-        case 1:
-            hash = ((hash << 5) + hash) + *key++;
-            break;
-        case 0:
-            break;
+    a ^= s[1];
+    b ^= seed;
+    map_mum(&a, &b);
+    return map_mix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+/* Get a random hash seed for a new map, the randomness comes from
+ * /dev/urandom once, then the seeds are derived by splitmix64. Safe to
+ * call from many threads: the state is set once by a compare-and-swap and
+ * stepped by an atomic add. */
+uint64_t map_seed(void) {
+    static uint64_t state = 0;
+    uint64_t init = __atomic_load_n(&state, __ATOMIC_RELAXED);
+
+    if (init == 0) {
+        FILE *fp = fopen("/dev/urandom", "rb");
+
+        if (fp == NULL || fread(&init, sizeof(init), 1, fp) != 1)
+            init = (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&state;
+        if (fp != NULL) fclose(fp);
+
+        /* the first thread wins, others go on from its state */
+        uint64_t zero = 0;
+        __atomic_compare_exchange_n(&state, &zero, init | 1, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
     }
-    return hash;
+
+    uint64_t z = __atomic_add_fetch(&state, 0x9e3779b97f4a7c15ull,
+                                    __ATOMIC_RELAXED);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Get the 7 bits hash tag kept in the control byte, the low bits of the
+ * hash are taken by the slot index. */
+static inline uint8_t map_tag(uint64_t hash) { return hash >> 57; }
+
+/* Get the bitmask of the control bytes in a group equal to given byte. */
+static inline unsigned map_group_match(uint8_t *group, uint8_t c) {
+#ifdef __SSE2__
+    __m128i g = _mm_loadu_si128((__m128i *)group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+    unsigned mask = 0;
+    int i;
+    for (i = 0; i < MAP_GROUP_WIDTH; i++)
+        if (group[i] == c) mask |= 1u << i;
+    return mask;
+#endif
+}
+
+/* Set a control byte, the first group is mirrored after the last slot so
+ * that a group can always be loaded in one go. */
+static inline void map_ctrl_set(uint8_t *ctrl, size_t cap, size_t i,
+                                uint8_t c) {
+    ctrl[i] = c;
+    if (i < MAP_GROUP_WIDTH - 1) ctrl[cap + i] = c;
 }
 
 /* If two key equals. */
@@ -52,21 +162,67 @@ int map_keycmp(char *key1, size_t len1, char *key2, size_t len2) {
 }
 
 /* Create a map. */
-struct map *map_new(void) {
+struct map *map_new(void) { return map_new_hash(NULL); }
+
+/* Create a map with a hash function, NULL for the default `map_hash`. Each
+ * map hashes with its own random seed. */
+struct map *map_new_hash(map_hash_t hash) {
     struct map *m = malloc(sizeof(struct map));
 
     if (m != NULL) {
         m->cap = 0;
         m->len = 0;
         m->table = NULL;
+        m->ctrl = NULL;
+        m->hash = hash != NULL ? hash : &map_hash;
+        m->seed = map_seed();
+        m->own = 0;
+        memset(&m->keys, 0, sizeof(m->keys));
+        m->counting = 0;
+        m->lookups = 0;
+        m->probes = 0;
+        m->huge = 0;
+        m->shrink = MAP_SHRINK_LIMIT;
     }
     return m;
 }
 
+/* Create a map owning its keys: keys are copied into an arena of the map
+ * on set, and freed on pop or along with the map. */
+struct map *map_new_owned(void) {
+    struct map *m = map_new_hash(NULL);
+
+    if (m != NULL) m->own = 1;
+    return m;
+}
+
+/* Create a map with its table backed by huge pages if possible, see
+ * `alloc_huge`. For large maps probed at random. */
+struct map *map_new_huge(void) {
+    struct map *m = map_new_hash(NULL);
+
+    if (m != NULL) m->huge = 1;
+    return m;
+}
+
+/* Get the size of a table of given cap, control bytes follow the nodes. */
+static inline size_t map_table_size(size_t cap) {
+    return cap * sizeof(struct map_node) + cap + MAP_GROUP_WIDTH - 1;
+}
+
+/* Free the table of map. */
+static void map_table_free(struct map *m) {
+    if (m->huge)
+        alloc_huge_free(m->table, map_table_size(m->cap));
+    else
+        free(m->table);
+}
+
 /* Free map. */
 void map_free(struct map *m) {
     if (m != NULL) {
-        if (m->table != NULL) free(m->table);
+        map_table_free(m);
+        map_keys_clear(&m->keys);
         free(m);
     }
 }
@@ -74,51 +230,212 @@ void map_free(struct map *m) {
 /* Clear map. */
 void map_clear(struct map *m) {
     assert(m != NULL);
-    if (m->table != NULL) free(m->table);
+    map_table_free(m);
+    map_keys_clear(&m->keys);
     m->cap = 0;
     m->len = 0;
     m->table = NULL;
+    m->ctrl = NULL;
 }
 
-/* Resize and rehash map. */
-int map_resize(struct map *m) {
-    assert(m != NULL);
+/* Get the block of a key in the arena: blocks are aligned to their base
+ * size and every key starts within the first MAP_KEYS_BLOCK bytes of its
+ * block, larger blocks hold a single key. */
+static inline struct map_keys_block *map_keys_block(char *key) {
+    return (struct map_keys_block *)((uintptr_t)key &
+                                     ~(uintptr_t)(MAP_KEYS_BLOCK - 1));
+}
 
-    /* double sized cap */
-    size_t cap = m->cap * 2;
+/* Unlink a block from the arena and free it. */
+static void map_keys_block_free(struct map_keys *keys,
+                                struct map_keys_block *block) {
+    if (block->prev != NULL)
+        block->prev->next = block->next;
+    else
+        keys->blocks = block->next;
 
-    /* validate new cap */
-    if (cap < 1) cap = MAP_CAP_INIT;
+    if (block->next != NULL) block->next->prev = block->prev;
 
-    if (cap > MAP_CAP_MAX) return MAP_ENOMEM;
+    keys->len -= block->used;
+    keys->cap -= block->size;
+    free(block);
+}
 
-    /* create new table */
-    struct map_node *table = malloc(cap * sizeof(struct map_node));
+/* Copy a key into an arena, NULL-terminated, NULL on no memory. The copy
+ * goes to the free space of the current block, or a new block, the keys
+ * already in the arena never move. */
+char *map_keys_put(struct map_keys *keys, char *key, size_t len) {
+    assert(keys != NULL);
+
+    struct map_keys_block *block = keys->blocks;
+    size_t head = sizeof(struct map_keys_block);
+
+    if (block == NULL || head + block->used + len + 1 > block->size) {
+        size_t size = MAP_KEYS_BLOCK;
+        void *mem;
+
+        if (head + len + 1 > size) size = head + len + 1;
+
+        if (posix_memalign(&mem, MAP_KEYS_BLOCK, size) != 0) return NULL;
+
+        struct map_keys_block *b = mem;
+        b->size = size;
+        b->used = 0;
+        b->live = 0;
+        b->prev = NULL;
+
+        /* a large key takes a block of its own behind the current one,
+         * which keeps filling */
+        if (size > MAP_KEYS_BLOCK && block != NULL) {
+            b->prev = block;
+            b->next = block->next;
+            if (block->next != NULL) block->next->prev = b;
+            block->next = b;
+        } else {
+            b->next = block;
+            if (block != NULL) block->prev = b;
+            keys->blocks = b;
+        }
+        keys->cap += size;
+        block = b;
+    }
 
-    if (table == NULL) return MAP_ENOMEM;
+    char *copy = block->data + block->used;
+    memcpy(copy, key, len);
+    copy[len] = 0;
+    block->used += len + 1;
+    block->live += len + 1;
+    keys->len += len + 1;
+    keys->live += len + 1;
+    return copy;
+}
 
-    /* init all keys to NULL */
-    int i;
-    for (i = 0; i < cap; i++) table[i].key = NULL;
+/* Drop a key copied by `map_keys_put`, it's no longer in use. The block is
+ * freed once it has no keys in use, the current block is reused. */
+void map_keys_drop(struct map_keys *keys, char *key, size_t len) {
+    assert(keys != NULL && key != NULL);
 
-    /* rehash old into new table */
-    int mask = cap - 1;
-    for (i = 0; i < m->cap; i++) {
-        struct map_node *node = &m->table[i];
+    struct map_keys_block *block = map_keys_block(key);
 
-        if (node->key == NULL) continue;
+    block->live -= len + 1;
+    keys->live -= len + 1;
 
-        int j = map_hash(node->key, node->len) & mask;
-        for (;; j = (j + 1) & mask) {
-            if (table[j].key != NULL) continue;
-            table[j].key = node->key;
-            table[j].len = node->len;
-            table[j].val = node->val;
-            break;
+    if (block->live > 0) return;
+
+    if (block == keys->blocks && block->size == MAP_KEYS_BLOCK) {
+        keys->len -= block->used;
+        block->used = 0;
+    } else {
+        map_keys_block_free(keys, block);
+    }
+}
+
+/* Free all blocks of an arena. */
+void map_keys_clear(struct map_keys *keys) {
+    assert(keys != NULL);
+
+    while (keys->blocks != NULL) map_keys_block_free(keys, keys->blocks);
+}
+
+/* Pack a key into arena `to` if its block in `keys` has popped keys, so
+ * that the block is freed once its keys are all packed. Returns the key
+ * to use from now on, NULL on no memory (the key stays where it was). */
+char *map_keys_pack(struct map_keys *keys, struct map_keys *to, char *key,
+                    size_t len) {
+    struct map_keys_block *block = map_keys_block(key);
+
+    if (block->live == block->used) return key;
+
+    char *copy = map_keys_put(to, key, len);
+
+    if (copy != NULL) map_keys_drop(keys, key, len);
+    return copy;
+}
+
+/* Move all blocks of arena `from` to the front of arena `keys`, the first
+ * one of `from` becomes the block to fill. */
+void map_keys_merge(struct map_keys *keys, struct map_keys *from) {
+    assert(keys != NULL && from != NULL);
+
+    if (from->blocks == NULL) return;
+
+    /* an emptied block kept for reuse is of no use behind */
+    if (keys->blocks != NULL && keys->blocks->live == 0)
+        map_keys_block_free(keys, keys->blocks);
+
+    struct map_keys_block *tail = from->blocks;
+
+    while (tail->next != NULL) tail = tail->next;
+
+    tail->next = keys->blocks;
+    if (keys->blocks != NULL) keys->blocks->prev = tail;
+    keys->blocks = from->blocks;
+    keys->len += from->len;
+    keys->live += from->live;
+    keys->cap += from->cap;
+    memset(from, 0, sizeof(*from));
+}
+
+/* Put a node into table by robin hood hashing, the node's key must not be
+ * in the table. Walking from the home slot, the node steals the slot of any
+ * node that is closer to its own home, and the evicted one goes on. Returns
+ * the slot where the given node is put. */
+static struct map_node *map_table_put(struct map_node *table, uint8_t *ctrl,
+                                      size_t cap, struct map_node node,
+                                      uint8_t tag) {
+    size_t mask = cap - 1;
+    size_t i = node.hash & mask;
+    struct map_node *put = NULL;
+
+    for (node.dist = 0;; i = (i + 1) & mask, node.dist++) {
+        struct map_node *slot = &table[i];
+
+        if (ctrl[i] == MAP_CTRL_EMPTY) {
+            *slot = node;
+            map_ctrl_set(ctrl, cap, i, tag);
+            return put != NULL ? put : slot;
+        }
+
+        if (slot->dist < node.dist) {
+            struct map_node tmp = *slot;
+            uint8_t tmp_tag = ctrl[i];
+            *slot = node;
+            map_ctrl_set(ctrl, cap, i, tag);
+            node = tmp;
+            tag = tmp_tag;
+            if (put == NULL) put = slot;
         }
     }
-    free(m->table);
+}
+
+/* Resize and rehash map to given cap, must be 2**. */
+int map_resize(struct map *m, size_t cap) {
+    assert(m != NULL);
+    assert(m->len <= cap * MAP_LOAD_LIMIT);
+
+    /* validate new cap */
+    if (cap < MAP_CAP_INIT) cap = MAP_CAP_INIT;
+
+    if (cap > MAP_CAP_MAX) return MAP_ENOMEM;
+
+    /* create new table, control bytes follow the nodes */
+    struct map_node *table = m->huge ? alloc_huge(map_table_size(cap))
+                                     : malloc(map_table_size(cap));
+
+    if (table == NULL) return MAP_ENOMEM;
+
+    /* init all slots to empty */
+    uint8_t *ctrl = (uint8_t *)(table + cap);
+    memset(ctrl, MAP_CTRL_EMPTY, cap + MAP_GROUP_WIDTH - 1);
+
+    /* move old into new table, by the cached hashes */
+    size_t i;
+    for (i = 0; i < m->cap; i++)
+        if (m->ctrl[i] != MAP_CTRL_EMPTY)
+            map_table_put(table, ctrl, cap, m->table[i], m->ctrl[i]);
+    map_table_free(m);
     m->table = table;
+    m->ctrl = ctrl;
     m->cap = cap;
     return MAP_OK;
 }
@@ -135,50 +452,109 @@ size_t map_cap(struct map *m) {
     return m->cap;
 }
 
-/* Set a key into map. */
-int map_iset(struct map *m, char *key, size_t len, void *val) {
+/* Get map node by key and its hash. Probing a group of control bytes at a
+ * time, only the nodes with matching tags are compared, and since no
+ * tombstones are left by pops, it's done once an empty slot is met. */
+static struct map_node *map_find(struct map *m, char *key, size_t len,
+                                 uint64_t hash) {
+    if (m->table == NULL) return NULL;
+
+    size_t mask = m->cap - 1;
+    uint8_t tag = map_tag(hash);
+    size_t i = hash & mask;
+    uint64_t probes = 1;
+    struct map_node *node;
+
+    for (;; i = (i + MAP_GROUP_WIDTH) & mask, probes++) {
+        uint8_t *group = &m->ctrl[i];
+        unsigned empty = map_group_match(group, MAP_CTRL_EMPTY);
+        unsigned match = map_group_match(group, tag);
+
+        /* only the slots before the first empty one */
+        if (empty) match &= (empty & -empty) - 1;
+
+        for (; match; match &= match - 1) {
+            size_t j = (i + __builtin_ctz(match)) & mask;
+            node = &m->table[j];
+            if (node->hash == (uint32_t)hash &&
+                map_keycmp(node->key, node->len, key, len))
+                goto end;
+        }
+
+        if (empty) {
+            node = NULL;
+            goto end;
+        }
+    }
+end:
+    if (m->counting) {
+        m->lookups++;
+        m->probes += probes;
+    }
+    return node;
+}
+
+/* Get map node by key. */
+struct map_node *map_get_node(struct map *m, char *key, size_t len) {
+    return map_find(m, key, len, (m->hash)(key, len, m->seed));
+}
+
+/* Get the val slot of a key in map, the key is set with NULL val if not
+ * found, e.g. to count keys:
+ *
+ *   void **val = map_ientry(m, key, len, NULL);
+ *   if (val != NULL) *val = (void *)((intptr_t)*val + 1);
+ *
+ * The key is hashed and probed once. If `inserted` is not NULL, it's set to
+ * 1 if the key is new and inserted else 0. The slot is valid until the
+ * next set or pop. Returns NULL on no memory. */
+void **map_ientry(struct map *m, char *key, size_t len, int *inserted) {
     assert(m != NULL);
     assert(key != NULL);
 
+    if (inserted != NULL) *inserted = 0;
+
     /* if require resize */
     if ((m->cap * MAP_LOAD_LIMIT < m->len || m->cap < MAP_CAP_INIT) &&
-        map_resize(m) != MAP_OK)
-        return MAP_ENOMEM;
+        map_resize(m, m->cap * 2) != MAP_OK)
+        return NULL;
 
     /* try to find this key */
-    int mask = m->cap - 1;
-    size_t i = map_hash(key, len) & mask;
+    uint64_t hash = (m->hash)(key, len, m->seed);
+    struct map_node *node = map_find(m, key, len, hash);
 
-    for (;; i = (i + 1) & mask) {
-        struct map_node *node = &m->table[i];
-        if (node->key == NULL) {
-            node->key = key;
-            node->len = len;
-            node->val = val;
-            m->len++;
-            return MAP_OK;
-        }
-        if (map_keycmp(node->key, node->len, key, len)) {
-            node->val = val;
-            return MAP_OK;
-        }
+    if (node == NULL) {
+        if (m->own && (key = map_keys_put(&m->keys, key, len)) == NULL)
+            return NULL;
+
+        struct map_node new_node = {key, len, NULL, hash, 0};
+        node = map_table_put(m->table, m->ctrl, m->cap, new_node,
+                             map_tag(hash));
+        m->len++;
+
+        if (inserted != NULL) *inserted = 1;
     }
+    return &node->val;
 }
 
-/* Set a NULL-terminated key into map. */
-int map_set(struct map *m, char *key, void *val) {
-    return map_iset(m, key, strlen(key), val);
+/* Get the val slot of a NULL-terminated key in map. */
+void **map_entry(struct map *m, char *key, int *inserted) {
+    return map_ientry(m, key, strlen(key), inserted);
 }
 
-/* Get map node by key. */
-struct map_node *map_get_node(struct map *m, char *key, size_t len) {
-    int mask = m->cap - 1;
-    size_t i = map_hash(key, len) & mask;
-    struct map_node *node = &m->table[i];
+/* Set a key into map. */
+int map_iset(struct map *m, char *key, size_t len, void *val) {
+    void **slot = map_ientry(m, key, len, NULL);
 
-    for (; node->key != NULL; i = (i + 1) & mask, node = &m->table[i])
-        if (map_keycmp(node->key, node->len, key, len)) return node;
-    return NULL;
+    if (slot == NULL) return MAP_ENOMEM;
+
+    *slot = val;
+    return MAP_OK;
+}
+
+/* Set a NULL-terminated key into map. */
+int map_set(struct map *m, char *key, void *val) {
+    return map_iset(m, key, strlen(key), val);
 }
 
 /* Get val by key from map, NULL on not found. */
@@ -196,6 +572,41 @@ void *map_get(struct map *m, char *key) {
     return map_iget(m, key, strlen(key));
 }
 
+/* Get vals of n keys from map into `vals`, NULL on not found. Every
+ * `MAP_BATCH_UNIT` keys are hashed and their home slots prefetched before
+ * any of them is probed, so that the cache misses of big tables overlap.
+ * Returns the number of keys found. */
+size_t map_iget_many(struct map *m, char **keys, size_t *lens, size_t n,
+                     void **vals) {
+    assert(m != NULL);
+    assert(n == 0 || (keys != NULL && lens != NULL && vals != NULL));
+
+    size_t i, k, found = 0;
+    uint64_t hashes[MAP_BATCH_UNIT];
+
+    for (i = 0; i < n; i += MAP_BATCH_UNIT) {
+        size_t batch = n - i < MAP_BATCH_UNIT ? n - i : MAP_BATCH_UNIT;
+
+        for (k = 0; k < batch; k++) {
+            hashes[k] = (m->hash)(keys[i + k], lens[i + k], m->seed);
+
+            if (m->table != NULL) {
+                size_t home = hashes[k] & (m->cap - 1);
+                __builtin_prefetch(&m->ctrl[home]);
+                __builtin_prefetch(&m->table[home]);
+            }
+        }
+
+        for (k = 0; k < batch; k++) {
+            struct map_node *node =
+                map_find(m, keys[i + k], lens[i + k], hashes[k]);
+            vals[i + k] = node != NULL ? node->val : NULL;
+            if (node != NULL) found++;
+        }
+    }
+    return found;
+}
+
 /* Test if a key is in map. */
 int map_ihas(struct map *m, char *key, size_t len) {
     assert(m != NULL);
@@ -208,18 +619,39 @@ int map_ihas(struct map *m, char *key, size_t len) {
 
 /* Test if a key is in map by a NULL-terminated key. */
 int map_has(struct map *m, char *key) { return map_ihas(m, key, strlen(key)); }
-/* Pop a key from map, NULL on not found. */
+/* Pop a key from map, NULL on not found. The following nodes which are
+ * not at their home slots are shifted backward, so that no tombstones are
+ * left in the probe sequences. */
 void *map_ipop(struct map *m, char *key, size_t len) {
     assert(m != NULL);
     assert(key != NULL);
 
     struct map_node *node = map_get_node(m, key, len);
-    if (node != NULL) {
-        node->key = NULL;
-        m->len--;
-        return node->val;
+
+    if (node == NULL) return NULL;
+
+    void *val = node->val;
+    size_t mask = m->cap - 1;
+    size_t i = node - m->table;
+
+    if (m->own) map_keys_drop(&m->keys, node->key, node->len);
+    size_t j = (i + 1) & mask;
+
+    for (; m->ctrl[j] != MAP_CTRL_EMPTY && m->table[j].dist > 0;
+         i = j, j = (j + 1) & mask) {
+        m->table[i] = m->table[j];
+        m->table[i].dist--;
+        map_ctrl_set(m->ctrl, m->cap, i, m->ctrl[j]);
     }
-    return NULL;
+    map_ctrl_set(m->ctrl, m->cap, i, MAP_CTRL_EMPTY);
+    m->len--;
+
+    /* halve the table once it is light enough, the shrink limit is well
+     * below half the load limit so it does not grow back soon; keeps the
+     * bigger table on no memory */
+    if (m->cap > MAP_CAP_INIT && m->len < m->cap * m->shrink)
+        map_resize(m, m->cap / 2);
+    return val;
 }
 
 /* Pop a key from map by NULL-terminated key, NULL on not found. */
@@ -227,6 +659,55 @@ void *map_pop(struct map *m, char *key) {
     return map_ipop(m, key, strlen(key));
 }
 
+/* Shrink map to the smallest table that holds its nodes under the load
+ * limit, the table is freed if the map is empty. */
+int map_shrink_to_fit(struct map *m) {
+    assert(m != NULL);
+
+    if (m->len == 0) {
+        map_clear(m);
+        return MAP_OK;
+    }
+
+    size_t cap = MAP_CAP_INIT;
+
+    while (cap * MAP_LOAD_LIMIT < m->len) cap *= 2;
+
+    if (cap < m->cap && map_resize(m, cap) != MAP_OK) return MAP_ENOMEM;
+
+    if (!m->own || m->keys.live == m->keys.len) return MAP_OK;
+
+    /* pack the keys out of blocks with popped keys into new blocks, the
+     * keys packed so far are kept on no memory */
+    struct map_keys keys = {NULL, 0, 0, 0};
+    size_t i;
+    int err = MAP_OK;
+
+    for (i = 0; i < m->cap && err == MAP_OK; i++) {
+        if (m->ctrl[i] == MAP_CTRL_EMPTY) continue;
+
+        struct map_node *node = &m->table[i];
+        char *key = map_keys_pack(&m->keys, &keys, node->key, node->len);
+
+        if (key == NULL)
+            err = MAP_ENOMEM;
+        else
+            node->key = key;
+    }
+    map_keys_merge(&m->keys, &keys);
+    return err;
+}
+
+/* Set the load factor under which the map shrinks on pop, MAP_SHRINK_LIMIT
+ * by default, 0 to never shrink (e.g. for maps emptied and refilled in
+ * cycles). It must be under half the load limit, so that a shrunk map does
+ * not grow back at once. */
+void map_set_shrink_limit(struct map *m, double limit) {
+    assert(m != NULL);
+    assert(limit >= 0 && limit < MAP_LOAD_LIMIT / 2);
+    m->shrink = limit;
+}
+
 /* Create map iter. */
 struct map_iter *map_iter_new(struct map *m) {
     assert(m != NULL);
@@ -244,7 +725,9 @@ void map_iter_free(struct map_iter *iter) {
     if (iter != NULL) free(iter);
 }
 
-/* Get next. */
+/* Get next. Popping keys while iterating may shift unvisited nodes
+ * backward into visited slots or shrink the map, so they would be
+ * missed. */
 struct map_node *map_iter_next(struct map_iter *iter) {
     assert(iter != NULL && iter->m != NULL);
 
@@ -253,11 +736,7 @@ struct map_node *map_iter_next(struct map_iter *iter) {
     if (m->table == NULL) return NULL;
 
     for (; iter->i < m->cap; iter->i++) {
-        struct map_node *node = &m->table[iter->i];
-        if (node->key != NULL) {
-            iter->i++;
-            return node;
-        }
+        if (m->ctrl[iter->i] != MAP_CTRL_EMPTY) return &m->table[iter->i++];
     }
     return NULL;
 }
@@ -267,3 +746,109 @@ void map_iter_rewind(struct map_iter *iter) {
     assert(iter != NULL);
     iter->i = 0;
 }
+
+/* Reverse the bits of a cursor. */
+static size_t map_rev(size_t v) {
+    size_t s = 8 * sizeof(v), mask = ~(size_t)0;
+
+    while ((s >>= 1) > 0) {
+        mask ^= (mask << s);
+        v = ((v >> s) & mask) | ((v << s) & ~mask);
+    }
+    return v;
+}
+
+/* Scan map incrementally, e.g.
+ *
+ *   size_t cursor = 0;
+ *   do {
+ *       cursor = map_scan(m, cursor, 100, fn, data);
+ *   } while (cursor != 0);
+ *
+ * Each call visits about `count` home slots from the cursor and calls `fn`
+ * on the nodes hashed to them, returns the cursor to continue with, 0 on
+ * end. The cursor is increased on its reversed bits (as redis SCAN does),
+ * so that a node present for the whole scan is visited at least once even
+ * if the map resizes between calls. `fn` must not set or pop on the map. */
+size_t map_scan(struct map *m, size_t cursor, size_t count, map_scan_t fn,
+                void *data) {
+    assert(m != NULL);
+
+    if (m->table == NULL) return 0;
+    if (count == 0) count = 1;
+
+    size_t mask = m->cap - 1;
+
+    do {
+        size_t v = cursor & mask;
+        size_t j = v;
+
+        /* nodes of home v are together in the run from slot v, after the
+         * ones of earlier homes and before the ones of later homes */
+        for (; m->ctrl[j] != MAP_CTRL_EMPTY; j = (j + 1) & mask) {
+            size_t dist = m->table[j].dist;
+            size_t off = (j - v) & mask;
+
+            if (dist < off) break;
+            if (dist == off) (fn)(&m->table[j], data);
+        }
+
+        cursor |= ~mask;
+        cursor = map_rev(map_rev(cursor) + 1);
+    } while (cursor != 0 && --count > 0);
+    return cursor;
+}
+
+/* Get the stats of map, to tell e.g. bad hash distributions by the probe
+ * distances. The lookup counters are set if counting. */
+void map_stats(struct map *m, struct map_stats *stats) {
+    assert(m != NULL);
+    assert(stats != NULL);
+
+    memset(stats, 0, sizeof(struct map_stats));
+    stats->cap = m->cap;
+    stats->len = m->len;
+    stats->bytes = sizeof(struct map) + m->keys.cap;
+
+    if (m->table == NULL) return;
+
+    stats->load = (double)m->len / m->cap;
+    stats->bytes += map_table_size(m->cap);
+
+    size_t i, run = 0, head = 0, dists = 0;
+
+    for (i = 0; i < m->cap; i++) {
+        if (m->ctrl[i] == MAP_CTRL_EMPTY) {
+            /* the run at the table start continues the last one */
+            if (run == i) head = run;
+            run = 0;
+            continue;
+        }
+
+        size_t dist = m->table[i].dist;
+        stats->dists[dist < MAP_STATS_BINS ? dist : MAP_STATS_BINS - 1]++;
+        dists += dist;
+
+        if (dist > stats->dist_max) stats->dist_max = dist;
+
+        if (++run > stats->cluster_max) stats->cluster_max = run;
+    }
+
+    if (run < m->cap && run + head > stats->cluster_max)
+        stats->cluster_max = run + head;
+
+    if (m->len > 0) stats->dist_avg = (double)dists / m->len;
+
+    stats->lookups = m->lookups;
+
+    if (m->lookups > 0) stats->probes_avg = (double)m->probes / m->lookups;
+}
+
+/* Turn on or off the counting of lookups for `map_stats`, which costs a
+ * branch and two adds per lookup. The counters are reset. */
+void map_stats_counting(struct map *m, int on) {
+    assert(m != NULL);
+    m->counting = on;
+    m->lookups = 0;
+    m->probes = 0;
+}
@@ -1,8 +1,28 @@
 /**
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
- * Dynamic sized simple open-addressing hashtable implementation.
- * deps: None
+ * Dynamic sized open-addressing hashtable implementation, using robin hood
+ * hashing with backward shift deletion. Each slot has a control byte kept
+ * in a separate array, lookups compare a group of them at once (with SSE2
+ * if available) and only visit the nodes whose hash tags match.
+ *
+ * `MAP_DEFINE(name, K, V, hash, eq)` defines a typed map `struct name`
+ * storing keys of type K and vals of type V inline, with static inline
+ * functions `name_new`, `name_set`, `name_get` etc., where `hash(key)` and
+ * `eq(a, b)` are inlined. `name_new_alloc` takes an allocator for the map
+ * and its table. The hash is spread by fibonacci hashing, slots
+ * are probed linearly with backward shift deletion, e.g.
+ *
+ *   #define fd_hash(fd) ((uint64_t)(fd))
+ *   #define fd_eq(a, b) ((a) == (b))
+ *   MAP_DEFINE(conns, int, struct conn *, fd_hash, fd_eq)
+ *
+ * Owned keys (`map_new_owned`) are copied into an arena of blocks aligned
+ * to MAP_KEYS_BLOCK: a key never moves once copied, and a block is freed
+ * once its last key is popped. The `map_keys_*` functions are shared with
+ * dict.
+ *
+ * deps: alloc.c
  */
 
 #ifndef __MAP_H__
@@ -11,33 +31,86 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "alloc.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
 #define MAP_LOAD_LIMIT 0.72            /* load factor */
+#define MAP_SHRINK_LIMIT 0.18          /* default shrink load factor */
 #define MAP_CAP_MAX 1024 * 1024 * 1024 /* 1GB */
 #define MAP_CAP_INIT 16                /* init table size: must be 2** */
+#define MAP_GROUP_WIDTH 16             /* control bytes probed at once */
+#define MAP_CTRL_EMPTY 0x80            /* control byte of an empty slot */
+#define MAP_BATCH_UNIT 16              /* keys prefetched at once */
+#define MAP_KEYS_BLOCK 4096            /* key arena block size: 2** */
+#define MAP_STATS_BINS 16              /* probe distance histogram size */
 
 #define map() map_new()
 #define map_iter(m) map_iter_new(m)
 #define map_each(iter, node) while (((node) = map_iter_next((iter))) != NULL)
 
+/* key hash function type, the seed is random per map. */
+typedef uint64_t (*map_hash_t)(char *key, size_t len, uint64_t seed);
+
 enum {
     MAP_OK = 0,     /* operation is ok */
     MAP_ENOMEM = 1, /* no memory error */
 };
 
 struct map_node {
-    char *key;  /* key string */
-    size_t len; /* key length */
-    void *val;  /* value data*/
+    char *key;     /* key string */
+    size_t len;    /* key length */
+    void *val;     /* value data*/
+    uint32_t hash; /* cached key hash, the low 32 bits */
+    uint32_t dist; /* probe distance from the home slot */
+};
+
+struct map_keys_block {
+    struct map_keys_block *prev; /* previous (newer) block */
+    struct map_keys_block *next; /* next (older) block */
+    size_t size;                 /* block size, header included */
+    size_t used;                 /* used size of data */
+    size_t live;                 /* size of the keys still in use */
+    char data[];                 /* NULL-terminated keys in a row */
+};
+
+struct map_keys {
+    struct map_keys_block *blocks; /* blocks, the current first */
+    size_t len;                    /* used size of all blocks */
+    size_t live;                   /* size of the keys still in use */
+    size_t cap;                    /* size of all blocks */
 };
 
 struct map {
     size_t cap;             /* map capacity */
     size_t len;             /* map length */
     struct map_node *table; /* node table */
+    uint8_t *ctrl;          /* control bytes, hash tag or MAP_CTRL_EMPTY */
+    map_hash_t hash;        /* key hash function */
+    uint64_t seed;          /* key hash seed */
+    int own;                /* if keys are copied into the key arena */
+    struct map_keys keys;   /* key arena */
+    int counting;           /* if lookups are counted */
+    uint64_t lookups;       /* lookups counted */
+    uint64_t probes;        /* groups probed by the lookups counted */
+    int huge;               /* if the table is from `alloc_huge` */
+    double shrink;          /* load factor to shrink under, 0 for never */
+};
+
+struct map_stats {
+    size_t cap;                   /* map capacity */
+    size_t len;                   /* map length */
+    double load;                  /* load factor, len / cap */
+    size_t dists[MAP_STATS_BINS]; /* nodes by probe distance, the last bin
+                                   * for the larger */
+    size_t dist_max;              /* max probe distance */
+    double dist_avg;              /* average probe distance */
+    size_t cluster_max;           /* longest run of used slots */
+    size_t bytes;                 /* memory used by map */
+    uint64_t lookups;             /* lookups counted */
+    double probes_avg;            /* average groups probed per lookup */
 };
 
 struct map_iter {
@@ -45,7 +118,13 @@ struct map_iter {
     size_t i;      /* current table index */
 };
 
+/* scan callback type, called with each node and the user data. */
+typedef void (*map_scan_t)(struct map_node *node, void *data);
+
 struct map *map_new(void);
+struct map *map_new_hash(map_hash_t hash);
+struct map *map_new_owned(void);
+struct map *map_new_huge(void);
 void map_free(struct map *m);
 void map_clear(struct map *m);                                 /* O(1) */
 size_t map_len(struct map *m);                                 /* O(1) */
@@ -62,6 +141,200 @@ struct map_iter *map_iter_new(struct map *m);
 void map_iter_free(struct map_iter *iter);
 struct map_node *map_iter_next(struct map_iter *iter);
 void map_iter_rewind(struct map_iter *iter);
+uint64_t map_hash(char *key, size_t len, uint64_t seed); /* O(N) */
+uint64_t map_seed(void);
+size_t map_scan(struct map *m, size_t cursor, size_t count, map_scan_t fn,
+                void *data);
+int map_shrink_to_fit(struct map *m); /* O(N) */
+void map_set_shrink_limit(struct map *m, double limit);
+void **map_entry(struct map *m, char *key, int *inserted); /* O(1) */
+void **map_ientry(struct map *m, char *key, size_t len,
+                  int *inserted); /* O(1) */
+size_t map_iget_many(struct map *m, char **keys, size_t *lens, size_t n,
+                     void **vals); /* O(n) */
+void map_stats(struct map *m, struct map_stats *stats); /* O(N) */
+void map_stats_counting(struct map *m, int on);         /* O(1) */
+char *map_keys_put(struct map_keys *keys, char *key, size_t len); /* O(1) */
+void map_keys_drop(struct map_keys *keys, char *key, size_t len); /* O(1) */
+void map_keys_clear(struct map_keys *keys);
+char *map_keys_pack(struct map_keys *keys, struct map_keys *to, char *key,
+                    size_t len);
+void map_keys_merge(struct map_keys *keys, struct map_keys *from);
+
+#define MAP_DEFINE(name, K, V, hash, eq)                                    \
+    struct name##_node {                                                    \
+        K key; /* key */                                                    \
+        V val; /* value */                                                  \
+    };                                                                      \
+                                                                            \
+    struct name {                                                           \
+        size_t cap;                /* map capacity */                       \
+        size_t len;                /* map length */                         \
+        unsigned shift;            /* 64 - log2(cap) */                     \
+        struct name##_node *table; /* node table */                         \
+        uint8_t *used;             /* if slots are used */                  \
+        struct alloc *alloc;       /* allocator of map and table */         \
+    };                                                                      \
+                                                                            \
+    struct name##_iter {                                                    \
+        struct name *m; /* map to iterate */                                \
+        size_t i;       /* current table index */                           \
+    };                                                                      \
+                                                                            \
+    /* Create an empty map with an allocator for the map and its table,     \
+     * NULL for the default. */                                             \
+    static inline struct name *name##_new_alloc(struct alloc *a) {          \
+        if (a == NULL) a = alloc_default();                                 \
+                                                                            \
+        struct name *m = alloc_malloc(a, sizeof(struct name));              \
+                                                                            \
+        if (m != NULL) {                                                    \
+            m->cap = 0;                                                     \
+            m->len = 0;                                                     \
+            m->shift = 64;                                                  \
+            m->table = NULL;                                                \
+            m->used = NULL;                                                 \
+            m->alloc = a;                                                   \
+        }                                                                   \
+        return m;                                                           \
+    }                                                                       \
+                                                                            \
+    /* Create an empty map. */                                              \
+    static inline struct name *name##_new(void) {                           \
+        return name##_new_alloc(NULL);                                      \
+    }                                                                       \
+                                                                            \
+    /* Get the table size of given cap, used flags follow the nodes. */     \
+    static inline size_t name##_table_size(size_t cap) {                    \
+        return cap * (sizeof(struct name##_node) + 1);                      \
+    }                                                                       \
+                                                                            \
+    /* Free map. */                                                         \
+    static inline void name##_free(struct name *m) {                        \
+        if (m != NULL) {                                                    \
+            alloc_free(m->alloc, m->table, name##_table_size(m->cap));      \
+            alloc_free(m->alloc, m, sizeof(struct name));                   \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    /* Clear map. */                                                        \
+    static inline void name##_clear(struct name *m) {                       \
+        alloc_free(m->alloc, m->table, name##_table_size(m->cap));          \
+        m->cap = 0;                                                         \
+        m->len = 0;                                                         \
+        m->table = NULL;                                                    \
+        m->used = NULL;                                                     \
+    }                                                                       \
+                                                                            \
+    /* Get map length. */                                                   \
+    static inline size_t name##_len(struct name *m) { return m->len; }      \
+                                                                            \
+    /* Get map capacity. */                                                 \
+    static inline size_t name##_cap(struct name *m) { return m->cap; }      \
+                                                                            \
+    /* Get the home slot of a key. */                                       \
+    static inline size_t name##_home(struct name *m, K key) {               \
+        return ((uint64_t)(hash(key)) * 0x9e3779b97f4a7c15ULL) >> m->shift; \
+    }                                                                       \
+                                                                            \
+    /* Get the slot of a key, or the empty slot ending its probe. */        \
+    static inline size_t name##_slot(struct name *m, K key) {               \
+        size_t mask = m->cap - 1, i = name##_home(m, key);                  \
+                                                                            \
+        while (m->used[i] && !(eq(m->table[i].key, key)))                   \
+            i = (i + 1) & mask;                                             \
+        return i;                                                           \
+    }                                                                       \
+                                                                            \
+    /* Resize and rehash map to given cap, must be 2**. */                  \
+    static inline int name##_resize(struct name *m, size_t cap) {           \
+        struct name##_node *table =                                         \
+            alloc_malloc(m->alloc, name##_table_size(cap));                 \
+                                                                            \
+        if (table == NULL) return MAP_ENOMEM;                               \
+                                                                            \
+        struct name old = *m;                                               \
+        size_t i;                                                           \
+                                                                            \
+        m->cap = cap;                                                       \
+        m->table = table;                                                   \
+        m->used = (uint8_t *)(table + cap);                                 \
+        for (m->shift = 64; cap > 1; cap >>= 1) m->shift--;                 \
+                                                                            \
+        for (i = 0; i < m->cap; i++) m->used[i] = 0;                        \
+                                                                            \
+        for (i = 0; i < old.cap; i++) {                                     \
+            if (!old.used[i]) continue;                                     \
+            size_t j = name##_slot(m, old.table[i].key);                    \
+            m->table[j] = old.table[i];                                     \
+            m->used[j] = 1;                                                 \
+        }                                                                   \
+        alloc_free(m->alloc, old.table, name##_table_size(old.cap));        \
+        return MAP_OK;                                                      \
+    }                                                                       \
+                                                                            \
+    /* Set a key into map. */                                               \
+    static inline int name##_set(struct name *m, K key, V val) {            \
+        if (m->cap * MAP_LOAD_LIMIT < m->len + 1 &&                         \
+            name##_resize(m, m->cap > 0 ? m->cap * 2 : MAP_CAP_INIT) !=     \
+                MAP_OK)                                                     \
+            return MAP_ENOMEM;                                              \
+                                                                            \
+        size_t i = name##_slot(m, key);                                     \
+                                                                            \
+        if (!m->used[i]) {                                                  \
+            m->table[i].key = key;                                          \
+            m->used[i] = 1;                                                 \
+            m->len++;                                                       \
+        }                                                                   \
+        m->table[i].val = val;                                              \
+        return MAP_OK;                                                      \
+    }                                                                       \
+                                                                            \
+    /* Get the val of a key, NULL on not found. The pointer is valid until  \
+     * the next set or pop. */                                              \
+    static inline V *name##_get(struct name *m, K key) {                    \
+        if (m->len == 0) return NULL;                                       \
+                                                                            \
+        size_t i = name##_slot(m, key);                                     \
+        return m->used[i] ? &m->table[i].val : NULL;                        \
+    }                                                                       \
+                                                                            \
+    /* Test if a key is in map. */                                          \
+    static inline int name##_has(struct name *m, K key) {                   \
+        return name##_get(m, key) != NULL;                                  \
+    }                                                                       \
+                                                                            \
+    /* Pop a key from map, its val is set to `val` if not NULL. Returns 1   \
+     * on popped, 0 on not found. */                                        \
+    static inline int name##_pop(struct name *m, K key, V *val) {           \
+        if (m->len == 0) return 0;                                          \
+                                                                            \
+        size_t mask = m->cap - 1, i = name##_slot(m, key), j = i;           \
+                                                                            \
+        if (!m->used[i]) return 0;                                          \
+                                                                            \
+        if (val != NULL) *val = m->table[i].val;                            \
+                                                                            \
+        /* shift back the following nodes not at their home slots */        \
+        for (j = (j + 1) & mask; m->used[j]; j = (j + 1) & mask) {          \
+            size_t home = name##_home(m, m->table[j].key);                  \
+            if (((j - home) & mask) < ((j - i) & mask)) continue;           \
+            m->table[i] = m->table[j];                                      \
+            i = j;                                                          \
+        }                                                                   \
+        m->used[i] = 0;                                                     \
+        m->len--;                                                           \
+        return 1;                                                           \
+    }                                                                       \
+                                                                            \
+    /* Get the next node of map iterator, NULL on end. */                   \
+    static inline struct name##_node *name##_iter_next(                     \
+        struct name##_iter *iter) {                                         \
+        for (; iter->i < iter->m->cap; iter->i++)                           \
+            if (iter->m->used[iter->i]) return &iter->m->table[iter->i++];  \
+        return NULL;                                                        \
+    }
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,345 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "map.h"
+#include "mph.h"
+
+/* a bucket exhausted its pilots, the build is retried with another seed */
+#define MPH_ERETRY -1
+/* two keys are the same, the build fails */
+#define MPH_EDUP -2
+
+/* Mix a 64 bits value (splitmix64 finalizer). */
+static inline uint64_t mph_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* Get the bucket of a key hash, by its high 32 bits. */
+static inline uint32_t mph_bucket(struct mph *m, uint64_t hash) {
+    return ((hash >> 32) * m->buckets) >> 32;
+}
+
+/* Get the slot of a key hash displaced by a pilot. */
+static inline uint32_t mph_slot(struct mph *m, uint64_t hash,
+                                uint32_t pilot) {
+    uint64_t x = mph_mix(hash ^ (pilot * 0x9e3779b97f4a7c15ULL));
+    return ((x & 0xffffffff) * m->cap) >> 32;
+}
+
+/* Find a pilot for the keys of a bucket (their hashes), which places
+ * them to distinct free slots, and take the slots. */
+static int mph_place(struct mph *m, uint64_t *taken, uint64_t *hashes,
+                     uint32_t *keys, uint32_t size, uint32_t *slots,
+                     uint16_t *pilot) {
+    uint32_t p, i, j;
+
+    for (p = 0; p <= MPH_PILOT_MAX; p++) {
+        for (i = 0; i < size; i++) {
+            uint32_t s = mph_slot(m, hashes[keys[i]], p);
+
+            if (taken[s / 64] & (1ULL << (s % 64))) break;
+
+            for (j = 0; j < i; j++)
+                if (slots[j] == s) break;
+
+            if (j < i) break;
+            slots[i] = s;
+        }
+
+        if (i == size) {
+            for (i = 0; i < size; i++)
+                taken[slots[i] / 64] |= 1ULL << (slots[i] % 64);
+            *pilot = p;
+            return MPH_OK;
+        }
+    }
+    return MPH_ERETRY;
+}
+
+/* Build the pilots and remap of mph for the key hashes. */
+static int mph_build(struct mph *m, uint64_t *hashes, char **keys,
+                     size_t *lens) {
+    uint32_t n = m->len, nb = m->buckets, i, b, size;
+    uint32_t max = 0;
+    /* keys sorted by bucket, bucket `b` is keys[start[b]:start[b+1]] */
+    uint32_t *start = calloc(nb + 1, sizeof(uint32_t));
+    uint32_t *order = malloc(n * sizeof(uint32_t) + 1);
+    uint64_t *taken = calloc(m->cap / 64 + 1, sizeof(uint64_t));
+    uint32_t *sizes = NULL, *sorted = NULL, *slots = NULL;
+    int err = MPH_ENOMEM;
+
+    if (start == NULL || order == NULL || taken == NULL) goto end;
+
+    for (i = 0; i < n; i++) start[mph_bucket(m, hashes[i]) + 1]++;
+
+    for (b = 0; b < nb; b++) {
+        if (start[b + 1] > max) max = start[b + 1];
+        start[b + 1] += start[b];
+    }
+
+    /* the larger buckets are placed first, while slots are free */
+    sizes = calloc(max + 2, sizeof(uint32_t));
+    sorted = malloc(nb * sizeof(uint32_t));
+    slots = malloc(max * sizeof(uint32_t) + 1);
+
+    if (sizes == NULL || sorted == NULL || slots == NULL) goto end;
+
+    for (i = 0; i < n; i++) order[start[mph_bucket(m, hashes[i])]++] = i;
+
+    for (b = nb; b > 0; b--) start[b] = start[b - 1];
+    start[0] = 0;
+
+    for (b = 0; b < nb; b++) sizes[max - (start[b + 1] - start[b]) + 1]++;
+
+    for (size = 0; size <= max; size++) sizes[size + 1] += sizes[size];
+
+    for (b = 0; b < nb; b++)
+        sorted[sizes[max - (start[b + 1] - start[b])]++] = b;
+
+    for (i = 0; i < nb; i++) {
+        b = sorted[i];
+        size = start[b + 1] - start[b];
+
+        if (size == 0) break;
+
+        err = mph_place(m, taken, hashes, order + start[b], size, slots,
+                        &m->pilots[b]);
+
+        if (err == MPH_OK) continue;
+
+        /* same hashes collide with every pilot, test if the keys are */
+        uint32_t *ks = order + start[b], j, k;
+
+        for (j = 0; j < size; j++) {
+            for (k = j + 1; k < size; k++) {
+                uint32_t x = ks[j], y = ks[k];
+                if (hashes[x] == hashes[y] && lens[x] == lens[y] &&
+                    memcmp(keys[x], keys[y], lens[x]) == 0)
+                    err = MPH_EDUP;
+            }
+        }
+        goto end;
+    }
+
+    for (; i < nb; i++) m->pilots[sorted[i]] = 0;
+
+    /* slots >= len are remapped to the free slots < len, one for each */
+    uint32_t s, next = 0;
+
+    for (s = n; s < m->cap; s++) {
+        m->remap[s - n] = 0;
+
+        if ((taken[s / 64] & (1ULL << (s % 64))) == 0) continue;
+
+        while (taken[next / 64] & (1ULL << (next % 64))) next++;
+        m->remap[s - n] = next++;
+    }
+    err = MPH_OK;
+end:
+    free(start);
+    free(order);
+    free(taken);
+    free(sizes);
+    free(sorted);
+    free(slots);
+    return err;
+}
+
+/* Allocate a mph of given size, with its pilots and remap. */
+static struct mph *mph_alloc(uint32_t len, uint32_t cap, uint32_t buckets) {
+    struct mph *m = malloc(sizeof(struct mph));
+
+    if (m == NULL) return NULL;
+
+    m->len = len;
+    m->cap = cap;
+    m->buckets = buckets;
+    m->pilots = malloc(buckets * sizeof(uint16_t));
+    m->remap = malloc((cap - len) * sizeof(uint32_t) + 1);
+
+    if (m->pilots == NULL || m->remap == NULL) {
+        mph_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+/* Create new mph from `n` distinct keys, the key lengths are `lens`, or
+ * `strlen` of the keys if `lens` is NULL. NULL on no memory, or if keys
+ * are not distinct. */
+struct mph *mph_new(char **keys, size_t *lens, size_t n) {
+    assert(keys != NULL || n == 0);
+
+    if (n >= MPH_LEN_MAX) return NULL;
+
+    uint32_t cap = n / MPH_LOAD_LIMIT + 1;
+    uint32_t buckets = (n + MPH_BUCKET_SIZE - 1) / MPH_BUCKET_SIZE;
+    struct mph *m = mph_alloc(n, cap, buckets > 0 ? buckets : 1);
+    uint64_t *hashes = malloc(n * sizeof(uint64_t) + 1);
+    size_t *lens_ = lens == NULL ? malloc(n * sizeof(size_t) + 1) : lens;
+    size_t i;
+    int err = MPH_ENOMEM, tries;
+
+    if (m == NULL || hashes == NULL || lens_ == NULL) goto end;
+
+    if (lens == NULL)
+        for (i = 0; i < n; i++) lens_[i] = strlen(keys[i]);
+
+    for (tries = 0; tries < MPH_BUILD_TRIES; tries++) {
+        m->seed = map_seed();
+
+        for (i = 0; i < n; i++)
+            hashes[i] = map_hash(keys[i], lens_[i], m->seed);
+
+        err = mph_build(m, hashes, keys, lens_);
+
+        if (err != MPH_ERETRY) break;
+    }
+end:
+    free(hashes);
+    if (lens == NULL) free(lens_);
+
+    if (err != MPH_OK) {
+        mph_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+/* Free mph. */
+void mph_free(struct mph *m) {
+    if (m != NULL) {
+        free(m->pilots);
+        free(m->remap);
+        free(m);
+    }
+}
+
+/* Get the number of keys of mph. */
+size_t mph_len(struct mph *m) {
+    assert(m != NULL);
+    return m->len;
+}
+
+/* Get the index of a key, in [0, len). Distinct keys of the set get
+ * distinct indexes, other keys get arbitrary ones. MPH_NONE if mph is
+ * empty. */
+size_t mph_iindex(struct mph *m, char *key, size_t len) {
+    assert(m != NULL);
+    assert(key != NULL);
+
+    if (m->len == 0) return MPH_NONE;
+
+    uint64_t hash = map_hash(key, len, m->seed);
+    uint32_t s = mph_slot(m, hash, m->pilots[mph_bucket(m, hash)]);
+
+    if (s < m->len) return s;
+    return m->remap[s - m->len];
+}
+
+/* Get the index of a NULL-terminated key. */
+size_t mph_index(struct mph *m, char *key) {
+    return mph_iindex(m, key, strlen(key));
+}
+
+/* Write mph to a file. The file is written to a temporary path and
+ * renamed to `path` once synced, so readers never see a partial file. On
+ * failure the file at the path is left as is. */
+int mph_dump(struct mph *m, char *path) {
+    assert(m != NULL);
+    assert(path != NULL);
+
+    size_t len = strlen(path);
+    char *tmp = malloc(len + sizeof(MPH_TMP_SUFFIX));
+
+    if (tmp == NULL) return MPH_ENOMEM;
+
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, MPH_TMP_SUFFIX, sizeof(MPH_TMP_SUFFIX));
+
+    FILE *fp = fopen(tmp, "wb");
+
+    if (fp == NULL) {
+        free(tmp);
+        return MPH_EOPEN;
+    }
+
+    struct mph_header head;
+    memcpy(head.magic, MPH_MAGIC, 8);
+    head.seed = m->seed;
+    head.len = m->len;
+    head.cap = m->cap;
+    head.buckets = m->buckets;
+    head.unused = 0;
+
+    size_t remaps = m->cap - m->len;
+    int err = 0;
+
+    err |= fwrite(&head, sizeof(head), 1, fp) != 1;
+    err |= fwrite(m->pilots, sizeof(uint16_t), m->buckets, fp) != m->buckets;
+    err |= fwrite(m->remap, sizeof(uint32_t), remaps, fp) != remaps;
+    err |= fflush(fp) != 0;
+    err |= fsync(fileno(fp)) != 0;
+    err |= fclose(fp) != 0;
+
+    int ret = err ? MPH_EWRITE : MPH_OK;
+
+    if (ret == MPH_OK && rename(tmp, path) != 0) ret = MPH_ERENAME;
+
+    if (ret != MPH_OK) unlink(tmp);
+
+    free(tmp);
+    return ret;
+}
+
+/* Load mph from a file written by `mph_dump`, NULL on no memory or if
+ * it's not a valid mph file. */
+struct mph *mph_load(char *path) {
+    assert(path != NULL);
+
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL) return NULL;
+
+    struct mph_header head;
+    struct mph *m = NULL;
+
+    if (fread(&head, sizeof(head), 1, fp) != 1 ||
+        memcmp(head.magic, MPH_MAGIC, 8) != 0 || head.buckets == 0 ||
+        head.len >= MPH_LEN_MAX || head.cap <= head.len ||
+        (m = mph_alloc(head.len, head.cap, head.buckets)) == NULL)
+        goto fail;
+
+    m->seed = head.seed;
+
+    size_t i, remaps = m->cap - m->len;
+
+    if (fread(m->pilots, sizeof(uint16_t), m->buckets, fp) != m->buckets ||
+        fread(m->remap, sizeof(uint32_t), remaps, fp) != remaps ||
+        fgetc(fp) != EOF)
+        goto fail;
+
+    /* indexes out of [0, len) would overflow the caller's table */
+    for (i = 0; i < remaps; i++)
+        if (m->remap[i] >= m->len && m->len > 0) goto fail;
+
+    fclose(fp);
+    return m;
+fail:
+    fclose(fp);
+    mph_free(m);
+    return NULL;
+}
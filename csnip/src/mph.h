@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ *
+ * Minimal perfect hash for static key sets, in the style of CHD. It maps
+ * the n keys it's built from to distinct indexes in [0, n), so a table of
+ * n entries indexed by it is looked up by one probe and one key compare.
+ * Keys are hashed into buckets of about 5 keys, each bucket keeps a 16 bits
+ * pilot displacing its keys to free slots, about 3.5 bits per key. Keys not
+ * in the set get arbitrary indexes, or MPH_NONE if the set is empty.
+ * deps: map.c alloc.c
+ */
+
+#ifndef __MPH_H__
+#define __MPH_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define MPH_MAGIC "CSNIPMH1"    /* file magic, 8 bytes */
+#define MPH_BUCKET_SIZE 5       /* average keys per bucket */
+#define MPH_LOAD_LIMIT 0.99     /* load factor of slots */
+#define MPH_PILOT_MAX 65535     /* max pilot of a bucket */
+#define MPH_BUILD_TRIES 8       /* seeds tried before giving up */
+#define MPH_LEN_MAX (1UL << 31) /* max number of keys */
+#define MPH_NONE ((size_t)-1)   /* index of any key in an empty mph */
+#define MPH_TMP_SUFFIX ".tmp"   /* dump writes to path + suffix */
+
+enum {
+    MPH_OK = 0,      /* operation is ok */
+    MPH_ENOMEM = 1,  /* no memory error */
+    MPH_EOPEN = 2,   /* failed to open file */
+    MPH_EWRITE = 3,  /* failed to write to file */
+    MPH_ERENAME = 4, /* failed to rename file */
+};
+
+/* file layout (native byte order): header, pilots, remap */
+struct mph_header {
+    char magic[8];    /* MPH_MAGIC */
+    uint64_t seed;    /* key hash seed */
+    uint32_t len;     /* number of keys */
+    uint32_t cap;     /* number of slots */
+    uint32_t buckets; /* number of buckets */
+    uint32_t unused;  /* padding, 0 */
+};
+
+struct mph {
+    uint64_t seed;    /* key hash seed */
+    uint32_t len;     /* number of keys */
+    uint32_t cap;     /* number of slots, >= len */
+    uint32_t buckets; /* number of buckets */
+    uint16_t *pilots; /* pilot of each bucket */
+    uint32_t *remap;  /* index of each slot >= len */
+};
+
+struct mph *mph_new(char **keys, size_t *lens, size_t n);
+void mph_free(struct mph *m);
+size_t mph_len(struct mph *m);                           /* O(1) */
+size_t mph_index(struct mph *m, char *key);              /* O(1) */
+size_t mph_iindex(struct mph *m, char *key, size_t len); /* O(1) */
+int mph_dump(struct mph *m, char *path);
+struct mph *mph_load(char *path);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
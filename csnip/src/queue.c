@@ -7,9 +7,9 @@
 
 #include "queue.h"
 
-/* Create new queue node. */
-struct queue_node *queue_node_new(void *data) {
-    struct queue_node *node = malloc(sizeof(struct queue_node));
+/* Create new queue node from allocator. */
+static struct queue_node *queue_node_alloc(struct alloc *a, void *data) {
+    struct queue_node *node = alloc_malloc(a, sizeof(struct queue_node));
 
     if (node != NULL) {
         node->data = data;
@@ -18,18 +18,31 @@ struct queue_node *queue_node_new(void *data) {
     return node;
 }
 
-/* Free a queue node. */
+/* Create new queue node, from libc malloc whatever the default
+ * allocator, so that `queue_node_free` frees it to where it's from. */
+struct queue_node *queue_node_new(void *data) {
+    return queue_node_alloc(alloc_libc(), data);
+}
+
+/* Free a queue node created by `queue_node_new`. */
 void queue_node_free(struct queue_node *node) {
-    if (node != NULL) free(node);
+    alloc_free(alloc_libc(), node, sizeof(struct queue_node));
 }
 
 /* Create a empty queue */
-struct queue *queue_new(void) {
-    struct queue *queue = malloc(sizeof(struct queue));
+struct queue *queue_new(void) { return queue_new_alloc(NULL); }
+
+/* Create a empty queue with an allocator for the queue and its nodes, NULL
+ * for the default. */
+struct queue *queue_new_alloc(struct alloc *a) {
+    if (a == NULL) a = alloc_default();
+
+    struct queue *queue = alloc_malloc(a, sizeof(struct queue));
     if (queue != NULL) {
         queue->head = NULL;
         queue->tail = NULL;
         queue->len = 0;
+        queue->alloc = a;
     }
     return queue;
 }
@@ -38,7 +51,7 @@ struct queue *queue_new(void) {
 void queue_free(struct queue *queue) {
     if (queue != NULL) {
         queue_clear(queue);
-        free(queue);
+        alloc_free(queue->alloc, queue, sizeof(struct queue));
     }
 }
 
@@ -59,7 +72,7 @@ size_t queue_len(struct queue *queue) {
 int queue_push(struct queue *queue, void *data) {
     assert(queue != NULL);
 
-    struct queue_node *node = queue_node_new(data);
+    struct queue_node *node = queue_node_alloc(queue->alloc, data);
     if (node == NULL) return QUEUE_ENOMEM;
 
     if (queue->len == 0) {
@@ -96,7 +109,7 @@ void *queue_pop(struct queue *queue) {
     }
 
     void *data = head->data;
-    queue_node_free(head);
+    alloc_free(queue->alloc, head, sizeof(struct queue_node));
     return data;
 }
 
@@ -2,7 +2,7 @@
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
  * List based queue implementation.
- * deps: None.
+ * deps: alloc.c
  */
 
 #ifndef __QUEUE_H__
@@ -10,6 +10,8 @@
 
 #include <stdlib.h>
 
+#include "alloc.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -30,11 +32,13 @@ struct queue {
     struct queue_node *head; /* head node */
     struct queue_node *tail; /* last node */
     size_t len;              /* queue length */
+    struct alloc *alloc;     /* allocator of queue and nodes */
 };
 
 struct queue_node *queue_node_new(void *data);
 void queue_node_free(struct queue_node *node);
 struct queue *queue_new(void);
+struct queue *queue_new_alloc(struct alloc *a);
 void queue_free(struct queue *queue);
 void queue_clear(struct queue *queue);
 size_t queue_len(struct queue *queue);           /* O(1) */
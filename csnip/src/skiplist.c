@@ -23,23 +23,27 @@ static int skiplist_rand_level(void) {
     return SKIPLIST_LEVEL_MAX;
 }
 
-/* Create skiplist node. */
-struct skiplist_node *skiplist_node_new(int level, unsigned long score,
-                                        void *data) {
+/* Get the memory size of a skiplist node with its forward links. */
+static size_t skiplist_node_size(int level) {
+    return sizeof(struct skiplist_node) +
+           level * sizeof(struct skiplist_node *);
+}
+
+/* Create skiplist node from allocator, the forward links follow the node
+ * in one allocation. */
+static struct skiplist_node *skiplist_node_alloc(struct alloc *a, int level,
+                                                 unsigned long score,
+                                                 void *data) {
     assert(level > 0);
 
-    struct skiplist_node *node = malloc(sizeof(struct skiplist_node));
+    struct skiplist_node *node = alloc_malloc(a, skiplist_node_size(level));
 
     if (node != NULL) {
         node->score = score;
         node->data = data;
         node->backward = NULL;
-        node->forwards = malloc(level * sizeof(struct skiplist_node *));
-
-        if (node->forwards == NULL) {
-            free(node);
-            return NULL;
-        }
+        node->level = level;
+        node->forwards = (struct skiplist_node **)(node + 1);
 
         int i;
         for (i = 0; i < level; i++) node->forwards[i] = NULL;
@@ -47,27 +51,46 @@ struct skiplist_node *skiplist_node_new(int level, unsigned long score,
     return node;
 }
 
-/* Free skiplist node. */
+/* Free skiplist node to allocator. */
+static void skiplist_node_release(struct alloc *a,
+                                  struct skiplist_node *node) {
+    if (node != NULL) alloc_free(a, node, skiplist_node_size(node->level));
+}
+
+/* Create skiplist node, from libc malloc whatever the default allocator,
+ * so that `skiplist_node_free` frees it to where it's from. */
+struct skiplist_node *skiplist_node_new(int level, unsigned long score,
+                                        void *data) {
+    return skiplist_node_alloc(alloc_libc(), level, score, data);
+}
+
+/* Free skiplist node created by `skiplist_node_new`. */
 void skiplist_node_free(struct skiplist_node *node) {
-    if (node != NULL) {
-        if (node->forwards != NULL) free(node->forwards);
-        free(node);
-    }
+    skiplist_node_release(alloc_libc(), node);
 }
 
 /* Create skiplist. */
 struct skiplist *skiplist_new(skiplist_cmp_t cmp) {
+    return skiplist_new_alloc(cmp, NULL);
+}
+
+/* Create skiplist with an allocator for the skiplist and its nodes, NULL
+ * for the default. */
+struct skiplist *skiplist_new_alloc(skiplist_cmp_t cmp, struct alloc *a) {
     if (cmp == NULL) cmp = &skiplist_default_cmp;
 
-    struct skiplist *skiplist = malloc(sizeof(struct skiplist));
+    if (a == NULL) a = alloc_default();
+
+    struct skiplist *skiplist = alloc_malloc(a, sizeof(struct skiplist));
 
     if (skiplist != NULL) {
         skiplist->len = 0;
         skiplist->level = 1;
         skiplist->cmp = cmp;
-        skiplist->head = skiplist_node_new(SKIPLIST_LEVEL_MAX, 0, NULL);
+        skiplist->alloc = a;
+        skiplist->head = skiplist_node_alloc(a, SKIPLIST_LEVEL_MAX, 0, NULL);
         if (skiplist->head == NULL) {
-            free(skiplist);
+            alloc_free(a, skiplist, sizeof(struct skiplist));
             return NULL;
         }
         skiplist->tail = skiplist->head;
@@ -79,8 +102,8 @@ struct skiplist *skiplist_new(skiplist_cmp_t cmp) {
 void skiplist_free(struct skiplist *skiplist) {
     if (skiplist != NULL) {
         skiplist_clear(skiplist);
-        if (skiplist->head != NULL) skiplist_node_free(skiplist->head);
-        free(skiplist);
+        skiplist_node_release(skiplist->alloc, skiplist->head);
+        alloc_free(skiplist->alloc, skiplist, sizeof(struct skiplist));
     }
 }
 
@@ -127,7 +150,7 @@ int skiplist_push(struct skiplist *skiplist, unsigned long score, void *data) {
         skiplist->level = level;
     }
 
-    node = skiplist_node_new(level, score, data);
+    node = skiplist_node_alloc(skiplist->alloc, level, score, data);
 
     if (node == NULL) return SKIPLIST_ENOMEM;
 
@@ -207,7 +230,7 @@ void *skiplist_pop(struct skiplist *skiplist, unsigned long score) {
     if (node == skiplist->tail) skiplist->tail = node->backward;
 
     void *data = node->data;
-    skiplist_node_free(node);
+    skiplist_node_release(skiplist->alloc, node);
     skiplist->len -= 1;
     return data;
 }
@@ -239,7 +262,7 @@ void *skiplist_popfirst(struct skiplist *skiplist) {
     if (node == skiplist->tail) skiplist->tail = node->backward;
 
     void *data = node->data;
-    skiplist_node_free(node);
+    skiplist_node_release(skiplist->alloc, node);
     skiplist->len -= 1;
     return data;
 }
@@ -274,7 +297,7 @@ void *skiplist_poplast(struct skiplist *skiplist) {
 
     void *data = tail->data;
     skiplist->tail = tail->backward;
-    skiplist_node_free(tail);
+    skiplist_node_release(skiplist->alloc, tail);
     skiplist->len -= 1;
     return data;
 }
@@ -2,7 +2,7 @@
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
  * Skiplist implementation.
- * deps: None.
+ * deps: alloc.c
  */
 
 #ifndef __SKIPLIST_H__
@@ -10,6 +10,8 @@
 
 #include <stddef.h>
 
+#include "alloc.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -37,6 +39,7 @@ struct skiplist_node {
     void *data;                      /* node data */
     struct skiplist_node **forwards; /* node forward links */
     struct skiplist_node *backward;  /* node backward link */
+    int level;                       /* number of forward links */
 };
 
 struct skiplist {
@@ -45,6 +48,7 @@ struct skiplist {
     struct skiplist_node *head; /* skiplist head */
     struct skiplist_node *tail; /* skiplist tail */
     skiplist_cmp_t cmp;         /* score comparator */
+    struct alloc *alloc;        /* allocator of skiplist and nodes */
 };
 
 struct skiplist_iter {
@@ -56,6 +60,7 @@ struct skiplist_node *skiplist_node_new(int level, unsigned long score,
                                         void *data);
 void skiplist_node_free(struct skiplist_node *node);
 struct skiplist *skiplist_new(skiplist_cmp_t cmp);
+struct skiplist *skiplist_new_alloc(skiplist_cmp_t cmp, struct alloc *a);
 void skiplist_free(struct skiplist *skiplist);
 void skiplist_clear(struct skiplist *skiplist);
 size_t skiplist_len(struct skiplist *skiplist); /* O(1) */
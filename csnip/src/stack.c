@@ -5,16 +5,18 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "alloc.h"
 #include "stack.h"
 
-/* Create new stack with an initialized capacity. */
-struct stack *stack_new(size_t cap) {
+/* Create a stack, with its data from `alloc_huge` if huge. */
+static struct stack *stack_create(size_t cap, int huge) {
     struct stack *stack = malloc(sizeof(struct stack));
 
     if (stack != NULL) {
         stack->data = NULL;
         stack->len = 0;
         stack->cap = 0;
+        stack->huge = huge;
 
         if (cap > 0 && stack_grow(stack, cap) != STACK_OK) return NULL;
     }
@@ -22,10 +24,25 @@ struct stack *stack_new(size_t cap) {
     return stack;
 }
 
+/* Create new stack with an initialized capacity. */
+struct stack *stack_new(size_t cap) { return stack_create(cap, 0); }
+
+/* Create new stack with an initialized capacity, its data backed by huge
+ * pages if possible, see `alloc_huge`. */
+struct stack *stack_new_huge(size_t cap) { return stack_create(cap, 1); }
+
+/* Free stack data. */
+static void stack_data_free(struct stack *stack) {
+    if (stack->huge)
+        alloc_huge_free(stack->data, stack->cap * sizeof(void *));
+    else
+        free(stack->data);
+}
+
 /* Free stack and its data. */
 void stack_free(struct stack *stack) {
     if (stack != NULL) {
-        if (stack->data != NULL) free(stack->data);
+        stack_data_free(stack);
         free(stack);
     }
 }
@@ -35,7 +52,7 @@ void stack_clear(struct stack *stack) {
     assert(stack != NULL);
 
     if (stack->data != NULL) {
-        free(stack->data);
+        stack_data_free(stack);
         stack->data = NULL;
     }
 
@@ -72,7 +89,11 @@ int stack_grow(struct stack *stack, size_t cap) {
     size_t new_cap = stack->cap + unit;
     while (new_cap < cap) new_cap += unit;
 
-    void **data = realloc(stack->data, new_cap * sizeof(void *));
+    void **data =
+        stack->huge
+            ? alloc_huge_realloc(stack->data, stack->cap * sizeof(void *),
+                                 new_cap * sizeof(void *))
+            : realloc(stack->data, new_cap * sizeof(void *));
     if (data == NULL) return STACK_ENOMEM;
 
     stack->data = data;
@@ -2,7 +2,7 @@
  * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
  *
  * Array based stack implementation.
- * deps: None.
+ * deps: alloc.c
  */
 
 #ifndef __STACK_H__
@@ -10,6 +10,8 @@
 
 #include <stdlib.h>
 
+#include "alloc.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -30,9 +32,11 @@ struct stack {
     size_t len;  /* stack length */
     size_t cap;  /* stack capacity */
     void **data; /* stack data */
+    int huge;    /* if data is from `alloc_huge` */
 };
 
 struct stack *stack_new(size_t cap);
+struct stack *stack_new_huge(size_t cap);
 void stack_free(struct stack *stack);
 void stack_clear(struct stack *stack);
 size_t stack_len(struct stack *stack);           /* O(1) */
@@ -0,0 +1,241 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "u64map.h"
+
+/* Get the home slot of a key by fibonacci hashing, the top bits of the key
+ * multiplied by 2^64 / phi. */
+static inline size_t u64map_home(struct u64map *m, uint64_t key) {
+    return (key * 0x9e3779b97f4a7c15ull) >> m->shift;
+}
+
+/* Create an u64map. */
+struct u64map *u64map_new(void) {
+    struct u64map *m = malloc(sizeof(struct u64map));
+
+    if (m != NULL) {
+        m->cap = 0;
+        m->len = 0;
+        m->shift = 64;
+        m->table = NULL;
+        m->zero_set = 0;
+        m->zero.key = 0;
+        m->zero.val = NULL;
+    }
+    return m;
+}
+
+/* Free u64map. */
+void u64map_free(struct u64map *m) {
+    if (m != NULL) {
+        if (m->table != NULL) free(m->table);
+        free(m);
+    }
+}
+
+/* Clear u64map. */
+void u64map_clear(struct u64map *m) {
+    assert(m != NULL);
+    if (m->table != NULL) free(m->table);
+    m->cap = 0;
+    m->len = 0;
+    m->shift = 64;
+    m->table = NULL;
+    m->zero_set = 0;
+    m->zero.val = NULL;
+}
+
+/* Get u64map length. */
+size_t u64map_len(struct u64map *m) {
+    assert(m != NULL);
+    return m->len;
+}
+
+/* Get u64map table capacity. */
+size_t u64map_cap(struct u64map *m) {
+    assert(m != NULL);
+    return m->cap;
+}
+
+/* Resize and rehash u64map to given cap, must be 2**. */
+static int u64map_resize(struct u64map *m, size_t cap) {
+    assert(m != NULL);
+
+    if (cap < U64MAP_CAP_INIT) cap = U64MAP_CAP_INIT;
+
+    if (cap > U64MAP_CAP_MAX) return U64MAP_ENOMEM;
+
+    /* zeroed slots are empty */
+    struct u64map_node *table = calloc(cap, sizeof(struct u64map_node));
+
+    if (table == NULL) return U64MAP_ENOMEM;
+
+    struct u64map_node *old = m->table;
+    size_t old_cap = m->cap;
+    size_t i;
+
+    m->table = table;
+    m->cap = cap;
+    m->shift = 64 - __builtin_ctzll(cap);
+
+    for (i = 0; i < old_cap; i++) {
+        if (old[i].key == 0) continue;
+
+        size_t j = u64map_home(m, old[i].key);
+
+        while (table[j].key != 0) j = (j + 1) & (cap - 1);
+        table[j] = old[i];
+    }
+
+    if (old != NULL) free(old);
+    return U64MAP_OK;
+}
+
+/* Get the slot of a key in table, NULL on not found. */
+static struct u64map_node *u64map_find(struct u64map *m, uint64_t key) {
+    if (key == 0) return m->zero_set ? &m->zero : NULL;
+
+    if (m->table == NULL) return NULL;
+
+    size_t mask = m->cap - 1;
+    size_t i = u64map_home(m, key);
+
+    for (; m->table[i].key != 0; i = (i + 1) & mask)
+        if (m->table[i].key == key) return &m->table[i];
+    return NULL;
+}
+
+/* Set a key into u64map. */
+int u64map_set(struct u64map *m, uint64_t key, void *val) {
+    assert(m != NULL);
+
+    if (key == 0) {
+        if (!m->zero_set) m->len++;
+        m->zero_set = 1;
+        m->zero.val = val;
+        return U64MAP_OK;
+    }
+
+    /* if require resize */
+    if ((m->cap * U64MAP_LOAD_LIMIT < m->len + 1 || m->table == NULL) &&
+        u64map_resize(m, m->cap * 2) != U64MAP_OK)
+        return U64MAP_ENOMEM;
+
+    size_t mask = m->cap - 1;
+    size_t i = u64map_home(m, key);
+
+    for (; m->table[i].key != 0; i = (i + 1) & mask) {
+        if (m->table[i].key == key) {
+            m->table[i].val = val;
+            return U64MAP_OK;
+        }
+    }
+
+    m->table[i].key = key;
+    m->table[i].val = val;
+    m->len++;
+    return U64MAP_OK;
+}
+
+/* Get val by key from u64map, NULL on not found. */
+void *u64map_get(struct u64map *m, uint64_t key) {
+    assert(m != NULL);
+
+    struct u64map_node *node = u64map_find(m, key);
+    if (node != NULL) return node->val;
+    return NULL;
+}
+
+/* Test if a key is in u64map. */
+int u64map_has(struct u64map *m, uint64_t key) {
+    assert(m != NULL);
+    return u64map_find(m, key) != NULL;
+}
+
+/* Pop a key from u64map, NULL on not found. The following nodes of the
+ * probe run are shifted back into the hole, unless it would move them
+ * before their home slots, so no tombstones are needed. */
+void *u64map_pop(struct u64map *m, uint64_t key) {
+    assert(m != NULL);
+
+    struct u64map_node *node = u64map_find(m, key);
+
+    if (node == NULL) return NULL;
+
+    void *val = node->val;
+
+    if (key == 0) {
+        m->zero_set = 0;
+        m->zero.val = NULL;
+        m->len--;
+        return val;
+    }
+
+    size_t mask = m->cap - 1;
+    size_t i = node - m->table;
+    size_t j = i;
+
+    for (j = (j + 1) & mask; m->table[j].key != 0; j = (j + 1) & mask) {
+        size_t home = u64map_home(m, m->table[j].key);
+
+        /* skip the node if its home is cyclically in (i, j] */
+        if (((j - home) & mask) < ((j - i) & mask)) continue;
+
+        m->table[i] = m->table[j];
+        i = j;
+    }
+
+    m->table[i].key = 0;
+    m->table[i].val = NULL;
+    m->len--;
+
+    /* halve the table once it is light enough, keeps the bigger table on
+     * no memory */
+    if (m->cap > U64MAP_CAP_INIT && m->len < m->cap * U64MAP_SHRINK_LIMIT)
+        u64map_resize(m, m->cap / 2);
+    return val;
+}
+
+/* Create u64map iter. */
+struct u64map_iter *u64map_iter_new(struct u64map *m) {
+    assert(m != NULL);
+    struct u64map_iter *iter = malloc(sizeof(struct u64map_iter));
+
+    if (iter != NULL) {
+        iter->m = m;
+        iter->i = 0;
+    }
+    return iter;
+}
+
+/* Free u64map iter. */
+void u64map_iter_free(struct u64map_iter *iter) {
+    if (iter != NULL) free(iter);
+}
+
+/* Get next, key 0 comes last. Popping keys while iterating may shift
+ * unvisited nodes backward into visited slots or shrink the map, so they
+ * would be missed. */
+struct u64map_node *u64map_iter_next(struct u64map_iter *iter) {
+    assert(iter != NULL && iter->m != NULL);
+
+    struct u64map *m = iter->m;
+
+    for (; iter->i < m->cap; iter->i++)
+        if (m->table[iter->i].key != 0) return &m->table[iter->i++];
+
+    if (iter->i++ == m->cap && m->zero_set) return &m->zero;
+    return NULL;
+}
+
+/* Rewind u64map iter. */
+void u64map_iter_rewind(struct u64map_iter *iter) {
+    assert(iter != NULL);
+    iter->i = 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ *
+ * Dynamic sized open-addressing hashtable with 64 bits integer keys, e.g.
+ * fds or ids. Keys and vals are stored inline in 16 bytes slots, hashed by
+ * fibonacci hashing, probed linearly with backward shift deletion. Key 0
+ * marks empty slots, it's kept out of the table.
+ * deps: None
+ */
+
+#ifndef __U64MAP_H__
+#define __U64MAP_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define U64MAP_LOAD_LIMIT 0.72     /* load factor */
+#define U64MAP_SHRINK_LIMIT 0.18   /* load factor to shrink under */
+#define U64MAP_CAP_INIT 16         /* init table size: must be 2** */
+#define U64MAP_CAP_MAX (1UL << 40) /* max table size */
+
+#define u64map() u64map_new()
+#define u64map_iter(m) u64map_iter_new(m)
+#define u64map_each(iter, node) \
+    while (((node) = u64map_iter_next((iter))) != NULL)
+
+enum {
+    U64MAP_OK = 0,     /* operation is ok */
+    U64MAP_ENOMEM = 1, /* no memory error */
+};
+
+struct u64map_node {
+    uint64_t key; /* key, 0 for empty slots in table */
+    void *val;    /* value data */
+};
+
+struct u64map {
+    size_t cap;                /* table capacity */
+    size_t len;                /* map length, key 0 included */
+    unsigned shift;            /* 64 - log2(cap) */
+    struct u64map_node *table; /* node table */
+    int zero_set;              /* if key 0 is set */
+    struct u64map_node zero;   /* node of key 0 */
+};
+
+struct u64map_iter {
+    struct u64map *m; /* map to iterate */
+    size_t i;         /* current table index, cap for key 0 */
+};
+
+struct u64map *u64map_new(void);
+void u64map_free(struct u64map *m);
+void u64map_clear(struct u64map *m);                       /* O(1) */
+size_t u64map_len(struct u64map *m);                       /* O(1) */
+size_t u64map_cap(struct u64map *m);                       /* O(1) */
+int u64map_set(struct u64map *m, uint64_t key, void *val); /* O(1) */
+void *u64map_get(struct u64map *m, uint64_t key);          /* O(1) */
+int u64map_has(struct u64map *m, uint64_t key);            /* O(1) */
+void *u64map_pop(struct u64map *m, uint64_t key);          /* O(1) */
+struct u64map_iter *u64map_iter_new(struct u64map *m);
+void u64map_iter_free(struct u64map_iter *iter);
+struct u64map_node *u64map_iter_next(struct u64map_iter *iter);
+void u64map_iter_rewind(struct u64map_iter *iter);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
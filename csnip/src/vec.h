@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ *
+ * Typed dynamic array generator. `VEC_DEFINE(name, T)` defines `struct
+ * name` storing elements of type T inline, and its static inline functions
+ * `name_new`, `name_push`, `name_at` etc., `name_new_alloc` takes an
+ * allocator for the vec and its data, e.g.
+ *
+ *   VEC_DEFINE(ints, int)
+ *   struct ints *v = ints_new();
+ *   ints_push(v, 1);
+ *
+ * deps: alloc.c
+ */
+
+#ifndef __VEC_H__
+#define __VEC_H__
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define VEC_CAP_INIT 16 /* init capacity */
+
+enum {
+    VEC_OK = 0,     /* operation is ok */
+    VEC_ENOMEM = 1, /* no memory error */
+};
+
+#define VEC_DEFINE(name, T)                                                \
+    struct name {                                                          \
+        T *data;             /* elements */                                \
+        size_t len;          /* vec length */                              \
+        size_t cap;          /* vec capacity */                            \
+        struct alloc *alloc; /* allocator of vec and data */               \
+    };                                                                     \
+                                                                           \
+    /* Create an empty vec with an allocator for the vec and its data,     \
+     * NULL for the default. */                                            \
+    static inline struct name *name##_new_alloc(struct alloc *a) {         \
+        if (a == NULL) a = alloc_default();                                \
+                                                                           \
+        struct name *v = alloc_malloc(a, sizeof(struct name));             \
+                                                                           \
+        if (v != NULL) {                                                   \
+            v->data = NULL;                                                \
+            v->len = 0;                                                    \
+            v->cap = 0;                                                    \
+            v->alloc = a;                                                  \
+        }                                                                  \
+        return v;                                                          \
+    }                                                                      \
+                                                                           \
+    /* Create an empty vec. */                                             \
+    static inline struct name *name##_new(void) {                          \
+        return name##_new_alloc(NULL);                                     \
+    }                                                                      \
+                                                                           \
+    /* Free vec. */                                                        \
+    static inline void name##_free(struct name *v) {                       \
+        if (v != NULL) {                                                   \
+            alloc_free(v->alloc, v->data, v->cap * sizeof(T));             \
+            alloc_free(v->alloc, v, sizeof(struct name));                  \
+        }                                                                  \
+    }                                                                      \
+                                                                           \
+    /* Clear vec, the memory is kept. */                                   \
+    static inline void name##_clear(struct name *v) { v->len = 0; }        \
+                                                                           \
+    /* Get vec length. */                                                  \
+    static inline size_t name##_len(struct name *v) { return v->len; }     \
+                                                                           \
+    /* Get vec capacity. */                                                \
+    static inline size_t name##_cap(struct name *v) { return v->cap; }     \
+                                                                           \
+    /* Grow vec capacity to at least given cap, by doubling. */            \
+    static inline int name##_grow(struct name *v, size_t cap) {            \
+        if (cap <= v->cap) return VEC_OK;                                  \
+                                                                           \
+        size_t new_cap = v->cap > 0 ? v->cap : VEC_CAP_INIT;               \
+                                                                           \
+        while (new_cap < cap) new_cap *= 2;                                \
+                                                                           \
+        T *data = alloc_realloc(v->alloc, v->data, v->cap * sizeof(T),     \
+                                new_cap * sizeof(T));                      \
+                                                                           \
+        if (data == NULL) return VEC_ENOMEM;                               \
+                                                                           \
+        v->data = data;                                                    \
+        v->cap = new_cap;                                                  \
+        return VEC_OK;                                                     \
+    }                                                                      \
+                                                                           \
+    /* Push an element to the vec end. */                                  \
+    static inline int name##_push(struct name *v, T e) {                   \
+        if (v->len == v->cap && name##_grow(v, v->len + 1) != VEC_OK)      \
+            return VEC_ENOMEM;                                             \
+        v->data[v->len++] = e;                                             \
+        return VEC_OK;                                                     \
+    }                                                                      \
+                                                                           \
+    /* Pop an element from the vec end into `e` if not NULL. Returns 1 on  \
+     * popped, 0 if the vec is empty. */                                   \
+    static inline int name##_pop(struct name *v, T *e) {                   \
+        if (v->len == 0) return 0;                                         \
+        v->len--;                                                          \
+        if (e != NULL) *e = v->data[v->len];                               \
+        return 1;                                                          \
+    }                                                                      \
+                                                                           \
+    /* Get the element at given index, it must be in range. The pointer is \
+     * valid until the vec grows. */                                       \
+    static inline T *name##_at(struct name *v, size_t idx) {               \
+        assert(idx < v->len);                                              \
+        return &v->data[idx];                                              \
+    }
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
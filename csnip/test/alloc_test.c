@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "buf.h"
+#include "dict.h"
+#include "heap.h"
+#include "list.h"
+#include "map.h"
+#include "queue.h"
+#include "skiplist.h"
+#include "vec.h"
+
+static void *alloc_test_default(void *arg) {
+    /* the default is per thread */
+    return alloc_default();
+}
+
+void case_alloc_default() {
+    struct alloc *a = alloc_default();
+    assert(a != NULL);
+    char *p = alloc_malloc(NULL, 8);
+    assert(p != NULL);
+    memcpy(p, "1234567", 8);
+    p = alloc_realloc(NULL, p, 8, 1024);
+    assert(p != NULL && strcmp(p, "1234567") == 0);
+    alloc_free(NULL, p, 1024);
+    alloc_free(a, NULL, 0);
+    /* set and restore */
+    struct alloc_arena *arena = alloc_arena_new(0);
+    alloc_set_default(&arena->alloc);
+    assert(alloc_default() == &arena->alloc);
+    struct list *list = list_new();
+    assert(list->alloc == &arena->alloc);
+    pthread_t t;
+    void *other = NULL;
+    assert(pthread_create(&t, NULL, &alloc_test_default, NULL) == 0);
+    assert(pthread_join(t, &other) == 0);
+    assert(other == alloc_libc());
+    /* standalone nodes are from libc, freed there whatever the default */
+    struct list_node *lnode = list_node_new("a");
+    struct queue_node *qnode = queue_node_new("a");
+    alloc_set_default(NULL);
+    assert(alloc_default() == alloc_libc());
+    list_node_free(lnode);
+    queue_node_free(qnode);
+    assert(alloc_default() == a);
+    assert(list_push(list, "a") == LIST_OK);
+    list_free(list);
+    alloc_arena_free(arena);
+}
+
+void case_alloc_arena() {
+    struct alloc_arena *arena = alloc_arena_new(256);
+    struct alloc *a = &arena->alloc;
+    char *p1 = alloc_malloc(a, 1);
+    char *p2 = alloc_malloc(a, 17);
+    assert(p1 != NULL && p2 != NULL);
+    assert((uintptr_t)p1 % ALLOC_ALIGN == 0);
+    assert((uintptr_t)p2 % ALLOC_ALIGN == 0);
+    assert(p2 == p1 + ALLOC_ALIGN);
+    /* the last allocation grows and is freed in place */
+    assert(alloc_realloc(a, p2, 17, 64) == p2);
+    alloc_free(a, p2, 64);
+    assert(alloc_malloc(a, 8) == p2);
+    /* others are copied */
+    memcpy(p1, "abcdefghijklmno", 16);
+    char *p3 = alloc_realloc(a, p1, 16, 32);
+    assert(p3 != p1 && memcmp(p3, "abcdefghijklmno", 16) == 0);
+    /* large allocations take their own chunk */
+    char *p4 = alloc_malloc(a, 1024);
+    assert(p4 != NULL);
+    memset(p4, 1, 1024);
+    char *p5 = alloc_malloc(a, 16);
+    assert(p5 == p3 + 32);
+    /* filling the chunk starts a new one */
+    int i;
+    for (i = 0; i < 64; i++) assert(alloc_malloc(a, 16) != NULL);
+    alloc_arena_reset(arena);
+    assert(arena->chunks != NULL && arena->chunks->next == NULL);
+    assert(alloc_malloc(a, 16) == arena->chunks->data);
+    alloc_arena_free(arena);
+}
+
+void case_alloc_slab() {
+    struct alloc_slab *slab = alloc_slab_new(24);
+    struct alloc *a = &slab->alloc;
+    assert(slab->size == 32);
+    void *objs[300];
+    int i;
+    for (i = 0; i < 300; i++) {
+        objs[i] = alloc_malloc(a, 24);
+        assert(objs[i] != NULL);
+        assert((uintptr_t)objs[i] % ALLOC_ALIGN == 0);
+        memset(objs[i], i, 24);
+    }
+    assert(objs[1] == (char *)objs[0] + 32);
+    /* freed objects are reused, the last freed first */
+    alloc_free(a, objs[7], 24);
+    alloc_free(a, objs[3], 24);
+    assert(alloc_malloc(a, 24) == objs[3]);
+    assert(alloc_malloc(a, 24) == objs[7]);
+    /* larger allocations go to libc */
+    char *p = alloc_malloc(a, 16);
+    memcpy(p, "abc", 4);
+    p = alloc_realloc(a, p, 16, 4096);
+    assert(p != NULL && strcmp(p, "abc") == 0);
+    p = alloc_realloc(a, p, 4096, 8);
+    assert(p != NULL && strcmp(p, "abc") == 0);
+    alloc_free(a, p, 8);
+    alloc_slab_free(slab);
+}
+
+#define alloc_test_hash(k) ((uint64_t)(k))
+#define alloc_test_eq(a, b) ((a) == (b))
+#define alloc_test_less(a, b) ((a) < (b))
+MAP_DEFINE(alloc_test_map, int, int, alloc_test_hash, alloc_test_eq)
+HEAP_DEFINE(alloc_test_heap, int, alloc_test_less)
+VEC_DEFINE(alloc_test_vec, int)
+
+void case_alloc_containers() {
+    struct alloc_slab *slab = alloc_slab_new(sizeof(struct list_node));
+    struct alloc_arena *arena = alloc_arena_new(0);
+    int i;
+    /* list and queue nodes from a slab */
+    struct list *list = list_new_alloc(&slab->alloc);
+    struct queue *queue = queue_new_alloc(&slab->alloc);
+    for (i = 0; i < 1000; i++) {
+        assert(list_push(list, "a") == LIST_OK);
+        assert(queue_push(queue, "b") == QUEUE_OK);
+    }
+    for (i = 0; i < 500; i++) {
+        assert(list_pop(list) != NULL);
+        assert(queue_pop(queue) != NULL);
+    }
+    assert(list_len(list) == 500 && queue_len(queue) == 500);
+    list_free(list);
+    queue_free(queue);
+    /* skiplist, dict and buf from an arena */
+    struct skiplist *sl = skiplist_new_alloc(NULL, &arena->alloc);
+    struct dict *dict = dict_new_alloc(&arena->alloc);
+    struct buf *buf = buf_new_alloc(&arena->alloc);
+    char keys[1000][8];
+    for (i = 0; i < 1000; i++) {
+        sprintf(keys[i], "k%d", i);
+        assert(skiplist_push(sl, i, keys[i]) == SKIPLIST_OK);
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+        assert(buf_puts(buf, keys[i]) == BUF_OK);
+    }
+    assert(skiplist_len(sl) == 1000 && dict_len(dict) == 1000);
+    assert(skiplist_popfirst(sl) == keys[0]);
+    assert(dict_get(dict, "k999") == keys[999]);
+    assert(strncmp(buf_str(buf), "k0k1k2", 6) == 0);
+    skiplist_free(sl);
+    dict_free(dict);
+    buf_free(buf);
+    /* generated containers from an arena */
+    struct alloc_test_map *m = alloc_test_map_new_alloc(&arena->alloc);
+    struct alloc_test_heap *heap = alloc_test_heap_new_alloc(&arena->alloc);
+    struct alloc_test_vec *v = alloc_test_vec_new_alloc(&arena->alloc);
+    assert(m->alloc == &arena->alloc && v->alloc == &arena->alloc);
+    for (i = 0; i < 1000; i++) {
+        assert(alloc_test_map_set(m, i, i) == MAP_OK);
+        assert(alloc_test_heap_push(heap, 1000 - i) == HEAP_OK);
+        assert(alloc_test_vec_push(v, i) == VEC_OK);
+    }
+    assert(*alloc_test_map_get(m, 999) == 999);
+    assert(*alloc_test_heap_top(heap) == 1);
+    assert(*alloc_test_vec_at(v, 999) == 999);
+    alloc_test_map_free(m);
+    alloc_test_heap_free(heap);
+    alloc_test_vec_free(v);
+    alloc_arena_free(arena);
+    alloc_slab_free(slab);
+}
+
+void case_alloc_huge() {
+    /* small allocations go to libc */
+    char *p = alloc_huge(64);
+    assert(p != NULL && p[0] == 0 && p[63] == 0);
+    p = alloc_huge_realloc(p, 64, 128);
+    assert(p != NULL);
+    alloc_huge_free(p, 128);
+    /* large ones are zeroed and aligned to huge pages */
+    size_t size = ALLOC_HUGE_PAGE + 1;
+    p = alloc_huge(size);
+    assert(p != NULL && (uintptr_t)p % ALLOC_HUGE_PAGE == 0);
+    assert(p[0] == 0 && p[size - 1] == 0);
+    memcpy(p, "abc", 4);
+    /* resized in place while it fits */
+    assert(alloc_huge_realloc(p, size, 2 * ALLOC_HUGE_PAGE) == p);
+    size = 2 * ALLOC_HUGE_PAGE;
+    p = alloc_huge_realloc(p, size, 8 * ALLOC_HUGE_PAGE);
+    assert(p != NULL && strcmp(p, "abc") == 0);
+    p[8 * ALLOC_HUGE_PAGE - 1] = 1;
+    p = alloc_huge_realloc(p, 8 * ALLOC_HUGE_PAGE, ALLOC_HUGE_PAGE);
+    assert(p != NULL && strcmp(p, "abc") == 0);
+    /* back to libc */
+    p = alloc_huge_realloc(p, ALLOC_HUGE_PAGE, 16);
+    assert(p != NULL && strcmp(p, "abc") == 0);
+    alloc_huge_free(p, 16);
+    alloc_huge_free(NULL, size);
+    /* lazy ones too, faulted in on touch */
+    size = 4 * ALLOC_HUGE_PAGE;
+    p = alloc_huge_lazy(size);
+    assert(p != NULL && (uintptr_t)p % ALLOC_HUGE_PAGE == 0);
+    assert(p[0] == 0 && p[size - 1] == 0);
+    p[ALLOC_HUGE_PAGE] = 1;
+    alloc_huge_free(p, size);
+    p = alloc_huge_lazy(64);
+    assert(p != NULL && p[63] == 0);
+    alloc_huge_free(p, 64);
+}
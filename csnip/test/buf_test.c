@@ -3,7 +3,13 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "buf.h"
 
@@ -63,6 +69,76 @@ void case_buf_sprintf() {
     buf_free(buf);
 }
 
+void case_buf_put_int() {
+    struct buf *buf = buf(NULL);
+    assert(buf_put_u64(buf, 0) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_u64(buf, UINT64_MAX) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_i64(buf, INT64_MIN) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_i64(buf, -7) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_hex(buf, 0) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_hex(buf, 0xdeadbeef) == BUF_OK);
+    assert(strcmp(buf_str(buf), "0 18446744073709551615 "
+                                "-9223372036854775808 -7 0 deadbeef") == 0);
+    /* the same as printf */
+    char s[64];
+    int64_t v;
+    for (v = 1; v > 0 && v < INT64_MAX / 3; v = v * 3 + 1) {
+        buf_clear(buf);
+        buf_put_i64(buf, -v);
+        buf_put_u64(buf, v);
+        buf_put_hex(buf, v);
+        sprintf(s, "%lld%llu%llx", -(long long)v, (unsigned long long)v,
+                (unsigned long long)v);
+        assert(strcmp(buf_str(buf), s) == 0);
+    }
+    buf_free(buf);
+}
+
+void case_buf_put_double() {
+    struct buf *buf = buf(NULL);
+    assert(buf_put_double(buf, 3.14159, 3) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, -123456.789, 2) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, 0.0004, 3) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, -0.0004, 3) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, 99.96, 0) == BUF_OK);
+    assert(strcmp(buf_str(buf), "3.142 -123456.79 0.000 -0.000 100") == 0);
+    /* others go to sprintf */
+    buf_clear(buf);
+    assert(buf_put_double(buf, 1e20, 1) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, INFINITY, 3) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, 0.5, 12) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, 0.125, 2) == BUF_OK);
+    assert(buf_putc(buf, ' ') == BUF_OK);
+    assert(buf_put_double(buf, 2.5, 0) == BUF_OK);
+    assert(strcmp(buf_str(buf),
+                  "100000000000000000000.0 inf 0.500000000000 0.12 2") == 0);
+    /* the same as printf */
+    char s[64];
+    int i, prec;
+    for (i = -1000; i < 1000; i++) {
+        for (prec = 0; prec <= BUF_DOUBLE_PREC_MAX; prec++) {
+            double v = i * 1234.5678 / 7;
+            buf_clear(buf);
+            buf_put_double(buf, v, prec);
+            sprintf(s, "%.*f", prec, v);
+            assert(strcmp(buf_str(buf), s) == 0);
+        }
+    }
+    buf_free(buf);
+}
+
 void case_buf_isempty() {
     struct buf *buf1 = buf("test");
     struct buf *buf2 = buf(NULL);
@@ -79,6 +155,22 @@ void case_buf_lrm() {
     buf_lrm(buf, 100);
     assert(strcmp(buf_str(buf), "") == 0);
     buf_free(buf);
+    /* consuming moves the data forward, growing reclaims the bytes */
+    buf = buf("0123456789012345678901234567890123456789");
+    assert(buf_cap(buf) == 64);
+    char *data = buf->data;
+    buf_lrm(buf, 3);
+    assert(buf->data == data + 3 && buf->off == 3);
+    assert(buf_len(buf) == 37 && buf_cap(buf) == 61);
+    assert(buf_put(buf, "abcdefghijklmnopqrstuvwxy", 25) == BUF_OK);
+    assert(buf->data == data && buf->off == 0);
+    assert(memcmp(buf->data, "3456789", 7) == 0);
+    assert(buf_len(buf) == 62 && buf_cap(buf) == 64);
+    /* draining resets the data */
+    buf_lrm(buf, 2);
+    buf_lrm(buf, 60);
+    assert(buf->data == data && buf->off == 0 && buf_cap(buf) == 64);
+    buf_free(buf);
 }
 
 void case_buf_len() {
@@ -89,8 +181,181 @@ void case_buf_len() {
 
 void case_buf_cap() {
     struct buf *buf = buf("abcdef");
-    assert(buf_cap(buf) == 6);
+    /* short data is inline */
+    assert(buf_cap(buf) == BUF_SMALL_CAP && buf->data == buf->small);
     buf_puts(buf, "abc");
-    assert(buf_cap(buf) == 12);
+    assert(buf_cap(buf) == BUF_SMALL_CAP);
+    /* then doubled */
+    buf_puts(buf, "0123456789012345678901234567890123456789");
+    assert(buf_cap(buf) == 64 && buf->data != buf->small);
+    assert(strncmp(buf_str(buf), "abcdefabc0123", 13) == 0);
+    buf_puts(buf, "01234567890123456789");
+    assert(buf_cap(buf) == 128);
+    buf_clear(buf);
+    assert(buf_cap(buf) == BUF_SMALL_CAP && buf->data == buf->small);
+    buf_free(buf);
+}
+
+void case_buf_reserve() {
+    struct buf *buf = buf("abc");
+    assert(buf_reserve(buf, 29) == BUF_OK);
+    assert(buf_cap(buf) == BUF_SMALL_CAP);
+    assert(buf_reserve(buf, 1000) == BUF_OK);
+    assert(buf_cap(buf) == 1003);
+    assert(strcmp(buf_str(buf), "abc") == 0);
+    assert(buf_reserve(buf, BUF_CAP_MAX) == BUF_ENOMEM);
+    buf_free(buf);
+}
+
+void case_buf_shrink_to_fit() {
+    struct buf *buf = buf(NULL);
+    int i;
+    for (i = 0; i < 100; i++) assert(buf_putc(buf, 'a' + i % 26) == BUF_OK);
+    assert(buf_cap(buf) == 128);
+    assert(buf_shrink_to_fit(buf) == BUF_OK);
+    assert(buf_cap(buf) == 100 && buf_len(buf) == 100);
+    /* short data goes back inline */
+    buf_lrm(buf, 90);
+    assert(buf_shrink_to_fit(buf) == BUF_OK);
+    assert(buf->data == buf->small && buf_len(buf) == 10);
+    assert(strcmp(buf_str(buf), "mnopqrstuv") == 0);
+    buf_free(buf);
+}
+
+void case_buf_set_max() {
+    struct buf *buf = buf(NULL);
+    buf_set_max(buf, 100);
+    assert(buf_reserve(buf, 100) == BUF_OK);
+    assert(buf_cap(buf) == 100);
+    assert(buf_reserve(buf, 101) == BUF_ENOMEM);
+    char s[101];
+    memset(s, 'a', 100);
+    assert(buf_put(buf, s, 100) == BUF_OK);
+    assert(buf_putc(buf, 'b') == BUF_ENOMEM);
+    assert(buf_len(buf) == 100);
+    buf_free(buf);
+}
+
+void case_buf_read_fd() {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    assert(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    struct buf *buf = buf(NULL);
+    /* drained */
+    assert(buf_read_fd(buf, fds[0], 0) == -1 && errno == EAGAIN);
+    /* short reads stay inline */
+    assert(write(fds[1], "hello", 5) == 5);
+    assert(buf_read_fd(buf, fds[0], 0) == 5);
+    assert(buf->data == buf->small);
+    assert(strcmp(buf_str(buf), "hello") == 0);
+    /* the spilled part grows the buffer */
+    char s[4000];
+    memset(s, 'a', sizeof(s));
+    assert(write(fds[1], s, sizeof(s)) == sizeof(s));
+    assert(buf_read_fd(buf, fds[0], 0) == sizeof(s));
+    assert(buf_len(buf) == 5 + sizeof(s) && buf_cap(buf) == 5 + sizeof(s));
+    assert(memcmp(buf->data + 5, s, sizeof(s)) == 0);
+    /* reserved by hint */
+    assert(write(fds[1], "!", 1) == 1);
+    assert(buf_read_fd(buf, fds[0], 1000) == 1);
+    assert(buf_cap(buf) >= buf_len(buf) + 999);
+    /* eof */
+    close(fds[1]);
+    assert(buf_read_fd(buf, fds[0], 0) == 0);
+    close(fds[0]);
+    buf_free(buf);
+}
+
+void case_buf_write_fd() {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    assert(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+    struct buf *buf = buf("hello world");
+    assert(buf_write_fd(buf, fds[1]) == 11);
+    assert(buf_len(buf) == 0);
+    char s[16];
+    assert(read(fds[0], s, sizeof(s)) == 11);
+    assert(memcmp(s, "hello world", 11) == 0);
+    /* fill the pipe, the written prefix is consumed */
+    char chunk[4096];
+    memset(chunk, 'a', sizeof(chunk));
+    int i;
+    for (i = 0; i < 64; i++) buf_put(buf, chunk, sizeof(chunk));
+    ssize_t n, written = 0;
+    while ((n = buf_write_fd(buf, fds[1])) > 0) written += n;
+    assert(n == -1 && errno == EAGAIN);
+    assert(written > 0 && buf_len(buf) == 64 * sizeof(chunk) - written);
+    assert(buf->off == (size_t)written);
+    close(fds[0]);
+    close(fds[1]);
+    buf_free(buf);
+}
+
+void case_buf_share() {
+    /* heap data is taken over */
+    struct buf *buf = buf(NULL);
+    char s[100];
+    memset(s, 'a', sizeof(s));
+    assert(buf_put(buf, s, sizeof(s)) == BUF_OK);
+    buf_lrm(buf, 10);
+    char *data = buf->data;
+    struct buf_shared *shared = buf_share(buf);
+    assert(shared != NULL && shared->refs == 1);
+    assert(shared->data == data && shared->len == 90);
+    assert(buf_len(buf) == 0 && buf->data == buf->small);
+    /* the buf is reusable */
+    assert(buf_puts(buf, "abc") == BUF_OK);
+    assert(strcmp(buf_str(buf), "abc") == 0);
+    buf_shared_free(shared);
+    /* inline data is copied */
+    shared = buf_share(buf);
+    assert(shared != NULL && shared->mem == NULL);
+    assert(shared->len == 3 && memcmp(shared->data, "abc", 3) == 0);
+    buf_shared_free(shared);
+    buf_free(buf);
+}
+
+void case_buf_slice() {
+    struct buf *buf = buf("hello world, hello slices");
+    struct buf_shared *shared = buf_share(buf);
+    struct buf_slice *s1 = buf_slice(shared, 0, 5);
+    struct buf_slice *s2 = buf_slice(shared, 13, 100);
+    assert(s1 != NULL && s2 != NULL && shared->refs == 3);
+    assert(s1->len == 5 && memcmp(s1->data, "hello", 5) == 0);
+    assert(s2->len == 12 && memcmp(s2->data, "hello slices", 12) == 0);
+    /* the block lives until the last slice is freed */
+    buf_shared_free(shared);
+    assert(shared->refs == 2);
+    buf_slice_free(s1);
+    assert(shared->refs == 1);
+    buf_slice_free(s2);
+    buf_free(buf);
+}
+
+void case_buf_slice_write_fd() {
+    /* fan out one message to several fds */
+    int fds[3][2], i;
+    struct buf *buf = buf(NULL);
+    char msg[4096];
+    memset(msg, 'x', sizeof(msg));
+    assert(buf_put(buf, msg, sizeof(msg)) == BUF_OK);
+    struct buf_shared *shared = buf_share(buf);
+    struct buf_slice *slices[3];
+    for (i = 0; i < 3; i++) {
+        assert(pipe(fds[i]) == 0);
+        slices[i] = buf_slice(shared, 0, shared->len);
+    }
+    buf_shared_free(shared);
+    char s[sizeof(msg)];
+    for (i = 0; i < 3; i++) {
+        assert(buf_slice_write_fd(slices[i], fds[i][1]) == sizeof(msg));
+        assert(slices[i]->len == 0);
+        assert(buf_slice_write_fd(slices[i], fds[i][1]) == 0);
+        assert(read(fds[i][0], s, sizeof(s)) == sizeof(s));
+        assert(memcmp(s, msg, sizeof(msg)) == 0);
+        buf_slice_free(slices[i]);
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
     buf_free(buf);
 }
@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bufchain.h"
+
+void case_bufchain_put() {
+    struct bufchain *chain = bufchain_new(NULL);
+    assert(bufchain_puts(chain, "abc") == BUFCHAIN_OK);
+    assert(bufchain_len(chain) == 3 && chain->blocks == 1);
+    /* data spans blocks, and is never moved */
+    char *first = chain->head->data;
+    char s[40000];
+    memset(s, 'a', sizeof(s));
+    assert(bufchain_put(chain, s, sizeof(s)) == BUFCHAIN_OK);
+    assert(bufchain_len(chain) == 40003 && chain->blocks == 3);
+    assert(chain->head->data == first && memcmp(first, "abcaaa", 6) == 0);
+    bufchain_clear(chain);
+    assert(bufchain_len(chain) == 0 && chain->blocks == 0);
+    assert(chain->head == NULL && chain->tail == NULL);
+    bufchain_free(chain);
+}
+
+void case_bufchain_lrm() {
+    struct bufchain *chain = bufchain_new(NULL);
+    char s[40000];
+    size_t i;
+    for (i = 0; i < sizeof(s); i++) s[i] = i % 251;
+    assert(bufchain_put(chain, s, sizeof(s)) == BUFCHAIN_OK);
+    bufchain_lrm(chain, 10);
+    assert(bufchain_len(chain) == sizeof(s) - 10 && chain->blocks == 3);
+    assert(memcmp(chain->head->data + chain->head->start, s + 10, 16) == 0);
+    /* consumed blocks are freed */
+    bufchain_lrm(chain, 20000);
+    assert(bufchain_len(chain) == sizeof(s) - 20010 && chain->blocks == 2);
+    assert(memcmp(chain->head->data + chain->head->start, s + 20010, 16) ==
+           0);
+    bufchain_lrm(chain, sizeof(s));
+    assert(bufchain_len(chain) == 0 && chain->blocks == 0);
+    assert(chain->head == NULL && chain->tail == NULL);
+    /* appends after drained */
+    assert(bufchain_puts(chain, "abc") == BUFCHAIN_OK);
+    assert(bufchain_len(chain) == 3 && chain->blocks == 1);
+    bufchain_free(chain);
+}
+
+void case_bufchain_peek() {
+    struct bufchain *chain = bufchain_new(NULL);
+    struct iovec iov[4];
+    assert(bufchain_peek(chain, iov, 4) == 0);
+    char s[40000];
+    memset(s, 'a', sizeof(s));
+    assert(bufchain_put(chain, s, sizeof(s)) == BUFCHAIN_OK);
+    bufchain_lrm(chain, 100);
+    assert(bufchain_peek(chain, iov, 2) == 2);
+    assert(bufchain_peek(chain, iov, 4) == 3);
+    size_t n = 0;
+    int i;
+    for (i = 0; i < 3; i++) n += iov[i].iov_len;
+    assert(n == bufchain_len(chain));
+    assert(iov[0].iov_base == chain->head->data + 100);
+    /* not consumed */
+    assert(bufchain_len(chain) == sizeof(s) - 100);
+    bufchain_free(chain);
+}
+
+void case_bufchain_write_fd() {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    assert(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+    struct bufchain *chain = bufchain_new(NULL);
+    assert(bufchain_write_fd(chain, fds[1]) == 0);
+    assert(bufchain_puts(chain, "hello world") == BUFCHAIN_OK);
+    assert(bufchain_write_fd(chain, fds[1]) == 11);
+    assert(bufchain_len(chain) == 0);
+    char s[16];
+    assert(read(fds[0], s, sizeof(s)) == 11);
+    assert(memcmp(s, "hello world", 11) == 0);
+    /* fill the pipe, the written data is consumed */
+    char chunk[4096];
+    memset(chunk, 'a', sizeof(chunk));
+    int i;
+    for (i = 0; i < 64; i++) bufchain_put(chain, chunk, sizeof(chunk));
+    ssize_t n, written = 0;
+    while ((n = bufchain_write_fd(chain, fds[1])) > 0) written += n;
+    assert(n == -1 && errno == EAGAIN);
+    assert(written > 0 &&
+           bufchain_len(chain) == 64 * sizeof(chunk) - written);
+    close(fds[0]);
+    close(fds[1]);
+    bufchain_free(chain);
+}
+
+void case_bufchain_slab() {
+    struct alloc_slab *slab = alloc_slab_new(BUFCHAIN_BLOCK_SIZE);
+    struct bufchain *c1 = bufchain_new(&slab->alloc);
+    struct bufchain *c2 = bufchain_new(&slab->alloc);
+    assert(bufchain_puts(c1, "abc") == BUFCHAIN_OK);
+    struct bufchain_block *block = c1->head;
+    bufchain_lrm(c1, 3);
+    /* the block is reused by another chain */
+    assert(bufchain_puts(c2, "def") == BUFCHAIN_OK);
+    assert(c2->head == block);
+    bufchain_free(c1);
+    bufchain_free(c2);
+    alloc_slab_free(slab);
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cmap.h"
+
+void case_cmap_set() {
+    struct cmap *m = cmap();
+    char *val = "val";
+    char key[] = "key";
+    assert(cmap_set(m, key, val) == CMAP_OK);
+    assert(cmap_len(m) == 1);
+    /* keys are copied */
+    key[0] = 'x';
+    assert(cmap_get(m, "key") == val);
+    assert(cmap_get(m, key) == NULL);
+    assert(cmap_set(m, "key", "val2") == CMAP_OK);
+    assert(strcmp(cmap_get(m, "key"), "val2") == 0);
+    assert(cmap_len(m) == 1);
+    cmap_free(m);
+}
+
+void case_cmap_pop() {
+    struct cmap *m = cmap_new(4);
+    int i;
+    char keys[10000][6];
+    for (i = 0; i < 10000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 10000; i++)
+        assert(cmap_set(m, keys[i], keys[i]) == CMAP_OK);
+    assert(cmap_len(m) == 10000);
+    for (i = 0; i < 10000; i += 2) assert(cmap_pop(m, keys[i]) == keys[i]);
+    assert(cmap_pop(m, keys[0]) == NULL);
+    assert(cmap_len(m) == 5000);
+    for (i = 0; i < 10000; i++) {
+        assert(cmap_has(m, keys[i]) == i % 2);
+        assert(cmap_get(m, keys[i]) == (i % 2 ? keys[i] : NULL));
+    }
+    cmap_reclaim(m);
+    /* set popped keys back over the tombstones */
+    for (i = 0; i < 10000; i += 2)
+        assert(cmap_set(m, keys[i], keys[i]) == CMAP_OK);
+    for (i = 0; i < 10000; i++) assert(cmap_get(m, keys[i]) == keys[i]);
+    assert(cmap_len(m) == 10000);
+    cmap_free(m);
+}
+
+struct cmap_test_reader {
+    struct cmap *m;
+    char (*keys)[6];
+    int stop;
+    long misses;
+};
+
+static void *cmap_test_read(void *arg) {
+    struct cmap_test_reader *r = arg;
+    int i;
+    while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE))
+        for (i = 0; i < 100; i++)
+            if (cmap_get(r->m, r->keys[i]) != r->keys[i]) r->misses++;
+    return NULL;
+}
+
+void case_cmap_concurrent() {
+    struct cmap *m = cmap_new(2);
+    int i;
+    char keys[20000][6];
+    for (i = 0; i < 20000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 100; i++)
+        assert(cmap_set(m, keys[i], keys[i]) == CMAP_OK);
+    /* readers always find the keys set before, while the writer grows and
+     * churns the tables */
+    pthread_t threads[4];
+    struct cmap_test_reader readers[4];
+    for (i = 0; i < 4; i++) {
+        struct cmap_test_reader r = {m, keys, 0, 0};
+        readers[i] = r;
+        assert(pthread_create(&threads[i], NULL, &cmap_test_read,
+                              &readers[i]) == 0);
+    }
+    for (i = 100; i < 20000; i++) {
+        assert(cmap_set(m, keys[i], keys[i]) == CMAP_OK);
+        if (i % 3 == 0) assert(cmap_pop(m, keys[i]) == keys[i]);
+    }
+    for (i = 0; i < 4; i++) {
+        __atomic_store_n(&readers[i].stop, 1, __ATOMIC_RELEASE);
+        assert(pthread_join(threads[i], NULL) == 0);
+        assert(readers[i].misses == 0);
+    }
+    cmap_reclaim(m);
+    for (i = 0; i < 20000; i++)
+        assert(cmap_get(m, keys[i]) ==
+               (i >= 100 && i % 3 == 0 ? NULL : keys[i]));
+    cmap_free(m);
+}
+
+/* Get the number of retired nodes and tables not freed yet. */
+static size_t cmap_test_retired(struct cmap *m) {
+    size_t i, n = 0;
+    for (i = 0; i <= m->mask; i++) n += m->shards[i].retired;
+    return n;
+}
+
+void case_cmap_reclaim() {
+    struct cmap *m = cmap_new(4);
+    int i;
+    char keys[20000][6];
+    for (i = 0; i < 20000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 100; i++)
+        assert(cmap_set(m, keys[i], keys[i]) == CMAP_OK);
+    /* retired memory is freed while readers run */
+    pthread_t threads[4];
+    struct cmap_test_reader readers[4];
+    for (i = 0; i < 4; i++) {
+        struct cmap_test_reader r = {m, keys, 0, 0};
+        readers[i] = r;
+        assert(pthread_create(&threads[i], NULL, &cmap_test_read,
+                              &readers[i]) == 0);
+    }
+    for (i = 0; i < 100000; i++) {
+        char *key = keys[100 + i % 19900];
+        assert(cmap_set(m, key, key) == CMAP_OK);
+        assert(cmap_pop(m, key) == key);
+    }
+    assert(cmap_test_retired(m) < 100000);
+    for (i = 0; i < 4; i++) {
+        __atomic_store_n(&readers[i].stop, 1, __ATOMIC_RELEASE);
+        assert(pthread_join(threads[i], NULL) == 0);
+        assert(readers[i].misses == 0);
+    }
+    /* all of it once no thread reads */
+    cmap_reclaim(m);
+    assert(cmap_test_retired(m) == 0);
+    for (i = 0; i < 10000; i++) {
+        assert(cmap_set(m, keys[100 + i], keys[100 + i]) == CMAP_OK);
+        assert(cmap_pop(m, keys[100 + i]) == keys[100 + i]);
+        assert(cmap_test_retired(m) < 4 * CMAP_RECLAIM_BATCH);
+    }
+    for (i = 0; i < 100; i++) assert(cmap_get(m, keys[i]) == keys[i]);
+    cmap_free(m);
+}
@@ -3,6 +3,9 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "dict.h"
@@ -111,3 +114,408 @@ void case_dict_iter() {
     };
     dict_free(dict);
 }
+
+static uint64_t case_dict_collide_hash(char *key, size_t len, uint64_t seed) {
+    return 7;
+}
+
+void case_dict_hash() {
+    assert(dict_hash("key", 3, 1) == dict_hash("key", 3, 1));
+    assert(dict_hash("key", 3, 1) != dict_hash("key", 3, 2));
+    assert(dict_hash("key1", 4, 1) != dict_hash("key2", 4, 1));
+    /* all keys collide */
+    struct dict *dict = dict_new_hash(&case_dict_collide_hash);
+    int i;
+    char keys[100][4];
+    for (i = 0; i < 100; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 100; i++)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    for (i = 0; i < 100; i += 2) assert(dict_pop(dict, keys[i]) == keys[i]);
+    for (i = 0; i < 100; i++)
+        assert(dict_get(dict, keys[i]) == (i % 2 ? keys[i] : NULL));
+    dict_free(dict);
+}
+
+void case_dict_rehash() {
+    struct dict *dict = dict();
+    int i, n = 0, rehashing = 0;
+    char keys[1000][4];
+    for (i = 0; i < 1000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 1000; i++) {
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+        if (dict->old_table == NULL) continue;
+        /* iterate both tables while rehashing */
+        struct dict_iter iter = {dict};
+        struct dict_node *node = NULL;
+        n = 0;
+        dict_each(&iter, node) n++;
+        assert(n == i + 1);
+        rehashing++;
+    }
+    assert(rehashing > 0);
+    /* nodes are reachable in either table while rehashing */
+    for (i = 0; i < 1000; i++) assert(dict_get(dict, keys[i]) == keys[i]);
+    /* finish rehashing by time budget */
+    assert(dict_rehash_step(dict, 1000000) == 0);
+    assert(dict->old_table == NULL);
+    assert(dict_rehash_step(dict, 1000000) == 0);
+    for (i = 0; i < 1000; i += 2) assert(dict_pop(dict, keys[i]) == keys[i]);
+    assert(dict_len(dict) == 500);
+    dict_free(dict);
+    /* sets over the load limit while shrinking don't finish the rehashing
+     * at once, each migrates a bounded number of buckets */
+    dict = dict();
+    int m = 20000, deferred = 0;
+    char(*many)[8] = malloc(m * sizeof(*many));
+    for (i = 0; i < m; i++) sprintf(many[i], "%d", i);
+    for (i = 0; i < 16000; i++)
+        assert(dict_set(dict, many[i], many[i]) == DICT_OK);
+    for (i = 15000; i < 16000; i++)
+        assert(dict_pop(dict, many[i]) == many[i]);
+    assert(dict_rehash_step(dict, 1000000) == 0);
+    size_t old_cap = dict_cap(dict);
+    assert(dict_resize(dict, dict->idx - 1) == DICT_OK);
+    struct dict_node **shrunk = dict->old_table;
+    size_t bound = DICT_REHASH_UNIT * (1 + DICT_REHASH_BOOST) * 11;
+    double limit = DICT_LOAD_LIMIT * (1 + 1.0 / DICT_REHASH_BOOST);
+    for (i = 15000; i < m; i++) {
+        int rehashing = dict->old_table == shrunk && shrunk != NULL;
+        size_t pos = dict->rehash_pos;
+        assert(dict_set(dict, many[i], many[i]) == DICT_OK);
+        if (dict_len(dict) > dict_cap(dict) * DICT_LOAD_LIMIT) deferred++;
+        assert(dict_len(dict) <= dict_cap(dict) * limit);
+        if (!rehashing) continue;
+        if (dict->old_table == shrunk)
+            assert(dict->rehash_pos - pos <= bound);
+        else
+            assert(old_cap - pos <= bound);
+    }
+    assert(deferred > 0);
+    assert(dict_cap(dict) > 21911);
+    for (i = 0; i < m; i++) assert(dict_get(dict, many[i]) == many[i]);
+    free(many);
+    dict_free(dict);
+}
+
+void case_dict_iter_get() {
+    struct dict *dict = dict();
+    int i, n;
+    char keys[1000][4];
+    for (i = 0; i < 1000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 1000; i++) {
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+        if (dict->old_table == NULL) continue;
+        /* lookups in the loop don't move nodes under the iterator */
+        size_t rehash_pos = dict->rehash_pos;
+        struct dict_iter iter = {dict};
+        struct dict_node *node = NULL;
+        char seen[1000] = {0};
+        n = 0;
+        dict_each(&iter, node) {
+            assert(dict_get(dict, node->key) == node->val);
+            assert(dict_has(dict, keys[999 - n]) == (999 - n <= i));
+            assert(seen[atoi(node->key)]++ == 0);
+            n++;
+        }
+        assert(n == i + 1);
+        assert(dict->rehash_pos == rehash_pos);
+    }
+    dict_free(dict);
+}
+
+void case_dict_slab() {
+    struct dict *dict = dict();
+    int i;
+    char keys[100][4];
+    for (i = 0; i < 100; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 100; i++)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    struct dict_slab *slabs = dict->slabs;
+    /* popped nodes are reused */
+    for (i = 0; i < 100; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    for (i = 0; i < 100; i++)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    assert(dict->slabs == slabs);
+    for (i = 0; i < 100; i++) assert(dict_get(dict, keys[i]) == keys[i]);
+    /* all slabs are freed on clear */
+    dict_clear(dict);
+    assert(dict->slabs == NULL && dict_len(dict) == 0);
+    assert(dict_set(dict, keys[0], keys[0]) == DICT_OK);
+    assert(dict_get(dict, keys[0]) == keys[0]);
+    dict_free(dict);
+}
+
+static void dict_scan_count(struct dict_node *node, void *data) {
+    (void)data;
+    (*(int *)node->val)++;
+}
+
+void case_dict_scan() {
+    struct dict *dict = dict();
+    int i, seen[2000] = {0};
+    char keys[2000][5];
+    for (i = 0; i < 2000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 500; i++)
+        assert(dict_set(dict, keys[i], &seen[i]) == DICT_OK);
+    /* each node once without resizing */
+    size_t cursor = 0;
+    do {
+        cursor = dict_scan(dict, cursor, 10, &dict_scan_count, NULL);
+    } while (cursor != 0);
+    for (i = 0; i < 500; i++) assert(seen[i] == 1);
+    /* nodes present all along are visited while resizing */
+    memset(seen, 0, sizeof(seen));
+    size_t cap = dict_cap(dict);
+    i = 500;
+    do {
+        cursor = dict_scan(dict, cursor, 1, &dict_scan_count, NULL);
+        if (i < 2000) assert(dict_set(dict, keys[i], &seen[i]) == DICT_OK);
+        i++;
+    } while (cursor != 0);
+    assert(dict_cap(dict) > cap);
+    for (i = 0; i < 500; i++) assert(seen[i] >= 1);
+    dict_free(dict);
+}
+
+void case_dict_shrink() {
+    struct dict *dict = dict();
+    int i;
+    char keys[1000][4];
+    for (i = 0; i < 1000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 1000; i++)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    size_t cap = dict_cap(dict);
+    /* shrinks as nodes are popped */
+    for (i = 0; i < 990; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    assert(dict_cap(dict) < cap);
+    for (i = 990; i < 1000; i++) assert(dict_get(dict, keys[i]) == keys[i]);
+    /* no flapping around the limit: one more node doesn't grow it back */
+    cap = dict_cap(dict);
+    assert(dict_set(dict, keys[0], keys[0]) == DICT_OK);
+    assert(dict_pop(dict, keys[0]) == keys[0]);
+    assert(dict_set(dict, keys[0], keys[0]) == DICT_OK);
+    assert(dict_cap(dict) == cap);
+    assert(dict_pop(dict, keys[0]) == keys[0]);
+    /* shrink to fit */
+    for (i = 0; i < 500; i++)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    for (i = 0; i < 300; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    cap = dict_cap(dict);
+    assert(dict_shrink_to_fit(dict) == DICT_OK);
+    assert(dict_cap(dict) < cap);
+    assert(dict_cap(dict) * DICT_LOAD_LIMIT >= dict_len(dict));
+    for (i = 300; i < 500; i++) assert(dict_get(dict, keys[i]) == keys[i]);
+    for (i = 990; i < 1000; i++) assert(dict_get(dict, keys[i]) == keys[i]);
+    assert(dict_len(dict) == 210);
+    dict_free(dict);
+    /* never shrinks under limit 0 */
+    dict = dict();
+    dict_set_shrink_limit(dict, 0);
+    for (i = 0; i < 1000; i++)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    cap = dict_cap(dict);
+    for (i = 0; i < 1000; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    assert(dict_cap(dict) == cap);
+    /* shrinks later under a lower limit */
+    dict_set_shrink_limit(dict, 0.05);
+    for (i = 0; i < 1000; i++)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    for (i = 0; i < 850; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    assert(dict_cap(dict) == cap);
+    for (i = 850; i < 1000; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    assert(dict_cap(dict) < cap);
+    dict_free(dict);
+    /* uneven step 17 -> 7: shrinks only once the nodes are under half the
+     * load limit of 7, not at 17 * 0.35 where a set would grow it back */
+    dict = dict();
+    dict_set_shrink_limit(dict, 0.35);
+    for (i = 0; i < 6; i++) assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    assert(dict_rehash_step(dict, 1000000) == 0);
+    assert(dict_cap(dict) == 17);
+    for (i = 0; i < 3; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    assert(dict_cap(dict) == 17);
+    assert(dict_pop(dict, keys[3]) == keys[3]);
+    assert(dict_cap(dict) == 7);
+    assert(dict_set(dict, keys[0], keys[0]) == DICT_OK);
+    assert(dict_set(dict, keys[1], keys[1]) == DICT_OK);
+    assert(dict_cap(dict) == 7);
+    dict_free(dict);
+}
+
+void case_dict_entry() {
+    struct dict *dict = dict();
+    int i, inserted;
+    char keys[100][4];
+    for (i = 0; i < 100; i++) sprintf(keys[i], "%d", i);
+    /* count keys */
+    for (i = 0; i < 1000; i++) {
+        void **val = dict_entry(dict, keys[i % 100], &inserted);
+        assert(val != NULL);
+        assert(inserted == (i < 100));
+        assert(inserted == (*val == NULL));
+        *val = (void *)((intptr_t)*val + 1);
+    }
+    assert(dict_len(dict) == 100);
+    for (i = 0; i < 100; i++)
+        assert((intptr_t)dict_get(dict, keys[i]) == 10);
+    assert(dict_ientry(dict, "10x", 2, NULL) != NULL);
+    assert((intptr_t)dict_get(dict, "10") == 10);
+    assert(dict_len(dict) == 100);
+    dict_free(dict);
+}
+
+void case_dict_iget_many() {
+    struct dict *dict = dict();
+    size_t i, lens[200];
+    char keys[200][5], *ptrs[200];
+    void *vals[200];
+    for (i = 0; i < 200; i++) {
+        sprintf(keys[i], "%zu", i);
+        ptrs[i] = keys[i];
+        lens[i] = strlen(keys[i]);
+    }
+    for (i = 0; i < 200; i += 2)
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    assert(dict_iget_many(dict, ptrs, lens, 200, vals) == 100);
+    for (i = 0; i < 200; i++) assert(vals[i] == (i % 2 ? NULL : keys[i]));
+    assert(dict_iget_many(dict, ptrs, lens, 0, NULL) == 0);
+    dict_free(dict);
+}
+
+/* Allocator out of memory. */
+static void *dict_test_nomem(void *ctx, size_t size) { return NULL; }
+
+void case_dict_owned() {
+    struct dict *dict = dict_new_owned();
+    int i;
+    char key[8];
+    /* keys are copied, the buffer is reused */
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "%d", i);
+        assert(dict_set(dict, key, NULL) == DICT_OK);
+    }
+    assert(dict_len(dict) == 1000);
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "%d", i);
+        assert(dict_has(dict, key));
+    }
+    /* popped keys leave holes in the arena until compaction */
+    for (i = 0; i < 900; i++) {
+        sprintf(key, "%d", i);
+        assert(dict_pop(dict, key) == NULL);
+    }
+    for (i = 1000; i < 3000; i++) {
+        sprintf(key, "%d", i);
+        assert(dict_set(dict, key, NULL) == DICT_OK);
+    }
+    assert(dict->keys.live < dict->keys.len);
+    assert(dict_shrink_to_fit(dict) == DICT_OK);
+    assert(dict->keys.len == dict->keys.live);
+    /* keys are NULL-terminated in the arena */
+    struct dict_iter iter = {dict};
+    struct dict_node *node = NULL;
+    int n = 0;
+    dict_each(&iter, node) {
+        assert(strlen(node->key) == node->len);
+        n++;
+    }
+    assert(n == 2100);
+    /* set with a key in the arena */
+    struct dict_iter it = {dict};
+    node = dict_iter_next(&it);
+    assert(dict_set(dict, node->key, "val") == DICT_OK);
+    assert(strcmp(dict_get(dict, node->key), "val") == 0);
+    assert(dict_len(dict) == 2100);
+    for (i = 0; i < 3000; i++) {
+        sprintf(key, "%d", i);
+        assert(dict_has(dict, key) == (i >= 900));
+    }
+    /* keys never move on set, blocks are freed once their keys are popped */
+    char *first = node->key;
+    for (i = 100000; i < 200000; i++) {
+        sprintf(key, "%d", i);
+        assert(dict_set(dict, key, NULL) == DICT_OK);
+        sprintf(key, "%d", i - 100);
+        assert(dict_pop(dict, key) == NULL);
+    }
+    assert(dict_get(dict, first) != NULL);
+    assert(dict->keys.cap < 2200 * 8 + 4 * MAP_KEYS_BLOCK);
+    /* a key larger than a block takes a block of its own */
+    char *big = malloc(3 * MAP_KEYS_BLOCK);
+    memset(big, 'k', 3 * MAP_KEYS_BLOCK - 1);
+    big[3 * MAP_KEYS_BLOCK - 1] = 0;
+    assert(dict_set(dict, big, "big") == DICT_OK);
+    assert(strcmp(dict_get(dict, big), "big") == 0);
+    assert(dict_set(dict, "small", "small") == DICT_OK);
+    assert(strcmp(dict_pop(dict, big), "big") == 0);
+    assert(strcmp(dict_get(dict, "small"), "small") == 0);
+    free(big);
+    dict_free(dict);
+    /* the key copied is dropped if no node can be created */
+    struct alloc nomem = {&dict_test_nomem, NULL, NULL, NULL};
+    dict = dict_new_alloc(&nomem);
+    dict->own = 1;
+    assert(dict_set(dict, "key", "val") == DICT_ENOMEM);
+    assert(dict->keys.live == 0 && dict_len(dict) == 0);
+    /* nothing is reported inserted on no memory */
+    int inserted = 1;
+    assert(dict_entry(dict, "key", &inserted) == NULL && inserted == 0);
+    dict_free(dict);
+}
+
+void case_dict_stats() {
+    struct dict *dict = dict();
+    struct dict_stats stats;
+    dict_stats(dict, &stats);
+    assert(stats.cap == dict_cap(dict) && stats.len == 0);
+    assert(stats.chains[0] == stats.cap && stats.chain_max == 0);
+    int i;
+    char keys[1000][4];
+    for (i = 0; i < 1000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 1000; i++)
+        assert(dict_set(dict, keys[i], NULL) == DICT_OK);
+    dict_stats(dict, &stats);
+    assert(stats.cap == dict_cap(dict) && stats.len == 1000);
+    assert(stats.load > 0 && stats.chain_avg >= 1);
+    assert(stats.bytes > 1000 * sizeof(struct dict_node));
+    /* nodes in the chains, old table included */
+    size_t n = 0;
+    for (i = 1; i < DICT_STATS_BINS; i++) n += i * stats.chains[i];
+    assert(stats.chain_max < DICT_STATS_BINS && n == 1000);
+    /* counting lookups */
+    dict_stats_counting(dict, 1);
+    for (i = 0; i < 1000; i++) assert(dict_has(dict, keys[i]));
+    dict_stats(dict, &stats);
+    assert(stats.lookups == 1000 && stats.probes_avg >= 1);
+    dict_stats_counting(dict, 0);
+    dict_free(dict);
+    /* a bad hash shows */
+    dict = dict_new_hash(&case_dict_collide_hash);
+    for (i = 0; i < 100; i++)
+        assert(dict_set(dict, keys[i], NULL) == DICT_OK);
+    while (dict_rehash_step(dict, 1000))
+        ;
+    dict_stats(dict, &stats);
+    assert(stats.chain_max == 100 && stats.chain_avg == 100);
+    assert(stats.chains[DICT_STATS_BINS - 1] == 1);
+    dict_free(dict);
+}
+
+void case_dict_huge() {
+    struct dict *dict = dict_new_huge();
+    int i, n = 200000;
+    char(*keys)[8] = malloc(n * sizeof(*keys));
+    for (i = 0; i < n; i++) {
+        sprintf(keys[i], "%d", i);
+        assert(dict_set(dict, keys[i], keys[i]) == DICT_OK);
+    }
+    /* the table is larger than a huge page */
+    assert(dict_cap(dict) * sizeof(struct dict_node *) >= ALLOC_HUGE_PAGE);
+    assert((uintptr_t)dict->table % ALLOC_HUGE_PAGE == 0);
+    for (i = 0; i < n; i++) assert(dict_get(dict, keys[i]) == keys[i]);
+    /* shrinks back to libc */
+    for (i = 0; i < n - 10; i++) assert(dict_pop(dict, keys[i]) == keys[i]);
+    assert(dict_len(dict) == 10 && dict_get(dict, keys[n - 1]) == keys[n - 1]);
+    dict_free(dict);
+    free(keys);
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dict.h"
+#include "hashfile.h"
+#include "map.h"
+
+#define HASHFILE_TEST_PATH "hashfile_test.db"
+
+static size_t hashfile_test_vlen(void *val) { return sizeof(uint64_t); }
+
+void case_hashfile_map() {
+    struct map *m = map_new_owned();
+    int i;
+    char key[8], val[8];
+    for (i = 0; i < 10000; i++) {
+        sprintf(key, "%d", i);
+        assert(map_set(m, key, i % 2 ? "odd" : "even") == MAP_OK);
+    }
+    assert(map_set(m, "null", NULL) == MAP_OK);
+    assert(hashfile_dump_map(m, HASHFILE_TEST_PATH, NULL) == HASHFILE_OK);
+    map_free(m);
+    /* vals point into the file */
+    struct hashfile *hf = hashfile_open(HASHFILE_TEST_PATH);
+    assert(hf != NULL);
+    assert(hashfile_len(hf) == 10001);
+    for (i = 0; i < 10000; i++) {
+        sprintf(key, "%d", i);
+        assert(strcmp(hashfile_get(hf, key), i % 2 ? "odd" : "even") == 0);
+    }
+    size_t vlen = 1;
+    assert(strcmp(hashfile_iget(hf, "null", 4, &vlen), "") == 0);
+    assert(vlen == 0);
+    assert(hashfile_iget(hf, "nul", 3, NULL) == NULL);
+    sprintf(val, "%d", 10000);
+    assert(hashfile_get(hf, val) == NULL);
+    hashfile_close(hf);
+    assert(unlink(HASHFILE_TEST_PATH) == 0);
+}
+
+void case_hashfile_dict() {
+    struct dict *dict = dict();
+    assert(dict_set(dict, "key1", "val1") == DICT_OK);
+    assert(dict_set(dict, "key2", "val2") == DICT_OK);
+    assert(hashfile_dump_dict(dict, HASHFILE_TEST_PATH, NULL) == HASHFILE_OK);
+    dict_free(dict);
+    struct hashfile *hf = hashfile_open(HASHFILE_TEST_PATH);
+    assert(hf != NULL);
+    assert(hashfile_len(hf) == 2);
+    assert(strcmp(hashfile_get(hf, "key1"), "val1") == 0);
+    assert(strcmp(hashfile_get(hf, "key2"), "val2") == 0);
+    assert(hashfile_get(hf, "key3") == NULL);
+    hashfile_close(hf);
+    assert(unlink(HASHFILE_TEST_PATH) == 0);
+}
+
+void case_hashfile_vlen() {
+    struct dict *dict = dict();
+    uint64_t vals[2] = {0, (uint64_t)1 << 40};
+    assert(dict_set(dict, "key1", &vals[0]) == DICT_OK);
+    assert(dict_set(dict, "key2", &vals[1]) == DICT_OK);
+    assert(dict_set(dict, "null", NULL) == DICT_OK);
+    /* binary vals, not cut at the first zero byte */
+    assert(hashfile_dump_dict(dict, HASHFILE_TEST_PATH,
+                              &hashfile_test_vlen) == HASHFILE_OK);
+    dict_free(dict);
+    struct hashfile *hf = hashfile_open(HASHFILE_TEST_PATH);
+    assert(hf != NULL);
+    size_t vlen;
+    char *val = hashfile_iget(hf, "key1", 4, &vlen);
+    assert(val != NULL && vlen == 8 && memcmp(val, &vals[0], 8) == 0);
+    val = hashfile_iget(hf, "key2", 4, &vlen);
+    assert(val != NULL && vlen == 8 && memcmp(val, &vals[1], 8) == 0);
+    assert(hashfile_iget(hf, "null", 4, &vlen) != NULL && vlen == 0);
+    hashfile_close(hf);
+    assert(unlink(HASHFILE_TEST_PATH) == 0);
+}
+
+void case_hashfile_writer() {
+    struct hashfile_writer *w = hashfile_writer_new(HASHFILE_TEST_PATH);
+    assert(w != NULL);
+    /* binary keys and vals */
+    assert(hashfile_writer_put(w, "a\0b", 3, "x\0y", 3) == HASHFILE_OK);
+    assert(hashfile_writer_put(w, "", 0, NULL, 0) == HASHFILE_OK);
+    /* the file shows up on close */
+    assert(access(HASHFILE_TEST_PATH, F_OK) != 0);
+    assert(hashfile_writer_close(w) == HASHFILE_OK);
+    struct hashfile *hf = hashfile_open(HASHFILE_TEST_PATH);
+    assert(hf != NULL);
+    size_t vlen;
+    assert(memcmp(hashfile_iget(hf, "a\0b", 3, &vlen), "x\0y", 4) == 0);
+    assert(vlen == 3);
+    assert(hashfile_iget(hf, "", 0, &vlen) != NULL && vlen == 0);
+    assert(hashfile_iget(hf, "a", 1, NULL) == NULL);
+    size_t cap = hf->head->cap, slots = hf->head->slots;
+    hashfile_close(hf);
+    /* corrupted: no empty slot left, lookups still end */
+    FILE *fp = fopen(HASHFILE_TEST_PATH, "r+b");
+    assert(fp != NULL && fseek(fp, slots, SEEK_SET) == 0);
+    struct hashfile_slot full = {1, sizeof(struct hashfile_header)};
+    size_t i;
+    for (i = 0; i < cap; i++) assert(fwrite(&full, sizeof(full), 1, fp) == 1);
+    fclose(fp);
+    hf = hashfile_open(HASHFILE_TEST_PATH);
+    assert(hf != NULL);
+    assert(hashfile_iget(hf, "a", 1, NULL) == NULL);
+    hashfile_close(hf);
+    /* not a hash file */
+    fp = fopen(HASHFILE_TEST_PATH, "w");
+    assert(fp != NULL);
+    fputs("not a hash file, not a hash file, not a hash file", fp);
+    fclose(fp);
+    assert(hashfile_open(HASHFILE_TEST_PATH) == NULL);
+    assert(hashfile_open("not_exist.db") == NULL);
+    assert(unlink(HASHFILE_TEST_PATH) == 0);
+}
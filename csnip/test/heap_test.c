@@ -3,6 +3,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include "heap.h"
 
@@ -134,3 +135,48 @@ void case_heap_repalce() {
     assert(4 == *(int *)heap_pop(heap));
     heap_free(heap);
 }
+
+struct heap_timer {
+    long fire_at;
+    int id;
+};
+
+#define heap_timer_less(a, b) ((a).fire_at < (b).fire_at)
+HEAP_DEFINE(heap_timers, struct heap_timer, heap_timer_less)
+
+void case_heap_define() {
+    struct heap_timers *heap = heap_timers_new();
+    assert(heap_timers_top(heap) == NULL);
+    assert(heap_timers_pop(heap, NULL) == 0);
+    int i;
+    for (i = 0; i < 1000; i++) {
+        struct heap_timer timer = {(i * 7919) % 1000, i};
+        assert(heap_timers_push(heap, timer) == HEAP_OK);
+    }
+    assert(heap_timers_len(heap) == 1000);
+    assert(heap_timers_cap(heap) >= 1000);
+    assert(heap_timers_top(heap)->fire_at == 0);
+    /* popped in order */
+    struct heap_timer timer;
+    for (i = 0; i < 1000; i++) {
+        assert(heap_timers_pop(heap, &timer) == 1);
+        assert(timer.fire_at == i);
+        assert((timer.id * 7919) % 1000 == i);
+    }
+    assert(heap_timers_len(heap) == 0);
+    heap_timers_free(heap);
+}
+
+void case_heap_huge() {
+    struct heap *heap = heap_new_huge(heap_cmp);
+    int i, n = 400000;
+    int *nums = malloc(n * sizeof(int));
+    for (i = 0; i < n; i++) {
+        nums[i] = (long)i * 7919 % n;
+        assert(heap_push(heap, &nums[i]) == HEAP_OK);
+    }
+    assert(heap_cap(heap) * sizeof(void *) >= ALLOC_HUGE_PAGE);
+    for (i = 0; i < n; i++) assert(*(int *)heap_pop(heap) == i);
+    heap_free(heap);
+    free(nums);
+}
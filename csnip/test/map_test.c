@@ -3,8 +3,13 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
 #include "map.h"
 #include "strings.h"
 
@@ -95,3 +100,361 @@ void case_map_iter() {
     map_iter_free(iter);
     map_free(m);
 }
+
+void case_map_churn() {
+    struct map *m = map();
+    int i, j;
+    char keys[1000][8];
+    for (i = 0; i < 1000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 1000; i++) assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    /* pop and set back in rounds, all keys left should be reachable */
+    for (j = 0; j < 10; j++) {
+        for (i = j % 3; i < 1000; i += 3)
+            assert(map_pop(m, keys[i]) == keys[i]);
+        for (i = 0; i < 1000; i++) {
+            if (i % 3 == j % 3)
+                assert(map_get(m, keys[i]) == NULL);
+            else
+                assert(map_get(m, keys[i]) == keys[i]);
+        }
+        for (i = j % 3; i < 1000; i += 3)
+            assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+        assert(map_len(m) == 1000);
+    }
+    map_free(m);
+}
+
+static uint64_t case_map_collide_hash(char *key, size_t len, uint64_t seed) {
+    return 7;
+}
+
+void case_map_hash() {
+    assert(map_hash("key", 3, 1) == map_hash("key", 3, 1));
+    assert(map_hash("key", 3, 1) != map_hash("key", 3, 2));
+    assert(map_hash("key1", 4, 1) != map_hash("key2", 4, 1));
+    /* all keys collide */
+    struct map *m = map_new_hash(&case_map_collide_hash);
+    int i;
+    char keys[100][4];
+    for (i = 0; i < 100; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 100; i++) assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    for (i = 0; i < 100; i += 2) assert(map_pop(m, keys[i]) == keys[i]);
+    for (i = 0; i < 100; i++)
+        assert(map_get(m, keys[i]) == (i % 2 ? keys[i] : NULL));
+    map_free(m);
+}
+
+static void map_scan_count(struct map_node *node, void *data) {
+    (void)data;
+    (*(int *)node->val)++;
+}
+
+void case_map_scan() {
+    struct map *m = map();
+    int i, seen[2000] = {0};
+    char keys[2000][5];
+    for (i = 0; i < 2000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 500; i++)
+        assert(map_set(m, keys[i], &seen[i]) == MAP_OK);
+    /* each node once without resizing */
+    size_t cursor = 0;
+    do {
+        cursor = map_scan(m, cursor, 10, &map_scan_count, NULL);
+    } while (cursor != 0);
+    for (i = 0; i < 500; i++) assert(seen[i] == 1);
+    /* nodes present all along are visited while resizing */
+    memset(seen, 0, sizeof(seen));
+    size_t cap = map_cap(m);
+    i = 500;
+    do {
+        cursor = map_scan(m, cursor, 1, &map_scan_count, NULL);
+        if (i < 2000) assert(map_set(m, keys[i], &seen[i]) == MAP_OK);
+        i++;
+    } while (cursor != 0);
+    assert(map_cap(m) > cap);
+    for (i = 0; i < 500; i++) assert(seen[i] >= 1);
+    map_free(m);
+}
+
+void case_map_shrink() {
+    struct map *m = map();
+    int i;
+    char keys[1000][4];
+    for (i = 0; i < 1000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 1000; i++)
+        assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    size_t cap = map_cap(m);
+    /* shrinks as nodes are popped */
+    for (i = 0; i < 990; i++) assert(map_pop(m, keys[i]) == keys[i]);
+    assert(map_cap(m) < cap);
+    for (i = 990; i < 1000; i++) assert(map_get(m, keys[i]) == keys[i]);
+    /* no flapping around the limit: one more node doesn't grow it back */
+    cap = map_cap(m);
+    assert(map_set(m, keys[0], keys[0]) == MAP_OK);
+    assert(map_pop(m, keys[0]) == keys[0]);
+    assert(map_set(m, keys[0], keys[0]) == MAP_OK);
+    assert(map_cap(m) == cap);
+    assert(map_pop(m, keys[0]) == keys[0]);
+    /* shrink to fit */
+    for (i = 0; i < 500; i++)
+        assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    for (i = 0; i < 300; i++) assert(map_pop(m, keys[i]) == keys[i]);
+    cap = map_cap(m);
+    assert(map_shrink_to_fit(m) == MAP_OK);
+    assert(map_cap(m) < cap);
+    assert(map_cap(m) * MAP_LOAD_LIMIT >= map_len(m));
+    for (i = 300; i < 500; i++) assert(map_get(m, keys[i]) == keys[i]);
+    for (i = 990; i < 1000; i++) assert(map_get(m, keys[i]) == keys[i]);
+    assert(map_len(m) == 210);
+    map_free(m);
+    /* never shrinks under limit 0 */
+    m = map();
+    map_set_shrink_limit(m, 0);
+    for (i = 0; i < 1000; i++)
+        assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    cap = map_cap(m);
+    for (i = 0; i < 1000; i++) assert(map_pop(m, keys[i]) == keys[i]);
+    assert(map_cap(m) == cap);
+    /* shrinks later under a lower limit */
+    map_set_shrink_limit(m, 0.05);
+    for (i = 0; i < 1000; i++)
+        assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    for (i = 0; i < 850; i++) assert(map_pop(m, keys[i]) == keys[i]);
+    assert(map_cap(m) == cap);
+    for (i = 850; i < 1000; i++) assert(map_pop(m, keys[i]) == keys[i]);
+    assert(map_cap(m) < cap);
+    map_free(m);
+}
+
+void case_map_entry() {
+    struct map *m = map();
+    int i, inserted;
+    char keys[100][4];
+    for (i = 0; i < 100; i++) sprintf(keys[i], "%d", i);
+    /* count keys */
+    for (i = 0; i < 1000; i++) {
+        void **val = map_entry(m, keys[i % 100], &inserted);
+        assert(val != NULL);
+        assert(inserted == (i < 100));
+        assert(inserted == (*val == NULL));
+        *val = (void *)((intptr_t)*val + 1);
+    }
+    assert(map_len(m) == 100);
+    for (i = 0; i < 100; i++)
+        assert((intptr_t)map_get(m, keys[i]) == 10);
+    assert(map_ientry(m, "10x", 2, NULL) != NULL);
+    assert((intptr_t)map_get(m, "10") == 10);
+    assert(map_len(m) == 100);
+    map_free(m);
+}
+
+void case_map_iget_many() {
+    struct map *m = map();
+    size_t i, lens[200];
+    char keys[200][5], *ptrs[200];
+    void *vals[200];
+    for (i = 0; i < 200; i++) {
+        sprintf(keys[i], "%zu", i);
+        ptrs[i] = keys[i];
+        lens[i] = strlen(keys[i]);
+    }
+    for (i = 0; i < 200; i += 2)
+        assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    assert(map_iget_many(m, ptrs, lens, 200, vals) == 100);
+    for (i = 0; i < 200; i++) assert(vals[i] == (i % 2 ? NULL : keys[i]));
+    assert(map_iget_many(m, ptrs, lens, 0, NULL) == 0);
+    map_free(m);
+}
+
+void case_map_owned() {
+    struct map *m = map_new_owned();
+    int i;
+    char key[8];
+    /* keys are copied, the buffer is reused */
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "%d", i);
+        assert(map_set(m, key, NULL) == MAP_OK);
+    }
+    assert(map_len(m) == 1000);
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "%d", i);
+        assert(map_has(m, key));
+    }
+    /* popped keys leave holes in the arena until compaction */
+    for (i = 0; i < 900; i++) {
+        sprintf(key, "%d", i);
+        assert(map_pop(m, key) == NULL);
+    }
+    for (i = 1000; i < 3000; i++) {
+        sprintf(key, "%d", i);
+        assert(map_set(m, key, NULL) == MAP_OK);
+    }
+    assert(m->keys.live < m->keys.len);
+    assert(map_shrink_to_fit(m) == MAP_OK);
+    assert(m->keys.len == m->keys.live);
+    /* keys are NULL-terminated in the arena */
+    struct map_iter iter = {m};
+    struct map_node *node = NULL;
+    int n = 0;
+    map_each(&iter, node) {
+        assert(strlen(node->key) == node->len);
+        n++;
+    }
+    assert(n == 2100);
+    /* set with a key in the arena */
+    struct map_iter it = {m};
+    node = map_iter_next(&it);
+    assert(map_set(m, node->key, "val") == MAP_OK);
+    assert(strcmp(map_get(m, node->key), "val") == 0);
+    assert(map_len(m) == 2100);
+    for (i = 0; i < 3000; i++) {
+        sprintf(key, "%d", i);
+        assert(map_has(m, key) == (i >= 900));
+    }
+    /* keys never move on set, blocks are freed once their keys are popped */
+    char *first = node->key;
+    for (i = 100000; i < 200000; i++) {
+        sprintf(key, "%d", i);
+        assert(map_set(m, key, NULL) == MAP_OK);
+        sprintf(key, "%d", i - 100);
+        assert(map_pop(m, key) == NULL);
+    }
+    assert(map_get(m, first) != NULL);
+    assert(m->keys.cap < 2200 * 8 + 4 * MAP_KEYS_BLOCK);
+    /* a key larger than a block takes a block of its own */
+    char *big = malloc(3 * MAP_KEYS_BLOCK);
+    memset(big, 'k', 3 * MAP_KEYS_BLOCK - 1);
+    big[3 * MAP_KEYS_BLOCK - 1] = 0;
+    assert(map_set(m, big, "big") == MAP_OK);
+    assert(strcmp(map_get(m, big), "big") == 0);
+    assert(map_set(m, "small", "small") == MAP_OK);
+    assert(strcmp(map_pop(m, big), "big") == 0);
+    assert(strcmp(map_get(m, "small"), "small") == 0);
+    free(big);
+    map_free(m);
+}
+
+void case_map_stats() {
+    struct map *m = map();
+    struct map_stats stats;
+    map_stats(m, &stats);
+    assert(stats.cap == 0 && stats.len == 0 && stats.cluster_max == 0);
+    int i;
+    char keys[1000][4];
+    for (i = 0; i < 1000; i++) sprintf(keys[i], "%d", i);
+    for (i = 0; i < 1000; i++) assert(map_set(m, keys[i], NULL) == MAP_OK);
+    map_stats(m, &stats);
+    assert(stats.cap == map_cap(m) && stats.len == 1000);
+    assert(stats.load > 0 && stats.load <= MAP_LOAD_LIMIT);
+    assert(stats.cluster_max >= 1 && stats.cluster_max < stats.cap);
+    assert(stats.bytes > stats.cap * sizeof(struct map_node));
+    size_t n = 0;
+    for (i = 0; i < MAP_STATS_BINS; i++) n += stats.dists[i];
+    assert(n == 1000);
+    assert(stats.lookups == 0 && stats.probes_avg == 0);
+    /* counting lookups */
+    map_stats_counting(m, 1);
+    for (i = 0; i < 1000; i++) assert(map_has(m, keys[i]));
+    assert(map_get(m, "not exist") == NULL);
+    map_stats(m, &stats);
+    assert(stats.lookups == 1001);
+    assert(stats.probes_avg >= 1 && stats.probes_avg < 2);
+    map_stats_counting(m, 0);
+    assert(map_has(m, keys[0]));
+    map_stats(m, &stats);
+    assert(stats.lookups == 0);
+    map_free(m);
+    /* a bad hash shows */
+    m = map_new_hash(&case_map_collide_hash);
+    for (i = 0; i < 100; i++) assert(map_set(m, keys[i], NULL) == MAP_OK);
+    map_stats(m, &stats);
+    assert(stats.dist_max == 99 && stats.cluster_max == 100);
+    assert(stats.dists[MAP_STATS_BINS - 1] == 100 - MAP_STATS_BINS + 1);
+    map_free(m);
+}
+
+#define map_int_hash(key) ((uint64_t)(key))
+#define map_int_eq(a, b) ((a) == (b))
+MAP_DEFINE(map_ints, int, long, map_int_hash, map_int_eq)
+
+void case_map_define() {
+    struct map_ints *m = map_ints_new();
+    assert(map_ints_get(m, 1) == NULL);
+    assert(map_ints_pop(m, 1, NULL) == 0);
+    int i;
+    for (i = 0; i < 10000; i++) assert(map_ints_set(m, i, i * 2) == MAP_OK);
+    assert(map_ints_len(m) == 10000);
+    assert(map_ints_cap(m) * MAP_LOAD_LIMIT >= 10000);
+    for (i = 0; i < 10000; i++) assert(*map_ints_get(m, i) == i * 2);
+    assert(map_ints_get(m, 10000) == NULL);
+    /* set an existing key */
+    assert(map_ints_set(m, 1, 3) == MAP_OK);
+    assert(*map_ints_get(m, 1) == 3);
+    assert(map_ints_len(m) == 10000);
+    /* pop shifts back the following keys */
+    long val;
+    for (i = 0; i < 10000; i += 2) {
+        assert(map_ints_pop(m, i, &val) == 1);
+        assert(val == i * 2);
+    }
+    assert(map_ints_len(m) == 5000);
+    for (i = 0; i < 10000; i++) assert(map_ints_has(m, i) == i % 2);
+    /* iterate */
+    struct map_ints_iter iter = {m};
+    struct map_ints_node *node;
+    int n = 0;
+    while ((node = map_ints_iter_next(&iter)) != NULL) {
+        assert(node->key % 2 == 1);
+        n++;
+    }
+    assert(n == 5000);
+    map_ints_clear(m);
+    assert(map_ints_len(m) == 0 && map_ints_get(m, 1) == NULL);
+    map_ints_free(m);
+}
+
+void case_map_huge() {
+    struct map *m = map_new_huge();
+    int i, n = 300000;
+    char(*keys)[8] = malloc(n * sizeof(*keys));
+    for (i = 0; i < n; i++) {
+        sprintf(keys[i], "%d", i);
+        assert(map_set(m, keys[i], keys[i]) == MAP_OK);
+    }
+    /* the table is larger than a huge page */
+    assert(map_cap(m) * sizeof(struct map_node) >= ALLOC_HUGE_PAGE);
+    assert((uintptr_t)m->table % ALLOC_HUGE_PAGE == 0);
+    for (i = 0; i < n; i++) assert(map_get(m, keys[i]) == keys[i]);
+    /* shrinks back to libc */
+    for (i = 0; i < n - 10; i++) assert(map_pop(m, keys[i]) == keys[i]);
+    assert(map_len(m) == 10 && map_get(m, keys[n - 1]) == keys[n - 1]);
+    map_free(m);
+    free(keys);
+}
+
+#define MAP_TEST_SEEDS 1000 /* seeds taken by each thread */
+
+static void *map_test_seeds(void *arg) {
+    uint64_t *seeds = arg;
+    int i;
+    for (i = 0; i < MAP_TEST_SEEDS; i++) seeds[i] = map_seed();
+    return NULL;
+}
+
+static int map_test_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+void case_map_seed() {
+    /* seeds taken by threads at once are all distinct */
+    static uint64_t seeds[4 * MAP_TEST_SEEDS];
+    pthread_t threads[4];
+    int i;
+    for (i = 0; i < 4; i++)
+        assert(pthread_create(&threads[i], NULL, &map_test_seeds,
+                              seeds + i * MAP_TEST_SEEDS) == 0);
+    for (i = 0; i < 4; i++) assert(pthread_join(threads[i], NULL) == 0);
+    qsort(seeds, 4 * MAP_TEST_SEEDS, sizeof(uint64_t), &map_test_cmp_u64);
+    for (i = 1; i < 4 * MAP_TEST_SEEDS; i++) assert(seeds[i] != seeds[i - 1]);
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mph.h"
+
+#define MPH_TEST_PATH "mph_test.db"
+
+/* Test if mph maps keys to distinct indexes in [0, n). */
+static int mph_test_bijective(struct mph *m, char **keys, size_t n) {
+    char *seen = calloc(n + 1, 1);
+    size_t i;
+    int ok = 1;
+    for (i = 0; i < n && ok; i++) {
+        size_t idx = mph_index(m, keys[i]);
+        ok = idx < n && !seen[idx];
+        if (ok) seen[idx] = 1;
+    }
+    free(seen);
+    return ok;
+}
+
+void case_mph_index() {
+    char keys[10000][8];
+    char *ptrs[10000];
+    size_t n;
+    for (n = 0; n < 10000; n++) {
+        sprintf(keys[n], "%zu", n);
+        ptrs[n] = keys[n];
+    }
+    /* small sets and a large one */
+    size_t sizes[] = {0, 1, 2, 3, 5, 6, 100, 10000};
+    size_t i;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        struct mph *m = mph_new(ptrs, NULL, sizes[i]);
+        assert(m != NULL);
+        assert(mph_len(m) == sizes[i]);
+        assert(mph_test_bijective(m, ptrs, sizes[i]));
+        /* no index to give in an empty set */
+        if (sizes[i] == 0) assert(mph_index(m, "0") == MPH_NONE);
+        mph_free(m);
+    }
+    /* binary keys with lens */
+    char *bins[] = {"a\0b", "a\0c", "a"};
+    size_t lens[] = {3, 3, 1};
+    struct mph *m = mph_new(bins, lens, 3);
+    assert(m != NULL);
+    assert(mph_iindex(m, bins[0], 3) != mph_iindex(m, bins[1], 3));
+    assert(mph_iindex(m, bins[0], 3) != mph_iindex(m, bins[2], 1));
+    assert(mph_iindex(m, bins[1], 3) != mph_iindex(m, bins[2], 1));
+    /* other keys get indexes in range */
+    assert(mph_index(m, "not exist") < 3);
+    mph_free(m);
+}
+
+void case_mph_dup() {
+    char *keys[] = {"key1", "key2", "key1"};
+    assert(mph_new(keys, NULL, 3) == NULL);
+}
+
+void case_mph_dump() {
+    char keys[1000][8];
+    char *ptrs[1000];
+    size_t i;
+    for (i = 0; i < 1000; i++) {
+        sprintf(keys[i], "key%zu", i);
+        ptrs[i] = keys[i];
+    }
+    struct mph *m = mph_new(ptrs, NULL, 1000);
+    assert(m != NULL);
+    assert(mph_dump(m, MPH_TEST_PATH) == MPH_OK);
+    /* the temporary file is renamed */
+    assert(access(MPH_TEST_PATH MPH_TMP_SUFFIX, F_OK) != 0);
+    struct mph *m2 = mph_load(MPH_TEST_PATH);
+    assert(m2 != NULL);
+    assert(mph_len(m2) == 1000);
+    for (i = 0; i < 1000; i++)
+        assert(mph_index(m, ptrs[i]) == mph_index(m2, ptrs[i]));
+    mph_free(m);
+    mph_free(m2);
+    /* an empty set */
+    m = mph_new(NULL, NULL, 0);
+    assert(m != NULL);
+    assert(mph_dump(m, MPH_TEST_PATH) == MPH_OK);
+    mph_free(m);
+    m = mph_load(MPH_TEST_PATH);
+    assert(m != NULL && mph_len(m) == 0);
+    assert(mph_index(m, "key1") == MPH_NONE);
+    mph_free(m);
+    /* not a mph file */
+    FILE *fp = fopen(MPH_TEST_PATH, "w");
+    assert(fp != NULL);
+    fputs("not a mph file, not a mph file, not a mph file", fp);
+    fclose(fp);
+    assert(mph_load(MPH_TEST_PATH) == NULL);
+    assert(mph_load("not_exist.db") == NULL);
+    assert(unlink(MPH_TEST_PATH) == 0);
+}
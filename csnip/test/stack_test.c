@@ -57,3 +57,13 @@ void case_stack_top() {
     assert(stack_cap(stack) == 3);
     stack_free(stack);
 }
+
+void case_stack_huge() {
+    struct stack *stack = stack_new_huge(3);
+    long i, n = 400000;
+    for (i = 0; i < n; i++) assert(stack_push(stack, (void *)i) == STACK_OK);
+    assert(stack_cap(stack) * sizeof(void *) >= ALLOC_HUGE_PAGE);
+    for (i = n - 1; i >= 0; i--) assert(stack_pop(stack) == (void *)i);
+    assert(stack_len(stack) == 0);
+    stack_free(stack);
+}
@@ -8,6 +8,23 @@
 
 #include "test.h"
 
+/**
+ * alloc_test
+ */
+void case_alloc_default();
+void case_alloc_arena();
+void case_alloc_slab();
+void case_alloc_containers();
+void case_alloc_huge();
+static struct test_case alloc_test_cases[] = {
+    {"alloc_default", &case_alloc_default},
+    {"alloc_arena", &case_alloc_arena},
+    {"alloc_slab", &case_alloc_slab},
+    {"alloc_containers", &case_alloc_containers},
+    {"alloc_huge", &case_alloc_huge},
+    {NULL, NULL},
+};
+
 /**
  * buf_test
  */
@@ -18,9 +35,19 @@ void case_buf_putc();
 void case_buf_str();
 void case_buf_isempty();
 void case_buf_sprintf();
+void case_buf_put_int();
+void case_buf_put_double();
 void case_buf_lrm();
 void case_buf_len();
 void case_buf_cap();
+void case_buf_reserve();
+void case_buf_shrink_to_fit();
+void case_buf_set_max();
+void case_buf_read_fd();
+void case_buf_write_fd();
+void case_buf_share();
+void case_buf_slice();
+void case_buf_slice_write_fd();
 static struct test_case buf_test_cases[] = {
     {"buf_clear", &case_buf_clear},
     {"buf_put", &case_buf_put},
@@ -29,9 +56,36 @@ static struct test_case buf_test_cases[] = {
     {"buf_str", &case_buf_str},
     {"buf_isempty", &case_buf_isempty},
     {"buf_sprintf", &case_buf_sprintf},
+    {"buf_put_int", &case_buf_put_int},
+    {"buf_put_double", &case_buf_put_double},
     {"buf_lrm", &case_buf_lrm},
     {"buf_len", &case_buf_len},
     {"buf_cap", &case_buf_cap},
+    {"buf_reserve", &case_buf_reserve},
+    {"buf_shrink_to_fit", &case_buf_shrink_to_fit},
+    {"buf_set_max", &case_buf_set_max},
+    {"buf_read_fd", &case_buf_read_fd},
+    {"buf_write_fd", &case_buf_write_fd},
+    {"buf_share", &case_buf_share},
+    {"buf_slice", &case_buf_slice},
+    {"buf_slice_write_fd", &case_buf_slice_write_fd},
+    {NULL, NULL},
+};
+
+/**
+ * bufchain_test
+ */
+void case_bufchain_put();
+void case_bufchain_lrm();
+void case_bufchain_peek();
+void case_bufchain_write_fd();
+void case_bufchain_slab();
+static struct test_case bufchain_test_cases[] = {
+    {"bufchain_put", &case_bufchain_put},
+    {"bufchain_lrm", &case_bufchain_lrm},
+    {"bufchain_peek", &case_bufchain_peek},
+    {"bufchain_write_fd", &case_bufchain_write_fd},
+    {"bufchain_slab", &case_bufchain_slab},
     {NULL, NULL},
 };
 
@@ -43,6 +97,21 @@ static struct test_case cfg_test_cases[] = {
     {"cfg_get", &case_cfg_get}, {NULL, NULL},
 };
 
+/**
+ * cmap_test
+ */
+void case_cmap_set();
+void case_cmap_pop();
+void case_cmap_concurrent();
+void case_cmap_reclaim();
+static struct test_case cmap_test_cases[] = {
+    {"cmap_set", &case_cmap_set},
+    {"cmap_pop", &case_cmap_pop},
+    {"cmap_concurrent", &case_cmap_concurrent},
+    {"cmap_reclaim", &case_cmap_reclaim},
+    {NULL, NULL},
+};
+
 /**
  * datetime_test
  */
@@ -61,6 +130,17 @@ void case_dict_has();
 void case_dict_clear();
 void case_dict_resize();
 void case_dict_iter();
+void case_dict_hash();
+void case_dict_rehash();
+void case_dict_iter_get();
+void case_dict_slab();
+void case_dict_scan();
+void case_dict_shrink();
+void case_dict_entry();
+void case_dict_iget_many();
+void case_dict_owned();
+void case_dict_stats();
+void case_dict_huge();
 static struct test_case dict_test_cases[] = {
     {"dict_set", &case_dict_set},
     {"dict_get", &case_dict_get},
@@ -69,6 +149,17 @@ static struct test_case dict_test_cases[] = {
     {"dict_clear", &case_dict_clear},
     {"dict_resize", &case_dict_resize},
     {"dict_iter", &case_dict_iter},
+    {"dict_hash", &case_dict_hash},
+    {"dict_rehash", &case_dict_rehash},
+    {"dict_iter_get", &case_dict_iter_get},
+    {"dict_slab", &case_dict_slab},
+    {"dict_scan", &case_dict_scan},
+    {"dict_shrink", &case_dict_shrink},
+    {"dict_entry", &case_dict_entry},
+    {"dict_iget_many", &case_dict_iget_many},
+    {"dict_owned", &case_dict_owned},
+    {"dict_stats", &case_dict_stats},
+    {"dict_huge", &case_dict_huge},
     {NULL, NULL},
 };
 
@@ -80,6 +171,21 @@ static struct test_case event_test_cases[] = {
     {"event_simple", &case_event_simple}, {NULL, NULL},
 };
 
+/**
+ * hashfile_test
+ */
+void case_hashfile_map();
+void case_hashfile_dict();
+void case_hashfile_vlen();
+void case_hashfile_writer();
+static struct test_case hashfile_test_cases[] = {
+    {"hashfile_map", &case_hashfile_map},
+    {"hashfile_dict", &case_hashfile_dict},
+    {"hashfile_vlen", &case_hashfile_vlen},
+    {"hashfile_writer", &case_hashfile_writer},
+    {NULL, NULL},
+};
+
 /**
  * heap_test
  */
@@ -92,6 +198,8 @@ void case_heap_top();
 void case_heap_pushpop();
 void case_heap_del();
 void case_heap_repalce();
+void case_heap_define();
+void case_heap_huge();
 static struct test_case heap_test_cases[] = {
     {"heap_clear", &case_heap_clear},
     {"heap_len", &case_heap_len},
@@ -102,6 +210,8 @@ static struct test_case heap_test_cases[] = {
     {"heap_pushpop", &case_heap_pushpop},
     {"heap_del", &case_heap_del},
     {"heap_replace", &case_heap_repalce},
+    {"heap_define", &case_heap_define},
+    {"heap_huge", &case_heap_huge},
     {NULL, NULL},
 };
 
@@ -157,6 +267,17 @@ void case_map_pop();
 void case_map_has();
 void case_map_clear();
 void case_map_iter();
+void case_map_churn();
+void case_map_hash();
+void case_map_scan();
+void case_map_shrink();
+void case_map_entry();
+void case_map_iget_many();
+void case_map_owned();
+void case_map_stats();
+void case_map_define();
+void case_map_huge();
+void case_map_seed();
 static struct test_case map_test_cases[] = {
     {"map_set", &case_map_set},
     {"map_get", &case_map_get},
@@ -164,6 +285,30 @@ static struct test_case map_test_cases[] = {
     {"map_has", &case_map_has},
     {"map_clear", &case_map_clear},
     {"map_iter", &case_map_iter},
+    {"map_churn", &case_map_churn},
+    {"map_hash", &case_map_hash},
+    {"map_scan", &case_map_scan},
+    {"map_shrink", &case_map_shrink},
+    {"map_entry", &case_map_entry},
+    {"map_iget_many", &case_map_iget_many},
+    {"map_owned", &case_map_owned},
+    {"map_stats", &case_map_stats},
+    {"map_define", &case_map_define},
+    {"map_huge", &case_map_huge},
+    {"map_seed", &case_map_seed},
+    {NULL, NULL},
+};
+
+/**
+ * mph_test
+ */
+void case_mph_index();
+void case_mph_dup();
+void case_mph_dump();
+static struct test_case mph_test_cases[] = {
+    {"mph_index", &case_mph_index},
+    {"mph_dup", &case_mph_dup},
+    {"mph_dump", &case_mph_dump},
     {NULL, NULL},
 };
 
@@ -204,11 +349,13 @@ void case_stack_clear();
 void case_stack_push();
 void case_stack_pop();
 void case_stack_top();
+void case_stack_huge();
 static struct test_case stack_test_cases[] = {
     {"stack_clear", &case_stack_clear},
     {"stack_push", &case_stack_push},
     {"stack_pop", &case_stack_pop},
     {"stack_top", &case_stack_top},
+    {"stack_huge", &case_stack_huge},
     {NULL, NULL},
 };
 
@@ -225,6 +372,19 @@ static struct test_case strings_test_cases[] = {
     {NULL, NULL},
 };
 
+/**
+ * u64map_test
+ */
+void case_u64map_set();
+void case_u64map_pop();
+void case_u64map_iter();
+static struct test_case u64map_test_cases[] = {
+    {"u64map_set", &case_u64map_set},
+    {"u64map_pop", &case_u64map_pop},
+    {"u64map_iter", &case_u64map_iter},
+    {NULL, NULL},
+};
+
 /**
  * utils_test
  */
@@ -236,6 +396,19 @@ static struct test_case utils_test_cases[] = {
     {NULL, NULL},
 };
 
+/**
+ * vec_test
+ */
+void case_vec_push();
+void case_vec_pop();
+void case_vec_grow();
+static struct test_case vec_test_cases[] = {
+    {"vec_push", &case_vec_push},
+    {"vec_pop", &case_vec_pop},
+    {"vec_grow", &case_vec_grow},
+    {NULL, NULL},
+};
+
 static void run_cases(const char *name, struct test_case cases[]) {
     int idx = 0;
 
@@ -255,20 +428,27 @@ int main(int argc, const char *argv[]) {
 #ifdef __linux
     mtrace();
 #endif
+    run_cases("alloc_test", alloc_test_cases);
     run_cases("buf_test", buf_test_cases);
+    run_cases("bufchain_test", bufchain_test_cases);
     run_cases("cfg_test", cfg_test_cases);
+    run_cases("cmap_test", cmap_test_cases);
     run_cases("datetime_test", datetime_test_cases);
     run_cases("dict_test", dict_test_cases);
     run_cases("event_test", event_test_cases);
+    run_cases("hashfile_test", hashfile_test_cases);
     run_cases("heap_test", heap_test_cases);
     run_cases("ketama_test", ketama_test_cases);
     run_cases("list_test", list_test_cases);
     run_cases("log_test", log_test_cases);
     run_cases("map_test", map_test_cases);
+    run_cases("mph_test", mph_test_cases);
     run_cases("queue_test", queue_test_cases);
     run_cases("skiplist_test", skiplist_test_cases);
     run_cases("stack_test", stack_test_cases);
     run_cases("strings_test", strings_test_cases);
+    run_cases("u64map_test", u64map_test_cases);
     run_cases("utils_test", utils_test_cases);
+    run_cases("vec_test", vec_test_cases);
     return 0;
 }
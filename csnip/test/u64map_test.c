@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "u64map.h"
+
+void case_u64map_set() {
+    struct u64map *m = u64map();
+    char *val = "val";
+    assert(u64map_set(m, 1, val) == U64MAP_OK);
+    assert(u64map_len(m) == 1);
+    assert(u64map_get(m, 1) == val);
+    assert(u64map_get(m, 2) == NULL);
+    /* key 0 is kept out of the table */
+    assert(u64map_set(m, 0, val) == U64MAP_OK);
+    assert(u64map_set(m, 0, val) == U64MAP_OK);
+    assert(u64map_len(m) == 2);
+    assert(u64map_get(m, 0) == val);
+    uint64_t i;
+    for (i = 0; i < 10000; i++)
+        assert(u64map_set(m, i * 4096, (void *)(uintptr_t)i) == U64MAP_OK);
+    assert(u64map_len(m) == 10001);
+    for (i = 0; i < 10000; i++)
+        assert(u64map_get(m, i * 4096) == (void *)(uintptr_t)i);
+    assert(u64map_cap(m) * U64MAP_LOAD_LIMIT >= u64map_len(m));
+    u64map_free(m);
+}
+
+void case_u64map_pop() {
+    struct u64map *m = u64map();
+    uint64_t i;
+    for (i = 0; i < 10000; i++)
+        assert(u64map_set(m, i, (void *)(uintptr_t)(i + 1)) == U64MAP_OK);
+    size_t cap = u64map_cap(m);
+    for (i = 0; i < 10000; i += 2)
+        assert(u64map_pop(m, i) == (void *)(uintptr_t)(i + 1));
+    assert(u64map_pop(m, 0) == NULL);
+    assert(u64map_len(m) == 5000);
+    for (i = 0; i < 10000; i++) {
+        assert(u64map_has(m, i) == i % 2);
+        assert(u64map_get(m, i) == (i % 2 ? (void *)(uintptr_t)(i + 1) : NULL));
+    }
+    /* shrinks as nodes are popped */
+    for (i = 1; i < 9900; i += 2)
+        assert(u64map_pop(m, i) == (void *)(uintptr_t)(i + 1));
+    assert(u64map_len(m) == 50);
+    assert(u64map_cap(m) < cap);
+    for (i = 9901; i < 10000; i += 2)
+        assert(u64map_get(m, i) == (void *)(uintptr_t)(i + 1));
+    u64map_free(m);
+}
+
+void case_u64map_iter() {
+    struct u64map *m = u64map();
+    uint64_t i, sum = 0;
+    int n = 0;
+    for (i = 0; i < 100; i++)
+        assert(u64map_set(m, i, NULL) == U64MAP_OK);
+    struct u64map_iter iter = {m};
+    struct u64map_node *node = NULL;
+    u64map_each(&iter, node) {
+        sum += node->key;
+        n++;
+    }
+    assert(n == 100 && sum == 4950);
+    assert(u64map_iter_next(&iter) == NULL);
+    u64map_iter_rewind(&iter);
+    assert(u64map_iter_next(&iter) != NULL);
+    u64map_clear(m);
+    u64map_iter_rewind(&iter);
+    assert(u64map_iter_next(&iter) == NULL);
+    u64map_free(m);
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2015, Chao Wang <hit9@icloud.com>
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "vec.h"
+
+struct vec_point {
+    int x;
+    int y;
+};
+
+VEC_DEFINE(vec_points, struct vec_point)
+
+void case_vec_push() {
+    struct vec_points *v = vec_points_new();
+    assert(vec_points_len(v) == 0 && vec_points_cap(v) == 0);
+    int i;
+    for (i = 0; i < 100; i++) {
+        struct vec_point p = {i, -i};
+        assert(vec_points_push(v, p) == VEC_OK);
+    }
+    assert(vec_points_len(v) == 100);
+    assert(vec_points_cap(v) == 128);
+    for (i = 0; i < 100; i++) {
+        assert(vec_points_at(v, i)->x == i);
+        assert(vec_points_at(v, i)->y == -i);
+    }
+    vec_points_free(v);
+}
+
+void case_vec_pop() {
+    struct vec_points *v = vec_points_new();
+    struct vec_point p = {1, 2};
+    assert(vec_points_pop(v, &p) == 0);
+    assert(vec_points_push(v, p) == VEC_OK);
+    p.x = 3;
+    assert(vec_points_push(v, p) == VEC_OK);
+    assert(vec_points_pop(v, &p) == 1 && p.x == 3);
+    assert(vec_points_pop(v, NULL) == 1);
+    assert(vec_points_pop(v, &p) == 0);
+    assert(vec_points_len(v) == 0);
+    vec_points_free(v);
+}
+
+void case_vec_grow() {
+    struct vec_points *v = vec_points_new();
+    assert(vec_points_grow(v, 100) == VEC_OK);
+    assert(vec_points_cap(v) == 128 && vec_points_len(v) == 0);
+    assert(vec_points_grow(v, 10) == VEC_OK);
+    assert(vec_points_cap(v) == 128);
+    struct vec_point p = {1, 2};
+    assert(vec_points_push(v, p) == VEC_OK);
+    vec_points_clear(v);
+    assert(vec_points_len(v) == 0 && vec_points_cap(v) == 128);
+    vec_points_free(v);
+}